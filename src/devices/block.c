@@ -3,7 +3,18 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/** Most scatter/gather elements the dispatcher hands the driver
+   in one transfer when it merges requests. */
+#define BLOCK_MERGE_IOV_MAX 64
+
+/** Sectors that fit in a device's bounce page. */
+#define BLOCK_BOUNCE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
 
 /** A block device. */
 struct block
@@ -19,6 +30,20 @@ struct block
 
     unsigned long long read_cnt;        /**< Number of sectors read. */
     unsigned long long write_cnt;       /**< Number of sectors written. */
+    unsigned long long read_req_cnt;    /**< Number of read requests. */
+    unsigned long long write_req_cnt;   /**< Number of write requests. */
+    unsigned long long merge_cnt;       /**< Requests merged into others. */
+
+    /* Request queue.  Unused by devices with a SUBMIT operation. */
+    struct lock queue_lock;             /**< Protects QUEUE, HEAD, stats. */
+    struct condition queue_ready;       /**< Signaled when QUEUE fills. */
+    struct list queue;                  /**< Queued requests, by sector. */
+    block_sector_t head;                /**< Sector after the last batch. */
+    struct block_iovec merge_iov[BLOCK_MERGE_IOV_MAX];  /**< Dispatcher's. */
+
+    /* Bounce page for transfers to and from user memory. */
+    struct lock bounce_lock;            /**< Protects BOUNCE. */
+    uint8_t *bounce;                    /**< Allocated on first use. */
   };
 
 /** List of all block devices. */
@@ -120,9 +145,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple (block, sector, 1, buffer);
 }
 
 /** Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +156,406 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multiple (block, sector, 1, buffer);
+}
+
+/** Reads CNT sectors starting at SECTOR from BLOCK into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     block_sector_t cnt, void *buffer)
+{
+  struct block_iovec iov;
+
+  iov.buffer = buffer;
+  iov.cnt = cnt;
+  block_readv (block, sector, &iov, 1);
+}
+
+/** Writes CNT sectors starting at SECTOR to BLOCK from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the block device has acknowledged receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      block_sector_t cnt, const void *buffer)
+{
+  struct block_iovec iov;
+
+  iov.buffer = (void *) buffer;
+  iov.cnt = cnt;
+  block_writev (block, sector, &iov, 1);
+}
+
+/** Returns true if any of the IOV_CNT buffers of IOV is in user
+   memory. */
+static bool
+iov_in_user (const struct block_iovec *iov, size_t iov_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    if (iov[i].cnt > 0 && !is_kernel_vaddr (iov[i].buffer))
+      return true;
+  return false;
+}
+
+/** Carries out a synchronous transfer between consecutive sectors
+   of BLOCK, starting at SECTOR, and the IOV_CNT buffers of IOV,
+   some of which are in user memory.  The thread that carries out
+   a request need not have the caller's page directory, so the
+   sectors go through BLOCK's bounce page, a page at a time, and
+   the caller copies them to or from its buffers itself. */
+static void
+transfer_bounced (struct block *block, bool write, block_sector_t sector,
+                  const struct block_iovec *iov, size_t iov_cnt)
+{
+  size_t i;
+
+  lock_acquire (&block->bounce_lock);
+  if (block->bounce == NULL)
+    block->bounce = palloc_get_page (PAL_ASSERT);
+
+  for (i = 0; i < iov_cnt; i++)
+    {
+      uint8_t *buffer = iov[i].buffer;
+      block_sector_t left = iov[i].cnt;
+
+      while (left > 0)
+        {
+          block_sector_t cnt = (left < BLOCK_BOUNCE_SECTORS
+                                ? left : BLOCK_BOUNCE_SECTORS);
+          size_t size = cnt * BLOCK_SECTOR_SIZE;
+          struct block_iovec bounce_iov;
+          struct block_request rq;
+
+          bounce_iov.buffer = block->bounce;
+          bounce_iov.cnt = cnt;
+          if (write)
+            memcpy (block->bounce, buffer, size);
+          block_request_init (&rq, write, sector, &bounce_iov, 1, NULL, NULL);
+          block_submit (block, &rq);
+          block_wait (&rq);
+          if (!write)
+            memcpy (buffer, block->bounce, size);
+
+          buffer += size;
+          sector += cnt;
+          left -= cnt;
+        }
+    }
+  lock_release (&block->bounce_lock);
+}
+
+/** Reads consecutive sectors of BLOCK, starting at SECTOR, into
+   the IOV_CNT buffers of IOV in order, as one request to the
+   driver if it can take one.  Unlike block_submit(), accepts
+   buffers in the current process's user memory, which it reads
+   into through a kernel page.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_readv (struct block *block, block_sector_t sector,
+             const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct block_request rq;
+
+  if (iov_in_user (iov, iov_cnt))
+    {
+      transfer_bounced (block, false, sector, iov, iov_cnt);
+      return;
+    }
+
+  block_request_init (&rq, false, sector, iov, iov_cnt, NULL, NULL);
+  block_submit (block, &rq);
+  block_wait (&rq);
+}
+
+/** Writes the IOV_CNT buffers of IOV in order to consecutive
+   sectors of BLOCK, starting at SECTOR, as one request to the
+   driver if it can take one.  Returns after the block device has
+   acknowledged receiving the data.  Like block_readv(), accepts
+   buffers in user memory.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_writev (struct block *block, block_sector_t sector,
+              const struct block_iovec *iov, size_t iov_cnt)
+{
+  struct block_request rq;
+
+  if (iov_in_user (iov, iov_cnt))
+    {
+      transfer_bounced (block, true, sector, iov, iov_cnt);
+      return;
+    }
+
+  block_request_init (&rq, true, sector, iov, iov_cnt, NULL, NULL);
+  block_submit (block, &rq);
+  block_wait (&rq);
+}
+
+/** Initializes RQ to read (if WRITE is false) or write (if WRITE
+   is true) consecutive sectors, starting at SECTOR, from or to
+   the IOV_CNT buffers of IOV in order.  If COMPLETE is non-null,
+   it is called with RQ and AUX when the request completes, from
+   the device's dispatcher thread, from the driver, possibly in
+   interrupt context, or, for a request with no sectors, from
+   block_submit().  It must not sleep. */
+void
+block_request_init (struct block_request *rq, bool write,
+                    block_sector_t sector,
+                    const struct block_iovec *iov, size_t iov_cnt,
+                    block_complete_func *complete, void *aux)
+{
+  size_t i;
+
+  ASSERT (rq != NULL);
+  ASSERT (iov != NULL || iov_cnt == 0);
+
+  rq->write = write;
+  rq->sector = sector;
+  rq->cnt = 0;
+  for (i = 0; i < iov_cnt; i++)
+    rq->cnt += iov[i].cnt;
+  rq->iov = iov;
+  rq->iov_cnt = iov_cnt;
+  rq->complete = complete;
+  rq->aux = aux;
+  sema_init (&rq->done_sema, 0);
+  rq->driver_parts = 0;
+}
+
+/** Marks RQ done and wakes up its waiter, after calling its
+   completion function.  RQ is not touched afterward, since its
+   submitter may free it as soon as it sees it done, whether by
+   polling or by waiting.  May be called from interrupt
+   context. */
+void
+block_complete (struct block_request *rq)
+{
+  if (rq->complete != NULL)
+    rq->complete (rq, rq->aux);
+  sema_up (&rq->done_sema);
+}
+
+/** Orders queued requests by sector.  Requests for the same
+   sector stay in submission order. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return a->sector < b->sector;
+}
+
+/** Starts RQ, which block_request_init() must have initialized,
+   on BLOCK and returns without waiting for it.  Panics if RQ
+   reaches past the end of BLOCK. */
+void
+block_submit (struct block *block, struct block_request *rq)
+{
+  ASSERT (!rq->write || block->type != BLOCK_FOREIGN);
+  ASSERT (!iov_in_user (rq->iov, rq->iov_cnt));
+
+  if (rq->cnt > 0)
+    {
+      check_sector (block, rq->sector);
+      check_sector (block, rq->sector + rq->cnt - 1);
+      if (rq->sector + rq->cnt - 1 < rq->sector)
+        PANIC ("Access past end of device %s (sector=%"PRDSNu", "
+               "cnt=%"PRDSNu")\n", block_name (block), rq->sector, rq->cnt);
+    }
+
+  lock_acquire (&block->queue_lock);
+  if (rq->write)
+    {
+      block->write_cnt += rq->cnt;
+      block->write_req_cnt++;
+    }
+  else
+    {
+      block->read_cnt += rq->cnt;
+      block->read_req_cnt++;
+    }
+  if (rq->cnt > 0 && block->ops->submit == NULL)
+    {
+      list_insert_ordered (&block->queue, &rq->elem, request_less, NULL);
+      cond_signal (&block->queue_ready, &block->queue_lock);
+    }
+  lock_release (&block->queue_lock);
+
+  if (rq->cnt == 0)
+    block_complete (rq);
+  else if (block->ops->submit != NULL)
+    block->ops->submit (block->aux, rq);
+}
+
+/** Returns true if RQ has completed.  Never sleeps, so it may be
+   called with interrupts off. */
+bool
+block_poll (struct block_request *rq)
+{
+  enum intr_level old_level;
+  bool done;
+
+  /* sema_up() is through with the semaphore once it releases the
+     semaphore's lock, so a poller that sees the up under that
+     lock may free RQ at once, even if block_complete() ran on
+     another CPU. */
+  old_level = intr_disable ();
+  spin_acquire (&rq->done_sema.waiters.lock);
+  done = rq->done_sema.value > 0;
+  spin_release (&rq->done_sema.waiters.lock);
+  intr_set_level (old_level);
+  return done;
+}
+
+/** Waits for RQ to complete.  May be called at most once per
+   request. */
+void
+block_wait (struct block_request *rq)
+{
+  sema_down (&rq->done_sema);
+}
+
+/** Takes the next batch of requests off BLOCK's queue, which must
+   not be empty, and appends them to BATCH.  BLOCK's queue lock
+   must be held.
+
+   The batch starts with the request for the lowest sector at or
+   after the head, where the previous batch ended, or with the
+   lowest queued sector if there is none, so that the head sweeps
+   up the disk and jumps back to the start (C-LOOK).  Following
+   requests in the same direction are added for as long as each
+   begins where the last one ended and their vectors fit in
+   BLOCK's merge vector. */
+static void
+take_batch (struct block *block, struct list *batch)
+{
+  struct block_request *first = NULL;
+  struct list_elem *e;
+  block_sector_t end;
+  size_t iov_cnt;
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *rq = list_entry (e, struct block_request, elem);
+      if (rq->sector >= block->head)
+        {
+          first = rq;
+          break;
+        }
+    }
+  if (first == NULL)
+    first = list_entry (list_front (&block->queue), struct block_request, elem);
+
+  e = list_remove (&first->elem);
+  list_push_back (batch, &first->elem);
+  end = first->sector + first->cnt;
+  iov_cnt = first->iov_cnt;
+  while (e != list_end (&block->queue))
+    {
+      struct block_request *rq = list_entry (e, struct block_request, elem);
+      if (rq->sector != end || rq->write != first->write
+          || iov_cnt + rq->iov_cnt > BLOCK_MERGE_IOV_MAX)
+        break;
+
+      e = list_remove (&rq->elem);
+      list_push_back (batch, &rq->elem);
+      end += rq->cnt;
+      iov_cnt += rq->iov_cnt;
+    }
+  block->head = end;
+}
+
+/** Carries out the requests in BATCH, which take_batch() built,
+   on BLOCK as a single transfer, then completes each of them. */
+static void
+dispatch_batch (struct block *block, struct list *batch)
+{
+  struct block_request *first = list_entry (list_front (batch),
+                                            struct block_request, elem);
+  const struct block_iovec *iov = first->iov;
+  size_t iov_cnt = first->iov_cnt;
+  block_sector_t sector = first->sector;
+
+  if (list_next (&first->elem) != list_end (batch))
+    {
+      /* Several requests: run their vectors together. */
+      struct list_elem *e;
+
+      iov_cnt = 0;
+      for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+        {
+          struct block_request *rq = list_entry (e, struct block_request,
+                                                 elem);
+          memcpy (block->merge_iov + iov_cnt, rq->iov,
+                  rq->iov_cnt * sizeof *rq->iov);
+          iov_cnt += rq->iov_cnt;
+          block->merge_cnt++;
+        }
+      block->merge_cnt--;
+      iov = block->merge_iov;
+    }
+
+  if (first->write && block->ops->writev != NULL)
+    block->ops->writev (block->aux, sector, iov, iov_cnt);
+  else if (!first->write && block->ops->readv != NULL)
+    block->ops->readv (block->aux, sector, iov, iov_cnt);
+  else
+    {
+      size_t i;
+
+      for (i = 0; i < iov_cnt; i++)
+        {
+          block_sector_t j;
+          for (j = 0; j < iov[i].cnt; j++)
+            {
+              uint8_t *buffer = (uint8_t *) iov[i].buffer
+                                + j * BLOCK_SECTOR_SIZE;
+              if (first->write)
+                block->ops->write (block->aux, sector++, buffer);
+              else
+                block->ops->read (block->aux, sector++, buffer);
+            }
+        }
+    }
+
+  while (!list_empty (batch))
+    block_complete (list_entry (list_pop_front (batch),
+                                  struct block_request, elem));
+}
+
+/** Dispatcher thread for BLOCK_, a struct block *.  Keeps the
+   device busy for as long as requests are queued for it, one
+   batch at a time.  Each device has its own, so devices that do
+   not share a controller, such as disks on different IDE
+   channels, work in parallel. */
+static void
+dispatcher (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct list batch;
+
+      list_init (&batch);
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->queue))
+        cond_wait (&block->queue_ready, &block->queue_lock);
+      take_batch (block, &batch);
+      lock_release (&block->queue_lock);
+
+      dispatch_batch (block, &batch);
+    }
 }
 
 /** Returns the number of sectors in BLOCK. */
@@ -171,9 +590,12 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
-          printf ("%s (%s): %llu reads, %llu writes\n",
+          printf ("%s (%s): %llu reads in %llu requests, "
+                  "%llu writes in %llu requests, %llu merged\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  block->read_cnt, block->read_req_cnt,
+                  block->write_cnt, block->write_req_cnt,
+                  block->merge_cnt);
         }
     }
 }
@@ -200,6 +622,15 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->read_req_cnt = 0;
+  block->write_req_cnt = 0;
+  block->merge_cnt = 0;
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_ready);
+  list_init (&block->queue);
+  block->head = 0;
+  lock_init (&block->bounce_lock);
+  block->bounce = NULL;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -208,6 +639,15 @@ block_register (const char *name, enum block_type type,
     printf (", %s", extra_info);
   printf ("\n");
 
+  if (ops->submit == NULL)
+    {
+      char thread_name[sizeof block->name + 3];
+
+      snprintf (thread_name, sizeof thread_name, "%s-io", block->name);
+      if (thread_create (thread_name, PRI_MAX, dispatcher, block) == TID_ERROR)
+        PANIC ("Failed to start dispatcher for block device %s", block->name);
+    }
+
   return block;
 }
 
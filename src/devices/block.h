@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /** Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -22,6 +24,48 @@ typedef uint32_t block_sector_t;
 
 struct block;
 
+/** One piece of a scatter/gather transfer: CNT sectors at
+   BUFFER. */
+struct block_iovec
+  {
+    void *buffer;               /**< CNT * BLOCK_SECTOR_SIZE bytes. */
+    block_sector_t cnt;         /**< Number of sectors. */
+  };
+
+struct block_request;
+
+/** Function called when a request completes, with the AUX given
+   to block_request_init(). */
+typedef void block_complete_func (struct block_request *, void *aux);
+
+/** An asynchronous transfer between consecutive sectors of a
+   block device and the buffers of a scatter/gather vector.
+
+   The request, and the vector and buffers it points to, belong
+   to the submitter and must stay put until the request is done.
+   The buffers must be at kernel virtual addresses, because the
+   request may be carried out by a device's dispatcher thread,
+   which has no user address space.  The synchronous
+   block_read() and friends take user buffers too.
+   Each device dispatches its queued requests in C-LOOK order,
+   merging those that continue one another in the same direction,
+   so requests for overlapping sectors may complete in any order:
+   a submitter that cares must wait for one before submitting the
+   next. */
+struct block_request
+  {
+    struct list_elem elem;      /**< Element in a device's queue. */
+    bool write;                 /**< Write, rather than read? */
+    block_sector_t sector;      /**< First sector on the device. */
+    block_sector_t cnt;         /**< Total sectors in IOV. */
+    const struct block_iovec *iov;      /**< Buffers. */
+    size_t iov_cnt;             /**< Number of elements in IOV. */
+    block_complete_func *complete;      /**< Called on completion, or null. */
+    void *aux;                  /**< Passed to COMPLETE. */
+    struct semaphore done_sema; /**< Upped on completion. */
+    unsigned driver_parts;      /**< For a SUBMIT driver's own use. */
+  };
+
 /** Type of a block device. */
 enum block_type
   {
@@ -53,7 +97,23 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, block_sector_t cnt,
+                           const void *);
+void block_readv (struct block *, block_sector_t,
+                  const struct block_iovec *, size_t iov_cnt);
+void block_writev (struct block *, block_sector_t,
+                   const struct block_iovec *, size_t iov_cnt);
 const char *block_name (struct block *);
+
+/** Asynchronous requests. */
+void block_request_init (struct block_request *, bool write, block_sector_t,
+                         const struct block_iovec *, size_t iov_cnt,
+                         block_complete_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+bool block_poll (struct block_request *);
+void block_wait (struct block_request *);
 enum block_type block_type (struct block *);
 
 /** Statistics. */
@@ -61,14 +121,38 @@ void block_print_stats (void);
 
 /** Lower-level interface to block device drivers. */
 
+/** READ and WRITE move one sector.  READV and WRITEV, which a
+   driver may leave null, move the sectors of a scatter/gather
+   vector, which the block layer has checked against the size of
+   the device and which holds at least one sector, to or from
+   consecutive sectors of the device.  Without them, the block
+   layer makes one READ or WRITE call per sector.  The block
+   layer calls all four from the device's dispatcher thread, one
+   at a time.
+
+   A driver that schedules requests itself instead provides
+   SUBMIT, which is handed each checked request, with at least one
+   sector, from the submitting thread.  It may sleep, e.g. until
+   the device has room, and may change the request's SECTOR and
+   DRIVER_PARTS.  It either passes the request on to another
+   device, as a partition does to the disk it is part of, or
+   carries it out and calls block_complete() once it is done,
+   possibly from interrupt context.  Such a device has no queue or
+   dispatcher of its own. */
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*readv) (void *aux, block_sector_t,
+                   const struct block_iovec *, size_t iov_cnt);
+    void (*writev) (void *aux, block_sector_t,
+                    const struct block_iovec *, size_t iov_cnt);
+    void (*submit) (void *aux, struct block_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_complete (struct block_request *);
 
 #endif /**< devices/block.h */
@@ -0,0 +1,147 @@
+#include "devices/clock.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/** TSC clocksource.
+
+   The TSC counts CPU cycles at a fixed rate, which clock_init()
+   measures at boot against the PIT, by timing CALIBRATE_TICKS
+   timer ticks.  After that, converting a cycle count to
+   nanoseconds is a multiply and a shift with the precomputed
+   factor ns_mult, so reading the clock needs neither a lock nor a
+   64-bit division.
+
+   The timer tick count stays the time base for sleeping and
+   scheduling.  This clock is for measuring short intervals
+   precisely.  It assumes that all CPUs' TSCs run in step, as
+   they do on the emulators Pintos runs on. */
+
+/** Number of timer ticks to measure the TSC over. */
+#define CALIBRATE_TICKS (TIMER_FREQ / 10 > 0 ? TIMER_FREQ / 10 : 1)
+
+/** Nanoseconds per TSC cycle, as a 32-bit fixed-point number
+   with ns_shift fraction bits.  clock_init() picks the most
+   fraction bits, up to NS_SHIFT_MAX, that let the integer part
+   fit: a fast TSC takes well under a nanosecond per cycle, but
+   Bochs runs its TSC at about 1 MHz, 1000 ns per cycle.  NS_MULT
+   is zero until calibrated. */
+#define NS_SHIFT_MAX 32
+static uint32_t ns_mult;
+static unsigned ns_shift;
+
+static uint64_t tsc_hz;         /**< TSC cycles per second. */
+static uint64_t tsc_base;       /**< TSC value at boot. */
+
+/** Reads the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/** Waits for the start of the next timer tick and returns the TSC
+   value there. */
+static uint64_t
+tsc_at_tick (void)
+{
+  int64_t start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  return rdtsc ();
+}
+
+/** Measures the rate of the TSC.  Interrupts must be on, so that
+   timer ticks are counted. */
+void
+clock_init (void)
+{
+  uint64_t start, end, mult;
+  int64_t first;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  tsc_base = rdtsc ();
+  start = tsc_at_tick ();
+  first = timer_ticks ();
+  while (timer_elapsed (first) < CALIBRATE_TICKS)
+    barrier ();
+  end = rdtsc ();
+
+  tsc_hz = (end - start) * TIMER_FREQ / CALIBRATE_TICKS;
+  if (tsc_hz == 0)
+    PANIC ("TSC does not advance");
+
+  /* At NS_SHIFT_MAX, 10**9 << ns_shift still fits in 64 bits, and
+     with no fraction bits at all the quotient is at most 10**9. */
+  ns_shift = NS_SHIFT_MAX;
+  while (((uint64_t) 1000000000 << ns_shift) / tsc_hz > UINT32_MAX)
+    ns_shift--;
+  mult = ((uint64_t) 1000000000 << ns_shift) / tsc_hz;
+  ASSERT (mult != 0 && mult <= UINT32_MAX);
+  ns_mult = mult;
+  printf ("TSC runs at %'"PRIu64" Hz.\n", tsc_hz);
+}
+
+/** Returns true once clock_init() has measured the TSC. */
+bool
+clock_calibrated (void)
+{
+  return ns_mult != 0;
+}
+
+/** Returns the rate of the TSC, in cycles per second, or 0 if it
+   has not been measured yet. */
+uint64_t
+clock_hz (void)
+{
+  return tsc_hz;
+}
+
+/** Returns the number of TSC cycles since boot. */
+uint64_t
+clock_cycles (void)
+{
+  return rdtsc () - tsc_base;
+}
+
+/** Converts CYCLES of the TSC to nanoseconds.  Returns 0 until
+   clock_init() has run. */
+uint64_t
+clock_cycles_to_ns (uint64_t cycles)
+{
+  uint32_t hi = cycles >> 32;
+  uint32_t lo = cycles;
+
+  /* CYCLES * ns_mult >> ns_shift, in two halves so that no
+     product needs more than 64 bits. */
+  return ((uint64_t) hi * ns_mult << (32 - ns_shift))
+         + ((uint64_t) lo * ns_mult >> ns_shift);
+}
+
+/** Returns the number of nanoseconds since boot.  Monotonic.
+   Returns 0 until clock_init() has run. */
+uint64_t
+clock_ns (void)
+{
+  return clock_cycles_to_ns (clock_cycles ());
+}
+
+/** Busy-waits for at least NS nanoseconds.  The clock must be
+   calibrated. */
+void
+clock_delay_ns (uint64_t ns)
+{
+  uint64_t end;
+
+  ASSERT (clock_calibrated ());
+
+  end = clock_ns () + ns;
+  while (clock_ns () < end)
+    barrier ();
+}
@@ -0,0 +1,21 @@
+#ifndef DEVICES_CLOCK_H
+#define DEVICES_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** High-resolution clocksource, based on the CPU's time-stamp
+   counter (TSC).  Reads take no lock and may be made from any
+   context, including interrupt handlers. */
+
+void clock_init (void);
+bool clock_calibrated (void);
+uint64_t clock_hz (void);
+
+uint64_t clock_cycles (void);
+uint64_t clock_ns (void);
+uint64_t clock_cycles_to_ns (uint64_t cycles);
+
+void clock_delay_ns (uint64_t ns);
+
+#endif /**< devices/clock.h */
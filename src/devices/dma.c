@@ -0,0 +1,120 @@
+#include "devices/dma.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/init.h"
+
+/** Initializes POS to the start of the vector that begins with
+   IOV. */
+void
+iov_pos_init (struct iov_pos *pos, const struct block_iovec *iov)
+{
+  pos->iov = iov;
+  pos->sector = 0;
+}
+
+/** Returns the buffer for the next sector at POS and advances POS
+   past it. */
+void *
+iov_next (struct iov_pos *pos)
+{
+  void *buffer;
+
+  while (pos->sector >= pos->iov->cnt)
+    {
+      pos->iov++;
+      pos->sector = 0;
+    }
+  buffer = (uint8_t *) pos->iov->buffer + pos->sector * BLOCK_SECTOR_SIZE;
+  pos->sector++;
+  return buffer;
+}
+
+/** Takes the next run of sectors at POS that lie together in
+   memory, at most MAX of them, which must be at least 1.  Stores
+   the run's buffer in *BUFFER, advances POS past the run, and
+   returns the number of sectors in it. */
+block_sector_t
+iov_next_run (struct iov_pos *pos, block_sector_t max, void **buffer)
+{
+  block_sector_t run = 1;
+
+  ASSERT (max > 0);
+
+  *buffer = iov_next (pos);
+  while (run < max && pos->sector < pos->iov->cnt)
+    {
+      iov_next (pos);
+      run++;
+    }
+  return run;
+}
+
+/** Returns true if a device can reach the SIZE bytes at BUFFER,
+   that is, if they lie in the kernel's mapping of physical
+   memory, so that vtop() gives their physical address. */
+bool
+dma_reachable (const void *buffer, size_t size)
+{
+  return (is_kernel_vaddr (buffer)
+          && (const uint8_t *) buffer + size
+             <= (const uint8_t *) ptov (init_ram_pages * PGSIZE));
+}
+
+/** Initializes B to move runs through PAGE, which may be null if
+   the caller assigns B->page before the first dma_bounce_add(). */
+void
+dma_bounce_init (struct dma_bounce *b, void *page)
+{
+  b->page = page;
+  b->ofs = 0;
+  b->run_cnt = 0;
+}
+
+/** Moves the RUN sectors at *BUFFER, which iov_next_run() just
+   took from POS, through B's page instead, as many of them as
+   fit.  The rest are given back to POS for a later transfer.  If
+   WRITE, the sectors are copied into the page.  Points *BUFFER at
+   their place in the page and returns how many fit, which may be
+   0 if the page is full. */
+block_sector_t
+dma_bounce_add (struct dma_bounce *b, struct iov_pos *pos, void **buffer,
+                block_sector_t run, bool write)
+{
+  size_t size = run * BLOCK_SECTOR_SIZE;
+  struct bounce_run *r;
+
+  ASSERT (b->page != NULL);
+
+  if (b->ofs + size > PGSIZE)
+    {
+      block_sector_t fit = (PGSIZE - b->ofs) / BLOCK_SECTOR_SIZE;
+      pos->sector -= run - fit;
+      run = fit;
+      size = run * BLOCK_SECTOR_SIZE;
+      if (run == 0)
+        return 0;
+    }
+
+  r = &b->runs[b->run_cnt++];
+  r->buffer = *buffer;
+  r->ofs = b->ofs;
+  r->size = size;
+  if (write)
+    memcpy ((uint8_t *) b->page + b->ofs, *buffer, size);
+  *buffer = (uint8_t *) b->page + b->ofs;
+  b->ofs += size;
+  return run;
+}
+
+/** Copies the runs of a read that went through B's page out to
+   the caller's buffers. */
+void
+dma_bounce_copy_back (const struct dma_bounce *b)
+{
+  size_t i;
+
+  for (i = 0; i < b->run_cnt; i++)
+    memcpy (b->runs[i].buffer, (uint8_t *) b->page + b->runs[i].ofs,
+            b->runs[i].size);
+}
@@ -0,0 +1,53 @@
+#ifndef DEVICES_DMA_H
+#define DEVICES_DMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "threads/vaddr.h"
+
+/** Helpers for block drivers that hand the buffers of a
+   scatter/gather vector to a device that reads and writes memory
+   itself. */
+
+/** Position in a scatter/gather vector. */
+struct iov_pos
+  {
+    const struct block_iovec *iov;      /**< Current element. */
+    block_sector_t sector;              /**< Sectors of it already done. */
+  };
+
+void iov_pos_init (struct iov_pos *, const struct block_iovec *);
+void *iov_next (struct iov_pos *);
+block_sector_t iov_next_run (struct iov_pos *, block_sector_t max,
+                             void **buffer);
+
+bool dma_reachable (const void *buffer, size_t size);
+
+/** A run of sectors moved through a bounce page. */
+struct bounce_run
+  {
+    void *buffer;               /**< Caller's buffer. */
+    size_t ofs;                 /**< Offset in the bounce page. */
+    size_t size;                /**< Number of bytes. */
+  };
+
+/** Most runs that fit in a bounce page. */
+#define BOUNCE_RUN_MAX (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/** The runs of one transfer that go through a bounce page, for
+   buffers the device cannot reach. */
+struct dma_bounce
+  {
+    void *page;                 /**< Bounce page, or null if none yet. */
+    size_t ofs;                 /**< Bytes of PAGE in use. */
+    size_t run_cnt;             /**< Number of RUNS. */
+    struct bounce_run runs[BOUNCE_RUN_MAX];     /**< Runs in PAGE. */
+  };
+
+void dma_bounce_init (struct dma_bounce *, void *page);
+block_sector_t dma_bounce_add (struct dma_bounce *, struct iov_pos *,
+                               void **buffer, block_sector_t run, bool write);
+void dma_bounce_copy_back (const struct dma_bounce *);
+
+#endif /**< devices/dma.h */
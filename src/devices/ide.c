@@ -3,15 +3,32 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
+#include "devices/dma.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
+#include "threads/init.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /** The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the controller is a PCI bus-master IDE controller, such as
+   the PIIX that QEMU and Bochs emulate, sectors are moved by DMA
+   following [BMIDE], so that the CPU does not copy them through
+   the data register.  Otherwise, or after a DMA transfer fails,
+   they are moved by programmed I/O (PIO). */
+
+/** If true, always use PIO, even if DMA is available.
+   Controlled by kernel command-line option "-pio". */
+bool ide_pio;
 
 /** ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /**< Data. */
@@ -30,10 +47,27 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /**< Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /**< Alt Status (r/o). */
 
+/** Bus-master port addresses. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /**< Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /**< Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /**< PRDT address. */
+
 /** Alternate Status Register bits. */
 #define STA_BSY 0x80            /**< Busy. */
 #define STA_DRDY 0x40           /**< Device Ready. */
+#define STA_DF 0x20             /**< Device Fault. */
 #define STA_DRQ 0x08            /**< Data Request. */
+#define STA_ERR 0x01            /**< Error. */
+
+/** Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /**< Start transfer. */
+#define BM_CMD_READ 0x08        /**< Transfer into memory. */
+
+/** Bus-master Status Register bits.  Writing 1 clears ERROR and
+   INTR. */
+#define BM_STA_ACTIVE 0x01      /**< Transfer in progress. */
+#define BM_STA_ERROR 0x02       /**< Transfer failed. */
+#define BM_STA_INTR 0x04        /**< Device raised its interrupt. */
 
 /** Control Register bits. */
 #define CTL_SRST 0x04           /**< Software Reset. */
@@ -49,6 +83,28 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /**< IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /**< READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /**< WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /**< READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /**< WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /**< SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /**< READ DMA. */
+#define CMD_WRITE_DMA 0xca              /**< WRITE DMA. */
+
+/** Most sectors one command can transfer with 28-bit LBA, which
+   is written as a sector count of 0. */
+#define IDE_MAX_SECTORS 256
+
+/** A physical region descriptor, one entry in the table that
+   tells the bus master where in memory to transfer to or from.
+   A region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /**< Physical base address. */
+    uint16_t size;              /**< Byte count, with 0 meaning 64 kB. */
+    uint16_t flags;             /**< PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /**< End of table. */
+#define PRD_BOUNDARY 0x10000    /**< Regions may not cross this. */
+#define PRD_MAX (PGSIZE / sizeof (struct prd))  /**< Entries in a PRDT. */
 
 /** An ATA device. */
 struct ata_disk
@@ -57,6 +113,7 @@ struct ata_disk
     struct channel *channel;    /**< Channel that disk is attached to. */
     int dev_no;                 /**< Device 0 or 1 for master or slave. */
     bool is_ata;                /**< Is device an ATA disk? */
+    block_sector_t multiple;    /**< Sectors per DRQ block in PIO. */
   };
 
 /** An ATA channel (aka controller).
@@ -70,7 +127,14 @@ struct channel
     struct lock lock;           /**< Must acquire to access the controller. */
     bool expecting_interrupt;   /**< True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
-    struct semaphore completion_wait;   /**< Up'd by interrupt handler. */
+    bool completed;             /**< Interrupt taken, waiter not yet woken. */
+    struct semaphore completion_wait;   /**< Up'd by block softirq. */
+
+    uint16_t bm_base;           /**< Bus-master base I/O port, 0 for PIO. */
+    struct prd *prdt;           /**< Physical region descriptor table. */
+    void *bounce;               /**< For buffers DMA cannot reach. */
+    bool dma_busy;              /**< A DMA transfer is in progress. */
+    uint8_t bm_status;          /**< Bus-master status at the interrupt. */
 
     struct ata_disk devices[2];     /**< The devices on this channel. */
   };
@@ -84,9 +148,19 @@ static struct block_operations ide_operations;
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
-
-static void select_sector (struct ata_disk *, block_sector_t);
-static void issue_pio_command (struct channel *, uint8_t command);
+static void set_multiple_mode (struct ata_disk *, uint8_t max);
+
+static void init_dma (void);
+static void clear_bm_status (struct channel *);
+static block_sector_t dma_transfer (struct ata_disk *, block_sector_t,
+                                    struct iov_pos *, block_sector_t cnt,
+                                    bool write);
+static void pio_transfer (struct ata_disk *, block_sector_t, struct iov_pos *,
+                          block_sector_t cnt, bool write);
+
+static void select_sector (struct ata_disk *, block_sector_t,
+                           block_sector_t cnt);
+static void issue_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -96,6 +170,7 @@ static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static softirq_func completion_softirq;
 
 /** Initialize the disk subsystem and detect disks. */
 void
@@ -103,6 +178,7 @@ ide_init (void)
 {
   size_t chan_no;
 
+  softirq_register (SOFTIRQ_BLOCK, completion_softirq);
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -125,7 +201,10 @@ ide_init (void)
         }
       lock_init (&c->lock);
       c->expecting_interrupt = false;
+      c->completed = false;
       sema_init (&c->completion_wait, 0);
+      c->bm_base = 0;
+      c->dma_busy = false;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +215,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->multiple = 1;
         }
 
       /* Register interrupt handler. */
@@ -153,6 +233,41 @@ ide_init (void)
         if (c->devices[dev_no].is_ata)
           identify_ata_device (&c->devices[dev_no]);
     }
+
+  if (!ide_pio)
+    init_dma ();
+}
+
+/** Looks for a PCI bus-master IDE controller and, if there is one,
+   sets up both channels to transfer by DMA. */
+static void
+init_dma (void)
+{
+  const struct pci_dev *pci;
+  uint32_t bar;
+  size_t chan_no;
+
+  pci = pci_find_class (0x01, 0x01, NULL);
+  if (pci == NULL || !(pci->prog_if & 0x80))
+    return;
+  bar = pci_read_bar (pci, 4);
+  if (!(bar & PCI_BAR_IO) || (bar & PCI_BAR_IO_MASK) == 0)
+    return;
+  pci_enable (pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+
+      c->prdt = palloc_get_page (PAL_ASSERT);
+      c->bounce = palloc_get_page (PAL_ASSERT);
+      c->bm_base = (bar & PCI_BAR_IO_MASK) + 8 * chan_no;
+      outl (reg_bm_prdt (c), vtop (c->prdt));
+      outb (reg_bm_command (c), 0);
+      clear_bm_status (c);
+      printf ("%s: bus-master DMA at port 0x%04"PRIx16"\n",
+              c->name, c->bm_base);
+    }
 }
 
 /** Disk detection and identification. */
@@ -265,6 +380,7 @@ identify_ata_device (struct ata_disk *d)
   char *model, *serial;
   char extra_info[128];
   struct block *block;
+  uint8_t max_multiple;
 
   ASSERT (d->is_ata);
 
@@ -272,7 +388,7 @@ identify_ata_device (struct ata_disk *d)
      indicating the device's response is ready, and read the data
      into our buffer. */
   select_device_wait (d);
-  issue_pio_command (c, CMD_IDENTIFY_DEVICE);
+  issue_command (c, CMD_IDENTIFY_DEVICE);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
     {
@@ -284,6 +400,7 @@ identify_ata_device (struct ata_disk *d)
   /* Calculate capacity.
      Read model name and serial number. */
   capacity = *(uint32_t *) &id[60 * 2];
+  max_multiple = id[47 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
   snprintf (extra_info, sizeof extra_info,
@@ -303,12 +420,37 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  set_multiple_mode (d, max_multiple);
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
 
+/** Sets disk D to transfer MAX sectors per DRQ block with READ
+   MULTIPLE and WRITE MULTIPLE, if MAX, which comes from word 47
+   of the IDENTIFY DEVICE data, is more than 1 and D accepts it.
+   Otherwise D transfers one sector per block, with READ SECTOR
+   and WRITE SECTOR. */
+static void
+set_multiple_mode (struct ata_disk *d, uint8_t max)
+{
+  struct channel *c = d->channel;
+
+  d->multiple = 1;
+  if (max <= 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), max);
+  issue_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if (!(inb (reg_alt_status (c)) & STA_ERR))
+    d->multiple = max;
+}
+
 /** Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,63 +479,258 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/** Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/** Transfers CNT sectors, starting at SEC_NO, between disk D and
+   the IOV_CNT buffers of IOV: from disk to buffers if WRITE is
+   false, from buffers to disk if it is true.  Splits the request
+   into commands of at most IDE_MAX_SECTORS sectors, each moved by
+   DMA if the channel can do it, otherwise by PIO.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_transfer (struct ata_disk *d, block_sector_t sec_no,
+              const struct block_iovec *iov, size_t iov_cnt, bool write)
 {
-  struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  struct iov_pos pos;
+  block_sector_t left = 0;
+  size_t i;
+
+  for (i = 0; i < iov_cnt; i++)
+    left += iov[i].cnt;
+  iov_pos_init (&pos, iov);
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (left > 0)
+    {
+      block_sector_t cnt = left < IDE_MAX_SECTORS ? left : IDE_MAX_SECTORS;
+      struct iov_pos start = pos;
+
+      if (c->bm_base != 0)
+        {
+          cnt = dma_transfer (d, sec_no, &pos, cnt, write);
+          if (cnt == 0)
+            {
+              /* Redo the failed command by PIO. */
+              pos = start;
+              cnt = left < IDE_MAX_SECTORS ? left : IDE_MAX_SECTORS;
+              pio_transfer (d, sec_no, &pos, cnt, write);
+            }
+        }
+      else
+        pio_transfer (d, sec_no, &pos, cnt, write);
+      sec_no += cnt;
+      left -= cnt;
+    }
   lock_release (&c->lock);
 }
 
+/** Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ide_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  struct block_iovec iov;
+
+  iov.buffer = buffer;
+  iov.cnt = 1;
+  ide_transfer (d_, sec_no, &iov, 1, false);
+}
+
 /** Write sector SEC_NO to disk D from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+   acknowledged receiving the data. */
 static void
 ide_write (void *d_, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  struct block_iovec iov;
+
+  iov.buffer = (void *) buffer;
+  iov.cnt = 1;
+  ide_transfer (d_, sec_no, &iov, 1, true);
+}
+
+/** Reads consecutive sectors of disk D, starting at SEC_NO, into
+   the IOV_CNT buffers of IOV. */
+static void
+ide_readv (void *d_, block_sector_t sec_no,
+           const struct block_iovec *iov, size_t iov_cnt)
+{
+  ide_transfer (d_, sec_no, iov, iov_cnt, false);
+}
+
+/** Writes the IOV_CNT buffers of IOV to consecutive sectors of
+   disk D, starting at SEC_NO.  Returns after the disk has
+   acknowledged receiving the data. */
+static void
+ide_writev (void *d_, block_sector_t sec_no,
+            const struct block_iovec *iov, size_t iov_cnt)
+{
+  ide_transfer (d_, sec_no, iov, iov_cnt, true);
 }
 
 static struct block_operations ide_operations =
   {
-    ide_read,
-    ide_write
+    .read = ide_read,
+    .write = ide_write,
+    .readv = ide_readv,
+    .writev = ide_writev,
   };
-
+
+/** Transfers CNT sectors, at most IDE_MAX_SECTORS, starting at
+   SEC_NO, between disk D and the buffers at POS, by PIO, in one
+   READ/WRITE MULTIPLE command if D supports it and otherwise in
+   one READ/WRITE SECTOR command.  Advances POS past them.  D's
+   channel must be locked. */
+static void
+pio_transfer (struct ata_disk *d, block_sector_t sec_no, struct iov_pos *pos,
+              block_sector_t cnt, bool write)
+{
+  struct channel *c = d->channel;
+  block_sector_t done, block, i;
+  uint8_t command;
+
+  if (d->multiple > 1)
+    command = write ? CMD_WRITE_MULTIPLE : CMD_READ_MULTIPLE;
+  else
+    command = write ? CMD_WRITE_SECTOR_RETRY : CMD_READ_SECTOR_RETRY;
+
+  select_sector (d, sec_no, cnt);
+  issue_command (c, command);
+
+  /* The disk raises DRQ for each block of D->multiple sectors.  On
+     a read, it interrupts when a block is ready; on a write, when
+     it has taken a block, the first one being ready at once. */
+  for (done = 0; done < cnt; done += block)
+    {
+      block = cnt - done < d->multiple ? cnt - done : d->multiple;
+      if (!write)
+        sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+               write ? "write" : "read", sec_no + done);
+      for (i = 0; i < block; i++)
+        if (write)
+          output_sector (c, iov_next (pos));
+        else
+          input_sector (c, iov_next (pos));
+      if (write)
+        sema_down (&c->completion_wait);
+    }
+}
+
+/** Clears the error and interrupt bits of channel C's bus-master
+   status register, keeping the others. */
+static void
+clear_bm_status (struct channel *c)
+{
+  outb (reg_bm_status (c), inb (reg_bm_status (c)) | BM_STA_ERROR | BM_STA_INTR);
+}
+
+/** Appends entries to the PRDT at *PRD to describe the SIZE bytes
+   at BUFFER, which must be reachable by DMA, splitting them at
+   64 kB boundaries, and advances *PRD past them. */
+static void
+add_prds (struct channel *c, struct prd **prd, void *buffer, size_t size)
+{
+  uintptr_t phys = vtop (buffer);
+
+  while (size > 0)
+    {
+      size_t chunk = PRD_BOUNDARY - phys % PRD_BOUNDARY;
+      if (chunk > size)
+        chunk = size;
+
+      ASSERT (*prd < c->prdt + PRD_MAX);
+      (*prd)->addr = phys;
+      (*prd)->size = chunk;
+      (*prd)->flags = 0;
+      (*prd)++;
+
+      phys += chunk;
+      size -= chunk;
+    }
+}
+
+/** Transfers up to CNT sectors, at most IDE_MAX_SECTORS, starting
+   at SEC_NO, between disk D and the buffers at POS, by bus-master
+   DMA, in one READ DMA or WRITE DMA command.  Sectors whose
+   buffers the bus master cannot reach, e.g. because they are on a
+   guarded thread stack, go through the bounce page, so that when
+   it fills the command covers fewer than CNT sectors.  Returns
+   the number of sectors transferred, and advances POS past them.
+
+   Returns 0 on failure.  Then DMA is turned off for D's channel,
+   so that the caller and later transfers use PIO, and POS is
+   left undefined.  D's channel must be locked. */
+static block_sector_t
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, struct iov_pos *pos,
+              block_sector_t cnt, bool write)
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BM_CMD_READ;
+  struct dma_bounce bounce;
+  struct prd *prd = c->prdt;
+  block_sector_t done = 0;
+  uint8_t status;
+
+  /* Describe the buffers, one run of sectors contiguous in memory
+     at a time.  What does not fit in the bounce page is left for
+     the next command. */
+  dma_bounce_init (&bounce, c->bounce);
+  while (done < cnt)
+    {
+      void *buffer;
+      block_sector_t run = iov_next_run (pos, cnt - done, &buffer);
+
+      if (!dma_reachable (buffer, run * BLOCK_SECTOR_SIZE))
+        {
+          run = dma_bounce_add (&bounce, pos, &buffer, run, write);
+          if (run == 0)
+            break;
+        }
+      add_prds (c, &prd, buffer, run * BLOCK_SECTOR_SIZE);
+      done += run;
+    }
+  ASSERT (done > 0);
+  prd[-1].flags = PRD_EOT;
+
+  outb (reg_bm_command (c), direction);
+  clear_bm_status (c);
+  select_sector (d, sec_no, done);
+  c->dma_busy = true;
+  issue_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+  sema_down (&c->completion_wait);
+
+  status = inb (reg_alt_status (c));
+  if ((c->bm_status & BM_STA_ERROR) || (status & (STA_ERR | STA_DF)))
+    {
+      printf ("%s: DMA %s failed, sector=%"PRDSNu", status=0x%02x, "
+              "bus-master status=0x%02x; using PIO\n",
+              d->name, write ? "write" : "read", sec_no, status, c->bm_status);
+      c->bm_base = 0;
+      return 0;
+    }
+
+  if (!write)
+    dma_bounce_copy_back (&bounce);
+  return done;
+}
+
 /** Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
+   writes SEC_NO and the count CNT, which must be between 1 and
+   IDE_MAX_SECTORS, to the disk's sector selection registers.  (We
    use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= IDE_MAX_SECTORS);
+  ASSERT (sec_no + cnt <= (1UL << 28));
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == IDE_MAX_SECTORS ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -404,7 +741,7 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
 /** Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
-issue_pio_command (struct channel *c, uint8_t command) 
+issue_command (struct channel *c, uint8_t command) 
 {
   /* Interrupts must be enabled or our semaphore will never be
      up'd by the completion handler. */
@@ -502,7 +839,8 @@ select_device_wait (const struct ata_disk *d)
   wait_until_idle (d);
 }
 
-/** ATA interrupt handler. */
+/** ATA interrupt handler.  Acknowledges the interrupt and
+   leaves waking the waiter to completion_softirq(). */
 static void
 interrupt_handler (struct intr_frame *f) 
 {
@@ -513,8 +851,17 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
+            if (c->dma_busy)
+              {
+                /* Stop the bus master and clear its status. */
+                c->bm_status = inb (reg_bm_status (c));
+                outb (reg_bm_command (c), 0);
+                clear_bm_status (c);
+                c->dma_busy = false;
+              }
             inb (reg_status (c));               /**< Acknowledge interrupt. */
-            sema_up (&c->completion_wait);      /**< Wake up waiter. */
+            c->completed = true;
+            softirq_raise (SOFTIRQ_BLOCK);
           }
         else
           printf ("%s: unexpected interrupt\n", c->name);
@@ -524,4 +871,21 @@ interrupt_handler (struct intr_frame *f)
   NOT_REACHED ();
 }
 
+/** Block softirq.  Wakes up the thread waiting on each channel
+   whose interrupt has come in. */
+static void
+completion_softirq (void)
+{
+  struct channel *c;
 
+  for (c = channels; c < channels + CHANNEL_CNT; c++)
+    {
+      enum intr_level old_level = intr_disable ();
+      if (c->completed)
+        {
+          c->completed = false;
+          sema_up (&c->completion_wait);        /**< Wake up waiter. */
+        }
+      intr_set_level (old_level);
+    }
+}
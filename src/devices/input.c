@@ -14,14 +14,19 @@ input_init (void)
 }
 
 /** Adds a key to the input buffer.
-   Interrupts must be off and the buffer must not be full. */
+   Interrupts must be off and the buffer must not be full.  The
+   keyboard and the serial port may fill it from different CPUs
+   between input_full() and this call, so a key that no longer
+   fits is dropped. */
 void
 input_putc (uint8_t key) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT (!intq_full (&buffer));
 
-  intq_putc (&buffer, key);
+  spin_acquire (&buffer.spin);
+  if (!intq_full (&buffer))
+    intq_putc (&buffer, key);
+  spin_release (&buffer.spin);
   serial_notify ();
 }
 
@@ -34,7 +39,9 @@ input_getc (void)
   uint8_t key;
 
   old_level = intr_disable ();
+  spin_acquire (&buffer.spin);
   key = intq_getc (&buffer);
+  spin_release (&buffer.spin);
   serial_notify ();
   intr_set_level (old_level);
   
@@ -47,6 +54,11 @@ input_getc (void)
 bool
 input_full (void) 
 {
+  bool full;
+
   ASSERT (intr_get_level () == INTR_OFF);
-  return intq_full (&buffer);
+  spin_acquire (&buffer.spin);
+  full = intq_full (&buffer);
+  spin_release (&buffer.spin);
+  return full;
 }
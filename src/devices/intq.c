@@ -11,6 +11,7 @@ void
 intq_init (struct intq *q) 
 {
   lock_init (&q->lock);
+  spin_init (&q->spin);
   q->not_full = q->not_empty = NULL;
   q->head = q->tail = 0;
 }
@@ -43,9 +44,14 @@ intq_getc (struct intq *q)
   while (intq_empty (q)) 
     {
       ASSERT (!intr_context ());
+      spin_release (&q->spin);
       lock_acquire (&q->lock);
-      wait (q, &q->not_empty);
+      spin_acquire (&q->spin);
+      if (intq_empty (q))
+        wait (q, &q->not_empty);
+      spin_release (&q->spin);
       lock_release (&q->lock);
+      spin_acquire (&q->spin);
     }
   
   byte = q->buf[q->tail];
@@ -64,9 +70,14 @@ intq_putc (struct intq *q, uint8_t byte)
   while (intq_full (q))
     {
       ASSERT (!intr_context ());
+      spin_release (&q->spin);
       lock_acquire (&q->lock);
-      wait (q, &q->not_full);
+      spin_acquire (&q->spin);
+      if (intq_full (q))
+        wait (q, &q->not_full);
+      spin_release (&q->spin);
       lock_release (&q->lock);
+      spin_acquire (&q->spin);
     }
 
   q->buf[q->head] = byte;
@@ -82,17 +93,20 @@ next (int pos)
 }
 
 /** WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+   member.  Waits until the given condition is true.  Q's `spin'
+   must be held; it is released while asleep. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter) 
+wait (struct intq *q, struct thread **waiter) 
 {
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&q->spin));
   ASSERT ((waiter == &q->not_empty && intq_empty (q))
           || (waiter == &q->not_full && intq_full (q)));
 
   *waiter = thread_current ();
-  thread_block ();
+  thread_block_unlock (&q->spin);
+  spin_acquire (&q->spin);
 }
 
 /** WAITER must be the address of Q's not_empty or not_full
@@ -2,6 +2,7 @@
 #define DEVICES_INTQ_H
 
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 
 /** An "interrupt queue", a circular buffer shared between
@@ -9,7 +10,10 @@
 
    Interrupt queue functions can be called from kernel threads or
    from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
+   interrupts must be off in either case, and the caller must
+   hold the queue's `spin' lock, or a lock of its own that covers
+   the queue.  intq_getc() and intq_putc() may sleep only in the
+   first case; they release `spin' while asleep.
 
    The interrupt queue has the structure of a "monitor".  Locks
    and condition variables from threads/synch.h cannot be used in
@@ -27,6 +31,7 @@ struct intq
     struct lock lock;           /**< Only one thread may wait at once. */
     struct thread *not_full;    /**< Thread waiting for not-full condition. */
     struct thread *not_empty;   /**< Thread waiting for not-empty condition. */
+    struct spinlock spin;       /**< Guards the rest. */
 
     /* Queue. */
     uint8_t buf[INTQ_BUFSIZE];  /**< Buffer. */
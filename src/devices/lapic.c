@@ -0,0 +1,224 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+
+/** Local Advanced Programmable Interrupt Controller (APIC).
+   Every CPU has one, memory-mapped at the same physical address.
+   Refer to [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)" for details.
+
+   The 8259A PICs keep delivering device interrupts to the boot
+   CPU, through its local APIC's LINT0 pin in virtual wire mode,
+   so the local APIC is only used for inter-processor interrupts
+   and for the timer of each application processor. */
+
+/** Register offsets, in bytes. */
+#define LAPIC_ID     0x020      /**< ID. */
+#define LAPIC_TPR    0x080      /**< Task priority. */
+#define LAPIC_EOI    0x0b0      /**< End of interrupt. */
+#define LAPIC_SVR    0x0f0      /**< Spurious interrupt vector. */
+#define LAPIC_ESR    0x280      /**< Error status. */
+#define LAPIC_ICRLO  0x300      /**< Interrupt command, low word. */
+#define LAPIC_ICRHI  0x310      /**< Interrupt command, high word. */
+#define LAPIC_TIMER  0x320      /**< Local vector table: timer. */
+#define LAPIC_LINT0  0x350      /**< Local vector table: LINT0. */
+#define LAPIC_LINT1  0x360      /**< Local vector table: LINT1. */
+#define LAPIC_ERROR  0x370      /**< Local vector table: error. */
+#define LAPIC_TICR   0x380      /**< Timer initial count. */
+#define LAPIC_TCCR   0x390      /**< Timer current count. */
+#define LAPIC_TDCR   0x3e0      /**< Timer divide configuration. */
+
+/** Register bits. */
+#define SVR_ENABLE      0x00000100      /**< APIC software enable. */
+#define LVT_MASKED      0x00010000      /**< Interrupt masked. */
+#define TIMER_PERIODIC  0x00020000      /**< Periodic timer mode. */
+#define TDCR_DIV16      0x00000003      /**< Divide bus clock by 16. */
+#define ICR_INIT        0x00000500      /**< INIT delivery mode. */
+#define ICR_STARTUP     0x00000600      /**< Start-up delivery mode. */
+#define ICR_PENDING     0x00001000      /**< Delivery status: send pending. */
+#define ICR_ASSERT      0x00004000      /**< Level assert. */
+#define ICR_LEVEL       0x00008000      /**< Level triggered. */
+
+/** Number of timer ticks to measure the APIC timer against. */
+#define CALIBRATE_TICKS 10
+
+/** Base of the memory-mapped registers, or NULL if not mapped. */
+static volatile uint32_t *lapic;
+
+/** APIC timer counts per timer tick (1/TIMER_FREQ second). */
+static uint32_t counts_per_tick;
+
+static void *map_mmio (uintptr_t paddr);
+static void calibrate (void);
+
+static inline uint32_t
+lapic_read (int reg)
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+static inline void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / sizeof *lapic] = value;
+  lapic[LAPIC_ID / sizeof *lapic];      /* Wait for the write to finish. */
+}
+
+/** Software-enables the calling CPU's local APIC and clears any
+   stale error or in-service state. */
+static void
+enable (void)
+{
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+  lapic_write (LAPIC_ERROR, LVT_MASKED);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_EOI, 0);
+  lapic_write (LAPIC_TPR, 0);
+}
+
+/** Maps the local APIC registers at physical address PADDR,
+   enables the boot CPU's local APIC, and measures its timer
+   against the PIT.  Must be called with interrupts on, after
+   timer_calibrate(). */
+void
+lapic_init (uintptr_t paddr)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  lapic = map_mmio (paddr);
+
+  /* Leave LINT0 and LINT1 as the BIOS set them up: they carry
+     the PIC's interrupts and NMI to this CPU. */
+  enable ();
+  lapic_write (LAPIC_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+  calibrate ();
+}
+
+/** Enables the calling application processor's local APIC and
+   starts its periodic timer at TIMER_FREQ Hz. */
+void
+lapic_init_ap (void)
+{
+  ASSERT (lapic != NULL);
+
+  lapic_write (LAPIC_LINT0, LVT_MASKED);
+  lapic_write (LAPIC_LINT1, LVT_MASKED);
+  enable ();
+
+  lapic_write (LAPIC_TDCR, TDCR_DIV16);
+  lapic_write (LAPIC_TIMER, TIMER_PERIODIC | LAPIC_TIMER_VEC);
+  lapic_write (LAPIC_TICR, counts_per_tick);
+}
+
+/** Returns the calling CPU's local APIC ID. */
+uint8_t
+lapic_id (void)
+{
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/** Acknowledges the interrupt being serviced on the calling CPU. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/** Waits until the previous interrupt command has been sent. */
+static void
+wait_icr (void)
+{
+  while (lapic_read (LAPIC_ICRLO) & ICR_PENDING)
+    continue;
+}
+
+/** Sends the fixed interrupt VEC to the CPU whose local APIC ID
+   is APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  wait_icr ();
+  lapic_write (LAPIC_ICRHI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICRLO, vec);
+  wait_icr ();
+}
+
+/** Starts the application processor whose local APIC ID is
+   APIC_ID executing real-mode code at START_PADDR, which must be
+   page-aligned and below 1 MB.  This is the INIT-SIPI-SIPI
+   sequence of [MP] appendix B.4. */
+void
+lapic_start_ap (uint8_t apic_id, uintptr_t start_paddr)
+{
+  int i;
+
+  ASSERT (start_paddr % PGSIZE == 0 && start_paddr < 0x100000);
+
+  wait_icr ();
+  lapic_write (LAPIC_ICRHI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICRLO, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  lapic_write (LAPIC_ICRLO, ICR_INIT | ICR_LEVEL);
+  timer_mdelay (10);
+
+  for (i = 0; i < 2; i++)
+    {
+      wait_icr ();
+      lapic_write (LAPIC_ICRHI, (uint32_t) apic_id << 24);
+      lapic_write (LAPIC_ICRLO, ICR_STARTUP | (start_paddr >> PGBITS));
+      timer_udelay (200);
+    }
+  wait_icr ();
+}
+
+/** Maps the page at physical address PADDR, which must lie above
+   all RAM, at the same kernel virtual address in init_page_dir
+   with caching disabled, and returns that address. */
+static void *
+map_mmio (uintptr_t paddr)
+{
+  uint32_t *vaddr = (uint32_t *) paddr;
+  uint32_t *pde, *pt;
+
+  ASSERT (paddr % PGSIZE == 0);
+  ASSERT (paddr >= (uintptr_t) PHYS_BASE + init_ram_pages * PGSIZE);
+
+  pde = init_page_dir + pd_no (vaddr);
+  if (*pde == 0)
+    {
+      pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      *pde = pde_create (pt);
+    }
+  pt = pde_get_pt (*pde);
+  pt[pt_no (vaddr)] = paddr | PTE_PCD | PTE_PWT | PTE_W | PTE_P;
+  return vaddr;
+}
+
+/** Counts how far the APIC timer runs down in CALIBRATE_TICKS
+   timer ticks. */
+static void
+calibrate (void)
+{
+  int64_t start;
+
+  lapic_write (LAPIC_TDCR, TDCR_DIV16);
+
+  /* Start counting on a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  start = timer_ticks ();
+
+  lapic_write (LAPIC_TICR, UINT32_MAX);
+  while (timer_elapsed (start) < CALIBRATE_TICKS)
+    continue;
+  counts_per_tick = (UINT32_MAX - lapic_read (LAPIC_TCCR)) / CALIBRATE_TICKS;
+  lapic_write (LAPIC_TICR, 0);
+}
@@ -0,0 +1,22 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Interrupt vectors delivered through the local APIC.  They are
+   above the PIC's 0x20...0x2f, and the spurious vector has its
+   low 4 bits set as older APICs require. */
+#define LAPIC_TIMER_VEC    0xf0   /**< Per-CPU timer on application processors. */
+#define LAPIC_RESCHED_VEC  0xf1   /**< Inter-processor "please reschedule". */
+#define LAPIC_TLB_VEC      0xf2   /**< Inter-processor TLB shootdown. */
+#define LAPIC_SPURIOUS_VEC 0xff   /**< Spurious interrupt. */
+
+void lapic_init (uintptr_t paddr);
+void lapic_init_ap (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_start_ap (uint8_t apic_id, uintptr_t start_paddr);
+
+#endif /**< devices/lapic.h */
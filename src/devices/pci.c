@@ -0,0 +1,194 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/spinlock.h"
+
+/** PCI bus enumeration and configuration space access, through
+   configuration mechanism #1.  Refer to [PCI] for details.
+
+   pci_init() probes every bus, device and function once at boot
+   and records what it finds, so that drivers can look up their
+   devices without touching the hardware again. */
+
+/** Configuration mechanism #1 ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8        /**< Selects a register. */
+#define PCI_CONFIG_DATA 0xcfc           /**< Reads or writes it. */
+
+/** Held from selecting a register until its data is accessed. */
+static struct spinlock config_lock = SPINLOCK_INITIALIZER;
+
+/** Configuration space header registers used here. */
+#define PCI_ID 0x00             /**< Vendor ID, device ID. */
+#define PCI_CLASS 0x08          /**< Revision, class codes. */
+#define PCI_HEADER 0x0c         /**< Header type in bits 16...23. */
+#define PCI_INTERRUPT 0x3c      /**< Interrupt line in bits 0...7. */
+
+#define PCI_HEADER_MULTI 0x80   /**< Header type bit: multi-function. */
+
+#define PCI_BUS_CNT 256
+#define PCI_SLOT_CNT 32
+#define PCI_FUNC_CNT 8
+
+/** Functions found by pci_init(). */
+#define PCI_DEV_MAX 32
+static struct pci_dev devs[PCI_DEV_MAX];
+static size_t dev_cnt;
+
+static uint32_t read_config (int bus, int slot, int func, uint8_t offset);
+static void select_config (int bus, int slot, int func, uint8_t offset);
+static void probe_function (int bus, int slot, int func);
+
+/** Finds the PCI functions in the system. */
+void
+pci_init (void)
+{
+  int bus, slot, func;
+
+  for (bus = 0; bus < PCI_BUS_CNT; bus++)
+    for (slot = 0; slot < PCI_SLOT_CNT; slot++)
+      {
+        if ((read_config (bus, slot, 0, PCI_ID) & 0xffff) == 0xffff)
+          continue;
+        probe_function (bus, slot, 0);
+        if (read_config (bus, slot, 0, PCI_HEADER) >> 16 & PCI_HEADER_MULTI)
+          for (func = 1; func < PCI_FUNC_CNT; func++)
+            probe_function (bus, slot, func);
+      }
+  printf ("pci: %zu functions found\n", dev_cnt);
+}
+
+/** Returns the first PCI function after PREV, or the first one at
+   all if PREV is null, with the given CLASS and SUBCLASS, or a
+   null pointer if there is no such function. */
+const struct pci_dev *
+pci_find_class (uint8_t class, uint8_t subclass, const struct pci_dev *prev)
+{
+  const struct pci_dev *d;
+
+  for (d = prev != NULL ? prev + 1 : devs; d < devs + dev_cnt; d++)
+    if (d->class == class && d->subclass == subclass)
+      return d;
+  return NULL;
+}
+
+/** Returns the first PCI function after PREV, or the first one at
+   all if PREV is null, with the given VENDOR_ID and DEVICE_ID, or
+   a null pointer if there is no such function. */
+const struct pci_dev *
+pci_find_device (uint16_t vendor_id, uint16_t device_id,
+                 const struct pci_dev *prev)
+{
+  const struct pci_dev *d;
+
+  for (d = prev != NULL ? prev + 1 : devs; d < devs + dev_cnt; d++)
+    if (d->vendor_id == vendor_id && d->device_id == device_id)
+      return d;
+  return NULL;
+}
+
+/** Returns the 32-bit configuration register of D at OFFSET,
+   which must be a multiple of 4. */
+uint32_t
+pci_read_config (const struct pci_dev *d, uint8_t offset)
+{
+  return read_config (d->bus, d->slot, d->func, offset);
+}
+
+/** Writes VALUE to the 32-bit configuration register of D at
+   OFFSET, which must be a multiple of 4. */
+void
+pci_write_config (const struct pci_dev *d, uint8_t offset, uint32_t value)
+{
+  enum intr_level old_level = intr_disable ();
+  spin_acquire (&config_lock);
+  select_config (d->bus, d->slot, d->func, offset);
+  outl (PCI_CONFIG_DATA, value);
+  spin_release (&config_lock);
+  intr_set_level (old_level);
+}
+
+/** Returns base address register BAR of D, including its type
+   bits. */
+uint32_t
+pci_read_bar (const struct pci_dev *d, int bar)
+{
+  ASSERT (bar >= 0 && bar < 6);
+
+  return pci_read_config (d, PCI_BAR (bar));
+}
+
+/** Sets COMMAND_BITS, a set of PCI_COMMAND_* bits, in D's command
+   register. */
+void
+pci_enable (const struct pci_dev *d, uint16_t command_bits)
+{
+  uint32_t reg = pci_read_config (d, PCI_COMMAND);
+
+  /* The upper half is the status register, whose bits are
+     cleared by writing 1s, so write 0s there. */
+  pci_write_config (d, PCI_COMMAND, (reg & 0xffff) | command_bits);
+}
+
+/** Returns the 32-bit configuration register at OFFSET of
+   function FUNC of device SLOT on bus BUS. */
+static uint32_t
+read_config (int bus, int slot, int func, uint8_t offset)
+{
+  enum intr_level old_level;
+  uint32_t value;
+
+  old_level = intr_disable ();
+  spin_acquire (&config_lock);
+  select_config (bus, slot, func, offset);
+  value = inl (PCI_CONFIG_DATA);
+  spin_release (&config_lock);
+  intr_set_level (old_level);
+  return value;
+}
+
+/** Points PCI_CONFIG_DATA at the 32-bit configuration register at
+   OFFSET, which must be a multiple of 4, of function FUNC of
+   device SLOT on bus BUS.  Interrupts must be off and
+   config_lock held until the data port has been accessed. */
+static void
+select_config (int bus, int slot, int func, uint8_t offset)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&config_lock));
+  ASSERT (offset % 4 == 0);
+
+  outl (PCI_CONFIG_ADDRESS,
+        0x80000000 | (bus << 16) | (slot << 11) | (func << 8) | offset);
+}
+
+/** Records function FUNC of device SLOT on bus BUS, if it
+   exists. */
+static void
+probe_function (int bus, int slot, int func)
+{
+  uint32_t id = read_config (bus, slot, func, PCI_ID);
+  uint32_t class = read_config (bus, slot, func, PCI_CLASS);
+  struct pci_dev *d;
+
+  if ((id & 0xffff) == 0xffff)
+    return;
+  if (dev_cnt >= PCI_DEV_MAX)
+    {
+      printf ("pci: too many functions, ignoring %02x:%02x.%d\n",
+              bus, slot, func);
+      return;
+    }
+
+  d = &devs[dev_cnt++];
+  d->bus = bus;
+  d->slot = slot;
+  d->func = func;
+  d->vendor_id = id;
+  d->device_id = id >> 16;
+  d->class = class >> 24;
+  d->subclass = class >> 16;
+  d->prog_if = class >> 8;
+  d->irq_line = read_config (bus, slot, func, PCI_INTERRUPT);
+}
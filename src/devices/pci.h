@@ -0,0 +1,46 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** A PCI function, as found by pci_init(). */
+struct pci_dev
+  {
+    uint8_t bus;                /**< Bus number. */
+    uint8_t slot;               /**< Device number on the bus. */
+    uint8_t func;               /**< Function number in the device. */
+    uint16_t vendor_id;         /**< Vendor ID. */
+    uint16_t device_id;         /**< Device ID. */
+    uint8_t class;              /**< Base class code. */
+    uint8_t subclass;           /**< Subclass code. */
+    uint8_t prog_if;            /**< Programming interface. */
+    uint8_t irq_line;           /**< Interrupt line the BIOS routed it to. */
+  };
+
+/** Configuration space registers. */
+#define PCI_COMMAND 0x04                /**< Command (16 bits). */
+#define PCI_BAR(N) (0x10 + 4 * (N))     /**< Base address register N. */
+
+/** Command register bits. */
+#define PCI_COMMAND_IO 0x0001           /**< Respond to I/O space. */
+#define PCI_COMMAND_MEMORY 0x0002       /**< Respond to memory space. */
+#define PCI_COMMAND_MASTER 0x0004       /**< Enable bus mastering. */
+
+/** Base address register bits. */
+#define PCI_BAR_IO 0x00000001           /**< Set for an I/O space BAR. */
+#define PCI_BAR_IO_MASK 0xfffffffc      /**< I/O port base. */
+#define PCI_BAR_MEM_MASK 0xfffffff0     /**< Memory base. */
+
+void pci_init (void);
+const struct pci_dev *pci_find_class (uint8_t class, uint8_t subclass,
+                                      const struct pci_dev *prev);
+const struct pci_dev *pci_find_device (uint16_t vendor_id, uint16_t device_id,
+                                       const struct pci_dev *prev);
+
+uint32_t pci_read_config (const struct pci_dev *, uint8_t offset);
+void pci_write_config (const struct pci_dev *, uint8_t offset, uint32_t);
+uint32_t pci_read_bar (const struct pci_dev *, int bar);
+void pci_enable (const struct pci_dev *, uint16_t command_bits);
+
+#endif /**< devices/pci.h */
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/spinlock.h"
 
 /** Interface to 8254 Programmable Interrupt Timer (PIT).
    Refer to [8254] for details. */
@@ -11,8 +12,9 @@
 #define PIT_PORT_CONTROL          0x43                /**< Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /**< Counter port. */
 
-/** PIT cycles per second. */
-#define PIT_HZ 1193180
+/** Guards the ports, since every channel is programmed through
+   the one control port. */
+static struct spinlock pit_lock = SPINLOCK_INITIALIZER;
 
 /** Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
@@ -76,8 +78,51 @@ pit_configure_channel (int channel, int mode, int frequency)
 
   /* Configure the PIT mode and load its counters. */
   old_level = intr_disable ();
+  spin_acquire (&pit_lock);
   outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (mode << 1));
   outb (PIT_PORT_COUNTER (channel), count);
   outb (PIT_PORT_COUNTER (channel), count >> 8);
+  spin_release (&pit_lock);
   intr_set_level (old_level);
 }
+
+/** Makes CHANNEL count down once from COUNT PIT cycles and then
+   raise its output, which for channel 0 interrupts once.  This is
+   mode 0, "interrupt on terminal count".  A COUNT of 0 is treated
+   as 65536.  Call pit_configure_channel() to go back to a
+   periodic mode. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  spin_acquire (&pit_lock);
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (0 << 1));
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  spin_release (&pit_lock);
+  intr_set_level (old_level);
+}
+
+/** Returns the number of PIT cycles CHANNEL has left to count
+   down, using the counter latch command. */
+uint16_t
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint8_t lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  spin_acquire (&pit_lock);
+  outb (PIT_PORT_CONTROL, channel << 6);
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  spin_release (&pit_lock);
+  intr_set_level (old_level);
+  return lo | (hi << 8);
+}
@@ -0,0 +1,121 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/** A RAM disk, "ram0", whose sectors live in pages from the
+   kernel pool.  It costs no more than a memcpy() per request, so
+   it is a fast home for swap or scratch data and lets benchmarks
+   tell the kernel's own CPU time apart from time spent in an
+   emulated disk.  It is empty at boot unless it is preloaded
+   from another block device, such as a scratch partition built
+   by the "pintos" utility. */
+
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static uint8_t **pages;         /**< Pages holding the sectors, in order. */
+
+static struct block_operations ramdisk_operations;
+
+/** Creates the RAM disk with room for SIZE_KB kB and registers it
+   with the block layer, if SIZE_KB is nonzero or IMAGE_NAME is
+   non-null.  If IMAGE_NAME is non-null, the RAM disk starts out
+   with the contents of the block device of that name, and if
+   SIZE_KB is 0 it is the same size as that device.  Panics if
+   there is no such device or if the kernel pool cannot hold the
+   RAM disk. */
+void
+ramdisk_init (size_t size_kb, const char *image_name)
+{
+  struct block *image = NULL;
+  block_sector_t size, image_cnt = 0;
+  size_t page_cnt, i;
+  char extra_info[32];
+
+  if (image_name != NULL)
+    {
+      image = block_get_by_name (image_name);
+      if (image == NULL)
+        PANIC ("ram0: no such block device \"%s\"", image_name);
+      image_cnt = block_size (image);
+    }
+  size = size_kb != 0 ? size_kb * (1024 / BLOCK_SECTOR_SIZE) : image_cnt;
+  if (size == 0)
+    return;
+  if (image_cnt > size)
+    image_cnt = size;
+
+  page_cnt = DIV_ROUND_UP (size, SECTORS_PER_PAGE);
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC ("ram0: out of memory for page table");
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        PANIC ("ram0: kernel pool too small for %'"PRDSNu" sectors", size);
+    }
+
+  /* Preload, a page at a time. */
+  for (i = 0; i * SECTORS_PER_PAGE < image_cnt; i++)
+    {
+      block_sector_t sector = i * SECTORS_PER_PAGE;
+      block_sector_t cnt = image_cnt - sector;
+      if (cnt > SECTORS_PER_PAGE)
+        cnt = SECTORS_PER_PAGE;
+      block_read_multiple (image, sector, cnt, pages[i]);
+    }
+
+  if (image != NULL)
+    snprintf (extra_info, sizeof extra_info, "RAM disk, copy of %s",
+              block_name (image));
+  else
+    strlcpy (extra_info, "RAM disk", sizeof extra_info);
+  block_register ("ram0", BLOCK_RAW, extra_info, size,
+                  &ramdisk_operations, NULL);
+}
+
+/** Carries out request RQ at once, in the submitter's context,
+   and completes it. */
+static void
+ramdisk_submit (void *aux UNUSED, struct block_request *rq)
+{
+  block_sector_t sector = rq->sector;
+  size_t i;
+
+  for (i = 0; i < rq->iov_cnt; i++)
+    {
+      const struct block_iovec *iov = &rq->iov[i];
+      block_sector_t done = 0;
+
+      /* Copy up to a page boundary at a time. */
+      while (done < iov->cnt)
+        {
+          block_sector_t ofs = sector % SECTORS_PER_PAGE;
+          block_sector_t cnt = SECTORS_PER_PAGE - ofs;
+          uint8_t *disk = pages[sector / SECTORS_PER_PAGE]
+                          + ofs * BLOCK_SECTOR_SIZE;
+          uint8_t *buffer = (uint8_t *) iov->buffer + done * BLOCK_SECTOR_SIZE;
+
+          if (cnt > iov->cnt - done)
+            cnt = iov->cnt - done;
+          if (rq->write)
+            memcpy (disk, buffer, cnt * BLOCK_SECTOR_SIZE);
+          else
+            memcpy (buffer, disk, cnt * BLOCK_SECTOR_SIZE);
+          sector += cnt;
+          done += cnt;
+        }
+    }
+  block_complete (rq);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    .submit = ramdisk_submit,
+  };
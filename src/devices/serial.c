@@ -5,6 +5,9 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/softirq.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -54,10 +57,20 @@ static enum { UNINIT, POLL, QUEUE } mode;
 /** Data to be transmitted. */
 static struct intq txq;
 
+/** Data received, not yet passed to the input buffer. */
+static struct intq rxq;
+static struct cpu *delivering;  /**< CPU in deliver_input(), if any. */
+
+/** Guards the UART, both queues, and DELIVERING.  Neither queue
+   is ever waited on, so their own locks are not used. */
+static struct spinlock serial_lock = SPINLOCK_INITIALIZER;
+
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
+static void deliver_input (void);
 static intr_handler_func serial_interrupt;
+static softirq_func serial_softirq;
 
 /** Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
@@ -72,6 +85,7 @@ init_poll (void)
   set_serial (9600);                    /**< 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /**< Required to enable interrupts. */
   intq_init (&txq);
+  intq_init (&rxq);
   mode = POLL;
 } 
 
@@ -88,9 +102,12 @@ serial_init_queue (void)
   ASSERT (mode == POLL);
 
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+  softirq_register (SOFTIRQ_SERIAL, serial_softirq);
   mode = QUEUE;
   old_level = intr_disable ();
+  spin_acquire (&serial_lock);
   write_ier ();
+  spin_release (&serial_lock);
   intr_set_level (old_level);
 }
 
@@ -100,6 +117,7 @@ serial_putc (uint8_t byte)
 {
   enum intr_level old_level = intr_disable ();
 
+  spin_acquire (&serial_lock);
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
@@ -112,19 +130,19 @@ serial_putc (uint8_t byte)
     {
       /* Otherwise, queue a byte and update the interrupt enable
          register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      if (intq_full (&txq)) 
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
+          /* The transmit queue is full.  Waiting for it to
+             empty would mean sleeping with serial_lock held,
+             which the serial interrupt needs to empty it, so
+             we'll send a character via polling instead. */
           putc_poll (intq_getc (&txq)); 
         }
 
       intq_putc (&txq, byte); 
       write_ier ();
     }
+  spin_release (&serial_lock);
   
   intr_set_level (old_level);
 }
@@ -135,12 +153,15 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
+  spin_acquire (&serial_lock);
   while (!intq_empty (&txq))
     putc_poll (intq_getc (&txq));
+  spin_release (&serial_lock);
   intr_set_level (old_level);
 }
 
-/** The fullness of the input buffer may have changed.  Reassess
+/** The fullness of the input buffer may have changed.  Passes
+   on any received bytes there is now room for, and reassesses
    whether we should block receive interrupts.
    Called by the input buffer routines when characters are added
    to or removed from the buffer. */
@@ -148,8 +169,14 @@ void
 serial_notify (void) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  if (mode == QUEUE)
-    write_ier ();
+
+  /* deliver_input() itself calls back in here, on its own CPU. */
+  if (mode == QUEUE && delivering != cpu_current ())
+    {
+      spin_acquire (&serial_lock);
+      deliver_input ();
+      spin_release (&serial_lock);
+    }
 }
 
 /** Configures the serial port for BPS bits per second. */
@@ -179,6 +206,7 @@ write_ier (void)
   uint8_t ier = 0;
 
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&serial_lock));
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
@@ -187,7 +215,7 @@ write_ier (void)
 
   /* Enable receive interrupt if we have room to store any
      characters we receive. */
-  if (!input_full ())
+  if (!intq_full (&rxq))
     ier |= IER_RECV;
   
   outb (IER_REG, ier);
@@ -205,18 +233,41 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
-/** Serial interrupt handler. */
+/** Moves received bytes into the input buffer while it has
+   room, then updates the interrupt enable register.  Interrupts
+   must be off and serial_lock held. */
+static void
+deliver_input (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&serial_lock));
+
+  /* input_putc() calls back into serial_notify(). */
+  delivering = cpu_current ();
+  while (!intq_empty (&rxq) && !input_full ())
+    input_putc (intq_getc (&rxq));
+  delivering = NULL;
+  write_ier ();
+}
+
+/** Serial interrupt handler.  Moves bytes between the UART and
+   the queues, and leaves passing received bytes on to
+   serial_softirq(). */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
 {
+  spin_acquire (&serial_lock);
+
   /* Inquire about interrupt in UART.  Without this, we can
      occasionally miss an interrupt running under QEMU. */
   inb (IIR_REG);
 
   /* As long as we have room to receive a byte, and the hardware
      has a byte for us, receive a byte.  */
-  while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
-    input_putc (inb (RBR_REG));
+  while (!intq_full (&rxq) && (inb (LSR_REG) & LSR_DR) != 0)
+    intq_putc (&rxq, inb (RBR_REG));
+  if (!intq_empty (&rxq))
+    softirq_raise (SOFTIRQ_SERIAL);
 
   /* As long as we have a byte to transmit, and the hardware is
      ready to accept a byte for transmission, transmit a byte. */
@@ -225,4 +276,17 @@ serial_interrupt (struct intr_frame *f UNUSED)
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
+  spin_release (&serial_lock);
+}
+
+/** Serial softirq.  Passes received bytes on to the input
+   buffer. */
+static void
+serial_softirq (void)
+{
+  enum intr_level old_level = intr_disable ();
+  spin_acquire (&serial_lock);
+  deliver_input ();
+  spin_release (&serial_lock);
+  intr_set_level (old_level);
 }
@@ -2,6 +2,7 @@
 #include "devices/pit.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "devices/timer.h"
 
 /** Speaker port enable I/O register. */
@@ -10,6 +11,10 @@
 /** Speaker port enable bits. */
 #define SPEAKER_GATE_ENABLE	0x03
 
+/** Guards the gate register, which is read, modified and written
+   back. */
+static struct spinlock gate_lock = SPINLOCK_INITIALIZER;
+
 /** Sets the PC speaker to emit a tone at the given FREQUENCY, in
    Hz. */
 void
@@ -22,7 +27,9 @@ speaker_on (int frequency)
          connect the timer channel output to the speaker. */
       enum intr_level old_level = intr_disable ();
       pit_configure_channel (2, 3, frequency);
+      spin_acquire (&gate_lock);
       outb (SPEAKER_PORT_GATE, inb (SPEAKER_PORT_GATE) | SPEAKER_GATE_ENABLE);
+      spin_release (&gate_lock);
       intr_set_level (old_level);
     }
   else
@@ -39,7 +46,9 @@ void
 speaker_off (void)
 {
   enum intr_level old_level = intr_disable ();
+  spin_acquire (&gate_lock);
   outb (SPEAKER_PORT_GATE, inb (SPEAKER_PORT_GATE) & ~SPEAKER_GATE_ENABLE);
+  spin_release (&gate_lock);
   intr_set_level (old_level);
 }
 
@@ -0,0 +1,268 @@
+#include "devices/timeout.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
+
+/** Kernel timers, kept on a hierarchical timing wheel.
+
+   The root wheel has one slot for each of the next ROOT_SIZE
+   ticks.  Each outer wheel has LEVEL_SIZE slots, each covering
+   as many ticks as a full turn of the wheel inside it.  A timeout
+   goes into the innermost wheel whose span reaches its expiry
+   tick, in the slot given by the matching bits of that tick, so
+   arming and cancelling are O(1) list operations.
+
+   Each time the root wheel completes a turn, the next slot of
+   the first outer wheel is emptied back into the root wheel (and
+   so on outward), so every timeout is moved at most once per
+   level.  Expiry ticks further out than the whole wheel spans are
+   parked in the outermost wheel's last reachable slot and placed
+   again when it cascades.
+
+   The wheel and every timeout's elem, expires and pending are
+   guarded by wheel_lock.  It is not held while a function runs,
+   so that the function may arm or cancel timeouts. */
+
+#define ROOT_BITS 8                     /**< Log2 of root wheel slots. */
+#define LEVEL_BITS 6                    /**< Log2 of outer wheel slots. */
+#define LEVEL_CNT 3                     /**< Number of outer wheels. */
+#define ROOT_SIZE (1 << ROOT_BITS)
+#define LEVEL_SIZE (1 << LEVEL_BITS)
+
+/** Ticks spanned by the root wheel and the first LEVEL outer
+   wheels. */
+#define SPAN(LEVEL) ((int64_t) 1 << (ROOT_BITS + (LEVEL) * LEVEL_BITS))
+
+static struct list root_wheel[ROOT_SIZE];
+static struct list outer_wheels[LEVEL_CNT][LEVEL_SIZE];
+
+/** Next tick the wheel will process.  Every pending timeout
+   expires at or after it, except those armed for the past, which
+   wait in its root slot. */
+static int64_t wheel_tick;
+
+static struct spinlock wheel_lock;
+
+/** Timeout whose function timeout_run() is calling, if any, and
+   the CPU it is calling it on. */
+static struct timeout *running;
+static struct cpu *running_cpu;
+
+/** Initializes the timing wheel.  Called by timer_init(). */
+void
+timeout_wheel_init (void)
+{
+  int i, j;
+
+  for (i = 0; i < ROOT_SIZE; i++)
+    list_init (&root_wheel[i]);
+  for (i = 0; i < LEVEL_CNT; i++)
+    for (j = 0; j < LEVEL_SIZE; j++)
+      list_init (&outer_wheels[i][j]);
+  wheel_tick = 0;
+  spin_init (&wheel_lock);
+}
+
+/** Initializes timeout T to call FUNC with AUX.  T is not
+   armed. */
+void
+timeout_init (struct timeout *t, timeout_func *func, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  t->expires = 0;
+  t->func = func;
+  t->aux = aux;
+  t->pending = false;
+}
+
+/** Puts T in the wheel slot for its expiry tick. */
+static void
+wheel_insert (struct timeout *t)
+{
+  int64_t expires = t->expires;
+  int64_t delta = expires - wheel_tick;
+  struct list *slot;
+
+  if (delta < 0)
+    slot = &root_wheel[wheel_tick & (ROOT_SIZE - 1)];
+  else if (delta < SPAN (0))
+    slot = &root_wheel[expires & (ROOT_SIZE - 1)];
+  else
+    {
+      int level;
+
+      if (delta >= SPAN (LEVEL_CNT))
+        expires = wheel_tick + SPAN (LEVEL_CNT) - 1;
+      for (level = 0; expires - wheel_tick >= SPAN (level + 1); level++)
+        continue;
+      slot = &outer_wheels[level][(expires >> (ROOT_BITS + level * LEVEL_BITS))
+                                  & (LEVEL_SIZE - 1)];
+    }
+  list_push_back (slot, &t->elem);
+}
+
+/** Arms T to expire on tick EXPIRES, which may already have
+   passed, in which case T expires on the next tick.  If T is
+   already pending, it is moved to the new tick. */
+void
+timeout_add (struct timeout *t, int64_t expires)
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  spin_acquire (&wheel_lock);
+  if (t->pending)
+    list_remove (&t->elem);
+  t->expires = expires;
+  t->pending = true;
+  wheel_insert (t);
+  spin_release (&wheel_lock);
+  timer_idle_kick (expires);
+  intr_set_level (old_level);
+}
+
+/** Disarms T.  Returns true if T was pending, false if it had
+   already expired or was never armed.  If T's function is running
+   on another CPU, waits for it to return, so that T may be freed
+   afterward; the caller must not hold anything it needs. */
+bool
+timeout_cancel (struct timeout *t)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (t != NULL);
+
+  old_level = intr_disable ();
+  spin_acquire (&wheel_lock);
+  while (running == t && running_cpu != cpu_current ())
+    {
+      spin_release (&wheel_lock);
+      spin_wait ();
+      spin_acquire (&wheel_lock);
+    }
+  was_pending = t->pending;
+  if (was_pending)
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+    }
+  spin_release (&wheel_lock);
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/** Returns true if T is armed and has not yet expired. */
+bool
+timeout_pending (const struct timeout *t)
+{
+  return t->pending;
+}
+
+/** Empties the slot of outer wheel LEVEL that covers the current
+   turn of the wheel inside it back into the wheel, and returns
+   that slot's index. */
+static int
+cascade (int level)
+{
+  int index = (wheel_tick >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+  struct list *slot = &outer_wheels[level][index];
+
+  while (!list_empty (slot))
+    wheel_insert (list_entry (list_pop_front (slot), struct timeout, elem));
+  return index;
+}
+
+/** Advances the wheel through tick NOW, calling the function of
+   each timeout that expires on the way.  Called by the timer
+   softirq with interrupts on.  Interrupts are off only while a
+   tick's slot is taken from the wheel and while each function
+   runs, so that a tick on which many timeouts expire does not
+   hold off interrupts for all of them at once.  The wheel is
+   unlocked while each function runs. */
+void
+timeout_run (int64_t now)
+{
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  spin_acquire (&wheel_lock);
+  while (wheel_tick <= now)
+    {
+      int index = wheel_tick & (ROOT_SIZE - 1);
+      struct list expired;
+
+      if (index == 0)
+        {
+          int level;
+          for (level = 0; level < LEVEL_CNT; level++)
+            if (cascade (level) != 0)
+              break;
+        }
+
+      /* Detach the slot first, so that timeouts the callbacks arm
+         for this tick or earlier go into the next one instead.
+         Cancelling a detached timeout still takes it off the
+         list, so it is safe to let interrupts in between
+         callbacks. */
+      list_init (&expired);
+      if (!list_empty (&root_wheel[index]))
+        list_splice (list_begin (&expired), list_begin (&root_wheel[index]),
+                     list_end (&root_wheel[index]));
+      wheel_tick++;
+
+      while (!list_empty (&expired))
+        {
+          struct timeout *t = list_entry (list_pop_front (&expired),
+                                          struct timeout, elem);
+          t->pending = false;
+          running = t;
+          running_cpu = cpu_current ();
+          spin_release (&wheel_lock);
+
+          t->func (t->aux);
+
+          spin_acquire (&wheel_lock);
+          running = NULL;
+          spin_release (&wheel_lock);
+          intr_set_level (old_level);
+          old_level = intr_disable ();
+          spin_acquire (&wheel_lock);
+        }
+    }
+  spin_release (&wheel_lock);
+  intr_set_level (old_level);
+}
+
+/** Returns the first tick after NOW on which a timeout may
+   expire, or NOW + LIMIT if none does before then.  A tick on
+   which an outer wheel cascades counts, since timeouts may come
+   due on it.  LIMIT must be less than a turn of the root
+   wheel. */
+int64_t
+timeout_next (int64_t now, int64_t limit)
+{
+  int64_t tick;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (limit > 0 && limit < ROOT_SIZE);
+
+  /* Ticks up to NOW that the wheel has not processed yet, because
+     the tick count was brought up to date outside the timer
+     interrupt, are due on the next tick. */
+  spin_acquire (&wheel_lock);
+  for (tick = wheel_tick; tick <= now + limit; tick++)
+    if ((tick & (ROOT_SIZE - 1)) == 0
+        || !list_empty (&root_wheel[tick & (ROOT_SIZE - 1)]))
+      break;
+  spin_release (&wheel_lock);
+  if (tick <= now + limit)
+    return tick > now ? tick : now + 1;
+  return now + limit;
+}
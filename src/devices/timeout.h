@@ -0,0 +1,42 @@
+#ifndef DEVICES_TIMEOUT_H
+#define DEVICES_TIMEOUT_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Function called when a timeout expires. */
+typedef void timeout_func (void *aux);
+
+/** A kernel timer.
+
+   Once armed with timeout_add(), FUNC is called with AUX on the
+   first timer tick at or after EXPIRES.  It runs from the timer
+   softirq with interrupts off, after the tick's wheel
+   bookkeeping is done, so it must not sleep, but it may arm or
+   cancel any timeout, including its own.
+
+   The structure belongs to its user, who usually embeds it in a
+   larger structure, and must be cancelled before it is freed.
+   timeout_cancel() waits for FUNC if it is running on another
+   CPU. */
+struct timeout
+  {
+    struct list_elem elem;      /**< Element in a wheel slot. */
+    int64_t expires;            /**< Tick at which to call FUNC. */
+    timeout_func *func;         /**< Function to call. */
+    void *aux;                  /**< Argument for FUNC. */
+    bool pending;               /**< Armed and not yet called? */
+  };
+
+void timeout_init (struct timeout *, timeout_func *, void *aux);
+void timeout_add (struct timeout *, int64_t expires);
+bool timeout_cancel (struct timeout *);
+bool timeout_pending (const struct timeout *);
+
+/* For devices/timer.c. */
+void timeout_wheel_init (void);
+void timeout_run (int64_t now);
+int64_t timeout_next (int64_t now, int64_t limit);
+
+#endif /**< devices/timeout.h */
@@ -3,8 +3,13 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/clock.h"
 #include "devices/pit.h"
+#include "devices/timeout.h"
 #include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/softirq.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -20,29 +25,43 @@
 /** Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/** Tickless idle.
+
+   When the boot CPU has nothing to run, timer_idle_enter()
+   switches the PIT from periodic mode to a single countdown that
+   ends on the tick of the next timer event, so the ticks in
+   between raise no interrupt.  `ticks' is brought up to date
+   when the countdown runs out, or by timer_idle_exit() if
+   something else wakes the CPU first.  The countdown always ends
+   on a tick boundary, so the phase of the periodic tick is
+   kept. */
+bool timer_tickless;
+
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ) /**< PIT cycles per tick. */
+static bool oneshot_armed;      /**< Is the PIT counting down once? */
+static uint16_t oneshot_count;  /**< PIT cycles it started from. */
+static uint16_t oneshot_first;  /**< PIT cycles to its first tick boundary. */
+static int64_t oneshot_ticks;   /**< Tick boundaries it spans, including the last. */
+static int64_t skipped_ticks;   /**< Timer interrupts saved by counting down once. */
+
+/** Guards `ticks', the one-shot state above and the PIT's channel
+   0.  Taken before the timeout wheel's lock, never after. */
+static struct spinlock ticks_lock = SPINLOCK_INITIALIZER;
+
 /** Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/** Last tick the timer softirq did 4.4BSD bookkeeping for. */
+static int64_t mlfqs_ticks;
+
 static intr_handler_func timer_interrupt;
+static softirq_func timer_softirq;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-/** Queue of sleep thread.
- * Initialized by timer_init()
-*/
-static struct list sleep_queue;
-static int64_t minimu_end_time;
-// static struct lock sleep_queue_lock;
-
-struct sleep_thread {
-  struct semaphore sp;
-  int64_t end_time;
-  struct list_elem sleep_elem;
-};
-
 /** Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
@@ -50,8 +69,8 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  // lock_init(&sleep_queue_lock);
-  list_init(&sleep_queue);
+  softirq_register (SOFTIRQ_TIMER, timer_softirq);
+  timeout_wheel_init ();
 }
 
 /** Calibrates loops_per_tick, used to implement brief delays. */
@@ -81,75 +100,187 @@ timer_calibrate (void)
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
+/** Starts the PIT counting down once, for COUNT cycles of which
+   the first FIRST end on a tick boundary, spanning TICK_CNT tick
+   boundaries in all. */
+static void
+oneshot_start (uint16_t count, uint16_t first, int64_t tick_cnt)
+{
+  oneshot_count = count;
+  oneshot_first = first;
+  oneshot_ticks = tick_cnt;
+  oneshot_armed = true;
+  pit_start_oneshot (0, count);
+}
+
+/** Returns true if the one-shot countdown has run out.  The PIT
+   keeps counting down from 65535 after reaching 0. */
+static bool
+oneshot_expired (uint16_t count)
+{
+  return count == 0 || count > oneshot_count;
+}
+
+/** Returns the number of tick boundaries the one-shot countdown
+   has passed, given that it has COUNT cycles left. */
+static int64_t
+oneshot_elapsed (uint16_t count)
+{
+  uint16_t done = oneshot_count - count;
+
+  if (oneshot_expired (count))
+    return oneshot_ticks;
+  if (done < oneshot_first)
+    return 0;
+  return 1 + (done - oneshot_first) / TICK_CYCLES;
+}
+
 /** Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) 
 {
   enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
+  int64_t t;
+
+  spin_acquire (&ticks_lock);
+  t = ticks;
+  if (oneshot_armed)
+    t += oneshot_elapsed (pit_read_count (0));
+  spin_release (&ticks_lock);
   intr_set_level (old_level);
   return t;
 }
 
-/** Returns the number of timer ticks elapsed since THEN, which
-   should be a value once returned by timer_ticks(). */
-int64_t
-timer_elapsed (int64_t then) 
+/** Returns the tick at which the next timer event is due, or
+   ticks + LIMIT if none is due before then: the earliest pending
+   timeout or, for the 4.4BSD scheduler, its next once-a-second
+   update. */
+static int64_t
+next_timer_event (int64_t limit)
 {
-  return timer_ticks () - then;
+  int64_t next = timeout_next (ticks, limit);
+
+  if (thread_mlfqs)
+    {
+      int64_t second = (ticks / TIMER_FREQ + 1) * TIMER_FREQ;
+      if (second < next)
+        next = second;
+    }
+  return next;
 }
 
-static bool
-sleep_endtime_smaller (const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED) 
+/** Called by the boot CPU's idle thread with interrupts off just
+   before it halts.  If tickless idle is enabled and no timer
+   event is due at the next tick, replaces the periodic tick by a
+   countdown to the tick of the next event, or as close to it as
+   the 16-bit PIT counter reaches. */
+void
+timer_idle_enter (void)
 {
-  const struct sleep_thread *a = list_entry (a_, struct sleep_thread, sleep_elem);
-  const struct sleep_thread *b = list_entry (b_, struct sleep_thread, sleep_elem);
-  
-  return a->end_time < b->end_time;
-}
+  int64_t delta, max_delta;
+  uint16_t first;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!timer_tickless || cpu_current () != &cpus[0])
+    return;
+
+  /* Hold the lock from looking at the wheel until the countdown
+     starts, so that timer_idle_kick() for a timeout added in
+     between sees the countdown. */
+  spin_acquire (&ticks_lock);
+  if (oneshot_armed)
+    {
+      spin_release (&ticks_lock);
+      return;
+    }
 
+  /* Cycles left in the current periodic tick.  Leave a tick of
+     headroom so that oneshot_expired() can tell a counter that
+     wrapped around. */
+  first = pit_read_count (0);
+  if (first == 0 || first > TICK_CYCLES)
+    first = TICK_CYCLES;
+  max_delta = 1 + (UINT16_MAX - TICK_CYCLES - first) / TICK_CYCLES;
+  delta = next_timer_event (max_delta) - ticks;
+  if (delta > 1)
+    oneshot_start (first + (delta - 1) * TICK_CYCLES, first, delta);
+  spin_release (&ticks_lock);
+}
 
-static void
-sleep_queue_push (int64_t end_time) 
+/** Called when a timer event is added for tick TICK.  If the
+   idle boot CPU is counting down past it, makes it start over. */
+void
+timer_idle_kick (int64_t tick)
 {
-  struct sleep_thread st;
-  st.end_time = end_time;
-  sema_init(&st.sp, 0);
+  bool kick;
 
-  enum intr_level old_level = intr_disable ();
-  // lock_acquire(&sleep_queue_lock);
-  // list_push_back (&sleep_queue, &st.sleep_elem);
-  list_insert_ordered(&sleep_queue, &st.sleep_elem, sleep_endtime_smaller, NULL);
-  // lock_release(&sleep_queue_lock);
-  intr_set_level (old_level);
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (cpu_current () == &cpus[0])
+    return;
 
-  sema_down(&st.sp);
+  spin_acquire (&ticks_lock);
+  kick = oneshot_armed && tick < ticks + oneshot_ticks;
+  spin_release (&ticks_lock);
+  if (kick)
+    smp_send_reschedule (&cpus[0]);
 }
 
-static void
-sleep_queue_check (void)
+/** Called when the boot CPU's idle thread is about to give way,
+   with interrupts off.  If the PIT is still counting down for
+   tickless idle, accounts for the ticks that have passed and
+   counts down only to the next tick boundary, where
+   timer_interrupt() goes back to periodic mode. */
+void
+timer_idle_exit (void)
 {
-  struct list_elem *e;
-  struct sleep_thread *st;
-  // lock_acquire(&sleep_queue_lock);
+  uint16_t count, done;
+  int64_t elapsed;
 
-  int64_t now = timer_ticks ();
-  enum intr_level old_level = intr_disable ();
-  for (e = list_begin (&sleep_queue); e != list_end (&sleep_queue); ) {
-    st = list_entry (e, struct sleep_thread, sleep_elem);
-    if (st->end_time <= now) {
-      sema_up(&st->sp);
-      struct list_elem *tmp = e;
-      e = list_next(e);
-      list_remove(tmp);
-    } else {
-      break ;
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (cpu_current () != &cpus[0])
+    return;
+
+  spin_acquire (&ticks_lock);
+  if (!oneshot_armed)
+    {
+      spin_release (&ticks_lock);
+      return;
     }
-  }
-  intr_set_level (old_level);
 
-  // lock_release(&sleep_queue_lock);
+  /* If it already ran out, its interrupt is pending and will do
+     the accounting. */
+  count = pit_read_count (0);
+  if (oneshot_expired (count))
+    {
+      spin_release (&ticks_lock);
+      return;
+    }
+
+  elapsed = oneshot_elapsed (count);
+  done = oneshot_count - count;
+  ticks += elapsed;
+  skipped_ticks += elapsed;
+  if (elapsed == 0)
+    count = oneshot_first - done;
+  else
+    count = TICK_CYCLES - (done - oneshot_first) % TICK_CYCLES;
+  oneshot_start (count, count, 1);
+  spin_release (&ticks_lock);
+}
+
+/** Returns the number of timer ticks elapsed since THEN, which
+   should be a value once returned by timer_ticks(). */
+int64_t
+timer_elapsed (int64_t then) 
+{
+  return timer_ticks () - then;
+}
+
+/** Wakes up the thread sleeping on semaphore SEMA. */
+static void
+wake_sleeper (void *sema)
+{
+  sema_up (sema);
 }
 
 /** Sleeps for approximately TICKS timer ticks.  Interrupts must
@@ -158,11 +289,17 @@ void
 timer_sleep (int64_t ticks) 
 {
   int64_t start = timer_ticks ();
+  struct semaphore sema;
+  struct timeout wakeup;
 
   ASSERT (intr_get_level () == INTR_ON);
-  sleep_queue_push(start + ticks);
-  // while (timer_elapsed (start) < ticks) 
-  //   thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  sema_init (&sema, 0);
+  timeout_init (&wakeup, wake_sleeper, &sema);
+  timeout_add (&wakeup, start + ticks);
+  sema_down (&sema);
 }
 
 /** Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -232,25 +369,54 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" ticks, %"PRId64" skipped while idle\n",
+            timer_ticks (), skipped_ticks);
+  else
+    printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
-/** Timer interrupt handler. */
+/** Timer interrupt handler.  Counts the tick and charges it to
+   the running thread, and leaves the rest to timer_softirq(). */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  // enum intr_level old_level = intr_disable ();
+  spin_acquire (&ticks_lock);
+  if (oneshot_armed && oneshot_expired (pit_read_count (0)))
+    {
+      /* This is the last tick boundary the countdown spanned. */
+      oneshot_armed = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      ticks += oneshot_ticks - 1;
+      skipped_ticks += oneshot_ticks - 1;
+    }
   ticks++;
-  sleep_queue_check();
-
-  if (thread_mlfqs) {
-    /** Recaculate BSD4.4 params*/
-    update_recent_cpu(ticks);
-    update_load_avg(ticks);
-    update_priority(ticks);
-  }
-  
+  spin_release (&ticks_lock);
   thread_tick ();
+  softirq_raise (SOFTIRQ_TIMER);
+}
+
+/** Timer softirq.  Expires timeouts and does the 4.4BSD
+   bookkeeping for each tick counted since it last ran. */
+static void
+timer_softirq (void)
+{
+  int64_t now = timer_ticks ();
+
+  timeout_run (now);
+
+  if (thread_mlfqs)
+    while (mlfqs_ticks < now)
+      {
+        enum intr_level old_level = intr_disable ();
+
+        /** Recaculate BSD4.4 params*/
+        mlfqs_ticks++;
+        update_recent_cpu (mlfqs_ticks);
+        update_load_avg (mlfqs_ticks);
+        update_priority (mlfqs_ticks);
+        intr_set_level (old_level);
+      }
 }
 
 /** Returns true if LOOPS iterations waits for more than one timer
@@ -314,12 +480,20 @@ real_time_sleep (int64_t num, int32_t denom)
     }
 }
 
-/** Busy-wait for approximately NUM/DENOM seconds. */
+/** Busy-wait for approximately NUM/DENOM seconds.  Uses the TSC
+   once it has been calibrated, otherwise the calibrated loop. */
 static void
 real_time_delay (int64_t num, int32_t denom)
 {
+  ASSERT (denom % 1000 == 0);
+  if (clock_calibrated ())
+    {
+      if (num > 0)
+        clock_delay_ns (num * (1000 * 1000 * 1000 / denom));
+      return;
+    }
+
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
-  ASSERT (denom % 1000 == 0);
   busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
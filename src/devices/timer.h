@@ -2,13 +2,21 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /** Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/** If true, stop the periodic timer interrupt while idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+void timer_idle_kick (int64_t tick);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
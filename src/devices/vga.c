@@ -6,6 +6,7 @@
 #include "devices/speaker.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /** VGA text screen support.  See [FREEVGA] for more information. */
@@ -26,6 +27,9 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/** Guards the cursor, the framebuffer and the CRT controller. */
+static struct spinlock vga_lock = SPINLOCK_INITIALIZER;
+
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
@@ -52,9 +56,11 @@ void
 vga_putc (int c)
 {
   /* Disable interrupts to lock out interrupt handlers
-     that might write to the console. */
+     that might write to the console, and take the lock to lock
+     out other CPUs. */
   enum intr_level old_level = intr_disable ();
 
+  spin_acquire (&vga_lock);
   init ();
   
   switch (c) 
@@ -83,9 +89,11 @@ vga_putc (int c)
       break;
 
     case '\a':
+      spin_release (&vga_lock);
       intr_set_level (old_level);
       speaker_beep ();
       intr_disable ();
+      spin_acquire (&vga_lock);
       break;
       
     default:
@@ -99,6 +107,7 @@ vga_putc (int c)
   /* Update cursor position. */
   move_cursor ();
 
+  spin_release (&vga_lock);
   intr_set_level (old_level);
 }
 
@@ -0,0 +1,581 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/dma.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/softirq.h"
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/** The code in this file drives virtio block devices through the
+   legacy PCI interface of [VIRTIO] 0.9.5, which QEMU offers for
+   disks attached with "-drive if=virtio".
+
+   Each disk has a single virtqueue.  Requests are put on it as
+   they are submitted, as many at once as it has room for, and
+   completed from the disk's interrupt, so the block layer hands
+   them straight to the driver instead of queuing them itself:
+   the host does its own scheduling. */
+
+/** PCI IDs of a legacy or transitional virtio block device. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/** Legacy virtio registers, as offsets from the base of the
+   device's I/O BAR. */
+#define REG_HOST_FEATURES 0x00          /**< Features the device offers. */
+#define REG_GUEST_FEATURES 0x04         /**< Features the driver accepts. */
+#define REG_QUEUE_PFN 0x08              /**< Page number of the queue. */
+#define REG_QUEUE_SIZE 0x0c             /**< Entries in the queue (16 bits). */
+#define REG_QUEUE_SELECT 0x0e           /**< Queue that PFN, SIZE refer to. */
+#define REG_QUEUE_NOTIFY 0x10           /**< Write queue number to kick. */
+#define REG_STATUS 0x12                 /**< Device status (8 bits). */
+#define REG_ISR 0x13                    /**< Interrupt status, clear on read. */
+#define REG_CAPACITY 0x14               /**< Size in sectors (64 bits). */
+
+/** Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01         /**< Driver has noticed device. */
+#define STATUS_DRIVER 0x02              /**< Driver knows how to drive it. */
+#define STATUS_DRIVER_OK 0x04           /**< Driver is ready. */
+#define STATUS_FAILED 0x80              /**< Driver has given up. */
+
+#define ISR_QUEUE 0x01                  /**< A queue has used buffers. */
+
+/** A virtqueue descriptor: one buffer in a chain. */
+struct vring_desc
+  {
+    uint64_t addr;              /**< Physical address. */
+    uint32_t len;               /**< Length in bytes. */
+    uint16_t flags;             /**< VRING_DESC_F_*. */
+    uint16_t next;              /**< Next in chain, with VRING_DESC_F_NEXT. */
+  };
+#define VRING_DESC_F_NEXT 1     /**< NEXT is valid. */
+#define VRING_DESC_F_WRITE 2    /**< Device writes, rather than reads. */
+
+/** Ring of chains offered to the device. */
+struct vring_avail
+  {
+    uint16_t flags;             /**< 1 to ask for no interrupts. */
+    uint16_t idx;               /**< Where the next entry goes. */
+    uint16_t ring[];            /**< Heads of chains. */
+  };
+
+/** Ring of chains the device is done with. */
+struct vring_used_elem
+  {
+    uint32_t id;                /**< Head of the chain. */
+    uint32_t len;               /**< Bytes written into it. */
+  };
+
+struct vring_used
+  {
+    uint16_t flags;             /**< 1 if the device needs no kicks. */
+    uint16_t idx;               /**< Where the next entry goes. */
+    struct vring_used_elem ring[];
+  };
+
+/** Alignment of the used ring in a legacy virtqueue. */
+#define VRING_ALIGN PGSIZE
+
+/** Header of a virtio-blk request. */
+struct vblk_header
+  {
+    uint32_t type;              /**< VIRTIO_BLK_T_*. */
+    uint32_t reserved;          /**< Must be zero. */
+    uint64_t sector;            /**< First 512-byte sector. */
+  };
+#define VIRTIO_BLK_T_IN 0       /**< Read. */
+#define VIRTIO_BLK_T_OUT 1      /**< Write. */
+#define VIRTIO_BLK_S_OK 0       /**< Status byte for success. */
+
+/** Most data buffers in one virtio-blk request.  A block request
+   with more runs of sectors contiguous in memory than this is
+   split into several. */
+#define SEG_MAX 8
+
+/** Descriptors per request: header, data, status. */
+#define DESC_PER_SLOT (SEG_MAX + 2)
+
+/** Most requests a disk may have on its virtqueue at once. */
+#define SLOT_MAX 32
+
+/** Bounce pages per disk, for buffers the device cannot reach. */
+#define BOUNCE_CNT 2
+
+/** One virtio-blk request on a disk's virtqueue.  Slot N always
+   uses the chain of DESC_PER_SLOT descriptors starting at
+   N * DESC_PER_SLOT. */
+struct vblk_slot
+  {
+    struct vblk_header header;  /**< Read by the device. */
+    volatile uint8_t status;    /**< Written by the device. */
+    struct block_request *rq;   /**< Block request this is part of. */
+
+    struct dma_bounce bounce;   /**< Runs through a bounce page, if any. */
+    bool copy_back;             /**< Submitter copies BOUNCE out itself. */
+    struct semaphore copied;    /**< Upped for a COPY_BACK slot. */
+  };
+
+/** A virtio block device. */
+struct vblk_disk
+  {
+    char name[8];               /**< Name, e.g. "vda". */
+    uint16_t io_base;           /**< Base of the legacy registers. */
+    uint8_t irq;                /**< Interrupt vector. */
+
+    uint16_t queue_size;        /**< Descriptors in the virtqueue. */
+    struct vring_desc *desc;    /**< Descriptor table. */
+    struct vring_avail *avail;  /**< Available ring. */
+    struct vring_used *used;    /**< Used ring. */
+    uint16_t used_idx;          /**< Next used ring entry to look at. */
+
+    struct vblk_slot *slots;    /**< Request slots. */
+    size_t slot_cnt;            /**< Number of SLOTS. */
+    uint32_t free_slots;        /**< Bit N set if slot N is free. */
+    struct semaphore slot_sema; /**< Counts free slots. */
+
+    void *bounce[BOUNCE_CNT];   /**< Bounce pages. */
+    uint32_t free_bounce;       /**< Bit N set if BOUNCE[N] is free. */
+    struct semaphore bounce_sema;       /**< Counts free bounce pages. */
+
+    struct spinlock lock;       /**< Guards the rings, the free bits
+                                   and driver_parts of its requests. */
+  };
+
+/** Disks found by virtio_blk_init().  Fields that the completion
+   path changes are protected by each disk's lock, taken with
+   interrupts off.  Semaphores are upped and requests completed
+   only after it is released. */
+#define DISK_MAX 4
+static struct vblk_disk disks[DISK_MAX];
+static size_t disk_cnt;
+
+static struct block_operations vblk_operations;
+
+static bool init_disk (struct vblk_disk *, const struct pci_dev *);
+static void register_disk (struct vblk_disk *);
+static void interrupt_handler (struct intr_frame *);
+static softirq_func completion_softirq;
+
+/** Finds virtio block devices on the PCI bus and registers each
+   with the block layer. */
+void
+virtio_blk_init (void)
+{
+  const struct pci_dev *pci = NULL;
+
+  softirq_register (SOFTIRQ_VIRTIO, completion_softirq);
+  while ((pci = pci_find_device (VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, pci))
+         != NULL)
+    {
+      struct vblk_disk *d = &disks[disk_cnt];
+      size_t i;
+
+      if (disk_cnt >= DISK_MAX)
+        {
+          printf ("virtio-blk: too many disks, ignoring the rest\n");
+          break;
+        }
+      snprintf (d->name, sizeof d->name, "vd%c", 'a' + (int) disk_cnt);
+      if (!init_disk (d, pci))
+        continue;
+
+      /* Disks may share an interrupt line. */
+      for (i = 0; i < disk_cnt; i++)
+        if (disks[i].irq == d->irq)
+          break;
+      if (i == disk_cnt)
+        intr_register_ext (d->irq, interrupt_handler, "virtio-blk");
+      disk_cnt++;
+
+      register_disk (d);
+    }
+}
+
+/** Returns the number of bytes in a legacy virtqueue with
+   QUEUE_SIZE descriptors. */
+static size_t
+vring_size (uint16_t queue_size)
+{
+  size_t front = (sizeof (struct vring_desc) * queue_size
+                  + sizeof (uint16_t) * (3 + queue_size));
+  return (ROUND_UP (front, VRING_ALIGN)
+          + sizeof (uint16_t) * 3
+          + sizeof (struct vring_used_elem) * queue_size);
+}
+
+/** Resets the device described by PCI and sets it up, with its
+   virtqueue, as disk D.  Returns false, leaving D unused, if the
+   device cannot be used. */
+static bool
+init_disk (struct vblk_disk *d, const struct pci_dev *pci)
+{
+  uint32_t bar = pci_read_bar (pci, 0);
+  size_t page_cnt, i;
+  uint8_t *ring;
+
+  if (!(bar & PCI_BAR_IO) || pci->irq_line >= 16)
+    {
+      printf ("%s: no I/O space or interrupt line, ignoring\n", d->name);
+      return false;
+    }
+  pci_enable (pci, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+  d->io_base = bar & PCI_BAR_IO_MASK;
+  d->irq = pci->irq_line + 0x20;
+
+  /* Reset the device and tell it that we know what it is.  We
+     accept none of its optional features. */
+  outb (d->io_base + REG_STATUS, 0);
+  outb (d->io_base + REG_STATUS, STATUS_ACKNOWLEDGE);
+  outb (d->io_base + REG_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  inl (d->io_base + REG_HOST_FEATURES);
+  outl (d->io_base + REG_GUEST_FEATURES, 0);
+
+  /* Set up queue 0, whose size the device dictates. */
+  outw (d->io_base + REG_QUEUE_SELECT, 0);
+  d->queue_size = inw (d->io_base + REG_QUEUE_SIZE);
+  if (d->queue_size < DESC_PER_SLOT)
+    {
+      printf ("%s: queue of %"PRIu16" entries is too small, ignoring\n",
+              d->name, d->queue_size);
+      outb (d->io_base + REG_STATUS, STATUS_FAILED);
+      return false;
+    }
+  page_cnt = DIV_ROUND_UP (vring_size (d->queue_size), PGSIZE);
+  ring = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, page_cnt);
+  d->desc = (struct vring_desc *) ring;
+  d->avail = (struct vring_avail *) (ring + sizeof *d->desc * d->queue_size);
+  d->used = (struct vring_used *) (ring + vring_size (d->queue_size)
+                                   - sizeof (uint16_t) * 3
+                                   - (sizeof (struct vring_used_elem)
+                                      * d->queue_size));
+  d->used_idx = 0;
+  spin_init (&d->lock);
+
+  /* Carve the descriptors into fixed chains, one per slot. */
+  d->slot_cnt = d->queue_size / DESC_PER_SLOT;
+  if (d->slot_cnt > SLOT_MAX)
+    d->slot_cnt = SLOT_MAX;
+  d->slots = calloc (d->slot_cnt, sizeof *d->slots);
+  if (d->slots == NULL)
+    PANIC ("%s: out of memory for request slots", d->name);
+  for (i = 0; i < d->slot_cnt; i++)
+    sema_init (&d->slots[i].copied, 0);
+  d->free_slots = d->slot_cnt < 32 ? (1u << d->slot_cnt) - 1 : 0xffffffff;
+  sema_init (&d->slot_sema, d->slot_cnt);
+  for (i = 0; i < BOUNCE_CNT; i++)
+    d->bounce[i] = palloc_get_page (PAL_ASSERT);
+  d->free_bounce = (1u << BOUNCE_CNT) - 1;
+  sema_init (&d->bounce_sema, BOUNCE_CNT);
+
+  outl (d->io_base + REG_QUEUE_PFN, vtop (ring) / PGSIZE);
+  outb (d->io_base + REG_STATUS,
+        STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+}
+
+/** Registers disk D, whose interrupt handler must be in place,
+   with the block layer and scans it for partitions. */
+static void
+register_disk (struct vblk_disk *d)
+{
+  struct block *block;
+  uint64_t capacity;
+  char extra_info[32];
+
+  /* block_sector_t must be able to express the size. */
+  capacity = inl (d->io_base + REG_CAPACITY);
+  capacity |= (uint64_t) inl (d->io_base + REG_CAPACITY + 4) << 32;
+  if (capacity > UINT32_MAX)
+    capacity = UINT32_MAX;
+  snprintf (extra_info, sizeof extra_info, "virtio, %zu of %"PRIu16
+            " descriptors", d->slot_cnt * DESC_PER_SLOT, d->queue_size);
+  block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
+                          &vblk_operations, d);
+  partition_scan (block);
+}
+
+/** Clears the lowest set bit in *BITS, which must not be zero, and
+   returns its index.  The lock of the disk that owns BITS must be
+   held. */
+static uint32_t
+take_bit (uint32_t *bits)
+{
+  uint32_t i;
+
+  ASSERT (*bits != 0);
+  for (i = 0; !(*bits & (1u << i)); i++)
+    continue;
+  *bits &= ~(1u << i);
+  return i;
+}
+
+/** Waits for a free slot on disk D and returns its number. */
+static size_t
+get_slot (struct vblk_disk *d)
+{
+  enum intr_level old_level;
+  size_t slot_no;
+
+  sema_down (&d->slot_sema);
+  old_level = intr_disable ();
+  spin_acquire (&d->lock);
+  slot_no = take_bit (&d->free_slots);
+  spin_release (&d->lock);
+  intr_set_level (old_level);
+  return slot_no;
+}
+
+/** Waits for a free bounce page on disk D and returns it. */
+static void *
+get_bounce (struct vblk_disk *d)
+{
+  enum intr_level old_level;
+  void *bounce;
+
+  sema_down (&d->bounce_sema);
+  old_level = intr_disable ();
+  spin_acquire (&d->lock);
+  bounce = d->bounce[take_bit (&d->free_bounce)];
+  spin_release (&d->lock);
+  intr_set_level (old_level);
+  return bounce;
+}
+
+/** Frees slot SLOT_NO of disk D and its bounce page, and
+   completes the slot's block request if it was the last part
+   outstanding.  D's lock must not be held. */
+static void
+release_slot (struct vblk_disk *d, size_t slot_no)
+{
+  struct vblk_slot *s = &d->slots[slot_no];
+  struct block_request *rq = s->rq;
+  bool had_bounce = s->bounce.page != NULL;
+  enum intr_level old_level;
+  bool last;
+  size_t i;
+
+  old_level = intr_disable ();
+  spin_acquire (&d->lock);
+  if (had_bounce)
+    for (i = 0; i < BOUNCE_CNT; i++)
+      if (d->bounce[i] == s->bounce.page)
+        d->free_bounce |= 1u << i;
+  d->free_slots |= 1u << slot_no;
+  last = --rq->driver_parts == 0;
+  spin_release (&d->lock);
+
+  if (had_bounce)
+    sema_up (&d->bounce_sema);
+  sema_up (&d->slot_sema);
+  if (last)
+    block_complete (rq);
+  intr_set_level (old_level);
+}
+
+/** Points descriptor DESC of disk D at the SIZE bytes at BUFFER,
+   which the device must be able to reach, with the given
+   FLAGS. */
+static void
+set_desc (struct vblk_disk *d, struct vring_desc *desc,
+          volatile void *buffer, size_t size, uint16_t flags)
+{
+  desc->addr = vtop ((const void *) buffer);
+  desc->len = size;
+  desc->flags = flags;
+  desc->next = desc - d->desc + 1;
+}
+
+/** Fills in slot SLOT_NO of disk D to carry out the first of the
+   LEFT sectors of RQ that remain, starting at SECTOR, with the
+   buffers at POS.  Returns the number of sectors the slot covers,
+   which is less than LEFT if it runs out of descriptors or its
+   bounce page fills up, and advances POS past them. */
+static block_sector_t
+fill_slot (struct vblk_disk *d, size_t slot_no, struct block_request *rq,
+           block_sector_t sector, struct iov_pos *pos, block_sector_t left)
+{
+  struct vblk_slot *s = &d->slots[slot_no];
+  struct vring_desc *desc = d->desc + slot_no * DESC_PER_SLOT;
+  uint16_t data_flags = VRING_DESC_F_NEXT | (rq->write ? 0 : VRING_DESC_F_WRITE);
+  size_t seg_cnt = 0;
+  block_sector_t done = 0;
+
+  s->rq = rq;
+  dma_bounce_init (&s->bounce, NULL);
+  s->header.type = rq->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+  s->header.reserved = 0;
+  s->header.sector = sector;
+  s->status = 0xff;
+  set_desc (d, desc, &s->header, sizeof s->header, VRING_DESC_F_NEXT);
+
+  /* Describe the buffers, one run of sectors contiguous in memory
+     at a time.  What does not fit in the bounce page is left for
+     the next slot. */
+  while (done < left && seg_cnt < SEG_MAX)
+    {
+      void *buffer;
+      block_sector_t run = iov_next_run (pos, left - done, &buffer);
+
+      if (!dma_reachable (buffer, run * BLOCK_SECTOR_SIZE))
+        {
+          if (s->bounce.page == NULL)
+            s->bounce.page = get_bounce (d);
+          run = dma_bounce_add (&s->bounce, pos, &buffer, run, rq->write);
+          if (run == 0)
+            break;
+        }
+      set_desc (d, &desc[1 + seg_cnt++], buffer, run * BLOCK_SECTOR_SIZE,
+                data_flags);
+      done += run;
+    }
+  ASSERT (done > 0);
+  set_desc (d, &desc[1 + seg_cnt], &s->status, 1, VRING_DESC_F_WRITE);
+
+  /* A read into buffers the device cannot reach must be copied out
+     in the submitter's address space, not from the interrupt. */
+  s->copy_back = !rq->write && s->bounce.run_cnt > 0;
+  return done;
+}
+
+/** Puts the chain of slot SLOT_NO on disk D's available ring and
+   tells the device.  D's lock must be held. */
+static void
+start_slot (struct vblk_disk *d, size_t slot_no)
+{
+  ASSERT (spin_is_locked (&d->lock));
+
+  d->avail->ring[d->avail->idx % d->queue_size] = slot_no * DESC_PER_SLOT;
+  barrier ();
+  d->avail->idx++;
+  barrier ();
+  outw (d->io_base + REG_QUEUE_NOTIFY, 0);
+}
+
+/** Starts block request RQ on disk D_, splitting it into as many
+   virtio-blk requests as its buffers need, each started as soon
+   as it has a slot.  Returns once all of them are on the queue,
+   except that a read into buffers the device cannot reach, such
+   as a user buffer, finishes before it returns. */
+static void
+vblk_submit (void *d_, struct block_request *rq)
+{
+  struct vblk_disk *d = d_;
+  struct iov_pos pos;
+  block_sector_t sector = rq->sector;
+  block_sector_t left = rq->cnt;
+  enum intr_level old_level;
+  bool last;
+
+  iov_pos_init (&pos, rq->iov);
+
+  /* Count a part for ourselves, so that RQ cannot complete before
+     all of its parts are on the queue. */
+  rq->driver_parts = 1;
+  while (left > 0)
+    {
+      size_t slot_no = get_slot (d);
+      struct vblk_slot *s = &d->slots[slot_no];
+      block_sector_t cnt = fill_slot (d, slot_no, rq, sector, &pos, left);
+
+      old_level = intr_disable ();
+      spin_acquire (&d->lock);
+      rq->driver_parts++;
+      start_slot (d, slot_no);
+      spin_release (&d->lock);
+      intr_set_level (old_level);
+
+      if (s->copy_back)
+        {
+          sema_down (&s->copied);
+          dma_bounce_copy_back (&s->bounce);
+          release_slot (d, slot_no);
+        }
+      sector += cnt;
+      left -= cnt;
+    }
+
+  old_level = intr_disable ();
+  spin_acquire (&d->lock);
+  last = --rq->driver_parts == 0;
+  spin_release (&d->lock);
+  if (last)
+    block_complete (rq);
+  intr_set_level (old_level);
+}
+
+static struct block_operations vblk_operations =
+  {
+    .submit = vblk_submit,
+  };
+
+/** virtio-blk interrupt handler, for every disk on the interrupt
+   line.  Reading a disk's interrupt status acknowledges the
+   interrupt; completion_softirq() finishes the requests. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  bool ours = false;
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    if (disks[i].irq == f->vec_no
+        && (inb (disks[i].io_base + REG_ISR) & ISR_QUEUE))
+      ours = true;
+  if (ours)
+    softirq_raise (SOFTIRQ_VIRTIO);
+}
+
+/** virtio softirq.  Finishes every request that a disk has put
+   on its used ring since last time. */
+static void
+completion_softirq (void)
+{
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    {
+      struct vblk_disk *d = &disks[i];
+      enum intr_level old_level = intr_disable ();
+
+      for (;;)
+        {
+          struct vblk_slot *s;
+          size_t slot_no;
+
+          spin_acquire (&d->lock);
+          barrier ();
+          if (d->used_idx == d->used->idx)
+            {
+              spin_release (&d->lock);
+              break;
+            }
+          slot_no = d->used->ring[d->used_idx % d->queue_size].id
+                    / DESC_PER_SLOT;
+          d->used_idx++;
+          spin_release (&d->lock);
+
+          s = &d->slots[slot_no];
+          if (s->status != VIRTIO_BLK_S_OK)
+            PANIC ("%s: %s failed, sector=%"PRIu64", status=%d", d->name,
+                   s->rq->write ? "write" : "read", s->header.sector,
+                   s->status);
+          if (s->copy_back)
+            sema_up (&s->copied);
+          else
+            release_slot (d, slot_no);
+        }
+      intr_set_level (old_level);
+    }
+}
@@ -13,6 +13,9 @@ struct block *fs_device;
 
 struct lock filesys_lock;
 
+/** Cache of struct file_descriptor. */
+struct kmem_cache file_descriptor_cache;
+
 static void do_format (void);
 
 /** Initializes the file system module.
@@ -26,6 +29,8 @@ filesys_init (bool format)
 
   inode_init ();
   free_map_init ();
+  kmem_cache_init (&file_descriptor_cache, "file_descriptor",
+                   sizeof (struct file_descriptor), NULL);
 
   if (format) 
     do_format ();
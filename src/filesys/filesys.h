@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 #include "lib/kernel/list.h"
+#include "threads/slab.h"
 
 /** Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /**< Free map file inode sector. */
@@ -18,6 +19,9 @@ struct file_descriptor {
   struct list_elem elem;
 };
 
+/** Cache of struct file_descriptor. */
+extern struct kmem_cache file_descriptor_cache;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
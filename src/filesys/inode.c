@@ -6,10 +6,14 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /** Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/** Sectors of zeros inode_create() writes per request. */
+#define ZERO_IOV_CNT 32
+
 /** On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
@@ -57,11 +61,15 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/** Cache of struct inode. */
+static struct kmem_cache inode_cache;
+
 /** Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  kmem_cache_init (&inode_cache, "inode", sizeof (struct inode), NULL);
 }
 
 /** Initializes an inode with LENGTH bytes of data and
@@ -92,11 +100,24 @@ inode_create (block_sector_t sector, off_t length)
           block_write (fs_device, sector, disk_inode);
           if (sectors > 0) 
             {
+              /* Write the same sector of zeros over and over, up
+                 to ZERO_IOV_CNT sectors per request. */
               static char zeros[BLOCK_SECTOR_SIZE];
+              struct block_iovec iov[ZERO_IOV_CNT];
               size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
+
+              for (i = 0; i < ZERO_IOV_CNT; i++)
+                {
+                  iov[i].buffer = zeros;
+                  iov[i].cnt = 1;
+                }
+              for (i = 0; i < sectors; i += ZERO_IOV_CNT)
+                {
+                  size_t cnt = sectors - i;
+                  if (cnt > ZERO_IOV_CNT)
+                    cnt = ZERO_IOV_CNT;
+                  block_writev (fs_device, disk_inode->start + i, iov, cnt);
+                }
             }
           success = true; 
         } 
@@ -127,7 +148,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -181,7 +202,7 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      kmem_cache_free (&inode_cache, inode);
     }
 }
 
@@ -222,8 +243,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          /* Read all the full sectors from here on directly into
+             caller's buffer.  A file's sectors are contiguous. */
+          off_t full = (size < inode_left ? size : inode_left);
+          block_sector_t cnt = full / BLOCK_SECTOR_SIZE;
+          block_read_multiple (fs_device, sector_idx, cnt,
+                               buffer + bytes_read);
+          chunk_size = cnt * BLOCK_SECTOR_SIZE;
         }
       else 
         {
@@ -283,8 +309,13 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          /* Write all the full sectors from here on directly to
+             disk.  A file's sectors are contiguous. */
+          off_t full = (size < inode_left ? size : inode_left);
+          block_sector_t cnt = full / BLOCK_SECTOR_SIZE;
+          block_write_multiple (fs_device, sector_idx, cnt,
+                                buffer + bytes_written);
+          chunk_size = cnt * BLOCK_SECTOR_SIZE;
         }
       else 
         {
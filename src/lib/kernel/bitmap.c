@@ -23,11 +23,29 @@ typedef unsigned long elem_type;
 
 /** From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Operations on ranges of bits work an element at a time, with
+   masks for the partial elements at either end, and searches
+   find the next interesting bit in an element with a single
+   bit-scan instruction.  A second, much smaller array has one
+   bit per element of BITS, set if that element is entirely
+   true, so that a search for false bits can pass over long runs
+   of full elements a summary element at a time.
+
+   Each change to BITS is a single instruction, atomic on a
+   uniprocessor, but keeping the summary in step takes a separate
+   read and write, and one summary element covers 32 elements of
+   BITS.  A change that races with another can leave an element
+   with a false bit marked full, which searches then never see
+   again, so callers that may change the same bitmap at once must
+   serialize, as the swap map does with its lock and the free map
+   does under the file system lock. */
 struct bitmap
   {
     size_t bit_cnt;     /**< Number of bits. */
     elem_type *bits;    /**< Elements that represent bits. */
+    elem_type *full;    /**< Summary: bit K set if BITS[K] is all 1s. */
   };
 
 /** Returns the index of the element that contains the bit
@@ -60,6 +78,43 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/** Returns the number of bytes required for BIT_CNT bits plus
+   their summary. */
+static inline size_t
+storage_cnt (size_t bit_cnt)
+{
+  return byte_cnt (bit_cnt) + byte_cnt (elem_cnt (bit_cnt));
+}
+
+/** Returns an elem_type with the CNT bits starting at bit OFS
+   turned on.  OFS + CNT must be at most ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt)
+{
+  elem_type mask = (cnt < ELEM_BITS
+                    ? ((elem_type) 1 << cnt) - 1
+                    : (elem_type) -1);
+  return mask << ofs;
+}
+
+/** Returns the index of the lowest set bit in nonzero X. */
+static inline size_t
+lowest_bit (elem_type x)
+{
+  return __builtin_ctzl (x);
+}
+
+/** Returns the number of set bits in X. */
+static inline size_t
+count_bits (elem_type x)
+{
+  size_t cnt = 0;
+
+  for (; x != 0; x &= x - 1)
+    cnt++;
+  return cnt;
+}
+
 /** Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -68,6 +123,33 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/** Updates the summary bit for element IDX of B's bits. */
+static inline void
+update_summary (struct bitmap *b, size_t idx)
+{
+  elem_type used = (idx == elem_cnt (b->bit_cnt) - 1
+                    ? last_mask (b)
+                    : (elem_type) -1);
+  elem_type mask = bit_mask (idx);
+
+  if ((b->bits[idx] & used) == used)
+    b->full[elem_idx (idx)] |= mask;
+  else
+    b->full[elem_idx (idx)] &= ~mask;
+}
+
+/** Recomputes the whole summary of B. */
+static void
+rebuild_summary (struct bitmap *b)
+{
+  size_t i;
+
+  for (i = 0; i < elem_cnt (elem_cnt (b->bit_cnt)); i++)
+    b->full[i] = 0;
+  for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+    update_summary (b, i);
+}
 
 /** Creation and destruction. */
 
@@ -82,9 +164,11 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
-      b->bits = malloc (byte_cnt (bit_cnt));
+      b->bits = malloc (storage_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
+          b->full = b->bits + elem_cnt (bit_cnt);
+          rebuild_summary (b);
           bitmap_set_all (b, false);
           return b;
         }
@@ -105,6 +189,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->full = b->bits + elem_cnt (bit_cnt);
+  rebuild_summary (b);
   bitmap_set_all (b, false);
   return b;
 }
@@ -114,7 +200,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 size_t
 bitmap_buf_size (size_t bit_cnt) 
 {
-  return sizeof (struct bitmap) + byte_cnt (bit_cnt);
+  return sizeof (struct bitmap) + storage_cnt (bit_cnt);
 }
 
 /** Destroys bitmap B, freeing its storage.
@@ -140,7 +226,8 @@ bitmap_size (const struct bitmap *b)
 
 /** Setting and testing single bits. */
 
-/** Atomically sets the bit numbered IDX in B to VALUE. */
+/** Sets the bit numbered IDX in B to VALUE.  Not atomic: see the
+   comment on struct bitmap. */
 void
 bitmap_set (struct bitmap *b, size_t idx, bool value) 
 {
@@ -152,7 +239,8 @@ bitmap_set (struct bitmap *b, size_t idx, bool value)
     bitmap_reset (b, idx);
 }
 
-/** Atomically sets the bit numbered BIT_IDX in B to true. */
+/** Sets the bit numbered BIT_IDX in B to true.  Not atomic: see
+   the comment on struct bitmap. */
 void
 bitmap_mark (struct bitmap *b, size_t bit_idx) 
 {
@@ -163,9 +251,11 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
-/** Atomically sets the bit numbered BIT_IDX in B to false. */
+/** Sets the bit numbered BIT_IDX in B to false.  Not atomic: see
+   the comment on struct bitmap. */
 void
 bitmap_reset (struct bitmap *b, size_t bit_idx) 
 {
@@ -176,11 +266,13 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  b->full[elem_idx (idx)] &= ~bit_mask (idx);
 }
 
-/** Atomically toggles the bit numbered IDX in B;
+/** Toggles the bit numbered IDX in B;
    that is, if it is true, makes it false,
-   and if it is false, makes it true. */
+   and if it is false, makes it true.  Not atomic: see the comment
+   on struct bitmap. */
 void
 bitmap_flip (struct bitmap *b, size_t bit_idx) 
 {
@@ -191,6 +283,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /** Returns the value of the bit numbered IDX in B. */
@@ -217,14 +310,29 @@ bitmap_set_all (struct bitmap *b, bool value)
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t idx = elem_idx (start);
+      size_t ofs = start % ELEM_BITS;
+      size_t n = cnt < ELEM_BITS - ofs ? cnt : ELEM_BITS - ofs;
+      elem_type mask = range_mask (ofs, n);
+
+      /* As in bitmap_mark() and bitmap_reset(), each element, but
+         not its summary bit, is updated atomically on a
+         uniprocessor machine. */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      update_summary (b, idx);
+
+      start += n;
+      cnt -= n;
+    }
 }
 
 /** Returns the number of bits in B between START and START + CNT,
@@ -232,17 +340,23 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t left, true_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  true_cnt = 0;
+  for (left = cnt; left > 0; )
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = left < ELEM_BITS - ofs ? left : ELEM_BITS - ofs;
+
+      true_cnt += count_bits (b->bits[elem_idx (start)] & range_mask (ofs, n));
+      start += n;
+      left -= n;
+    }
+  return value ? true_cnt : cnt - true_cnt;
 }
 
 /** Returns true if any bits in B between START and START + CNT,
@@ -250,15 +364,21 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = cnt < ELEM_BITS - ofs ? cnt : ELEM_BITS - ofs;
+      elem_type elem = b->bits[elem_idx (start)];
+
+      if ((value ? elem : ~elem) & range_mask (ofs, n))
+        return true;
+      start += n;
+      cnt -= n;
+    }
   return false;
 }
 
@@ -288,6 +408,54 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /** Finding set or unset bits. */
 
+/** Returns the index of the first element of B's bits at or
+   after IDX that is not all 1s, or elem_cnt (b->bit_cnt) if
+   there is none. */
+static size_t
+next_nonfull_elem (const struct bitmap *b, size_t idx)
+{
+  size_t bits_cnt = elem_cnt (b->bit_cnt);
+  size_t full_cnt = elem_cnt (bits_cnt);
+  size_t i = elem_idx (idx);
+  elem_type nonfull;
+
+  if (idx >= bits_cnt)
+    return bits_cnt;
+  nonfull = ~b->full[i] & ~(bit_mask (idx) - 1);
+  while (nonfull == 0)
+    {
+      if (++i >= full_cnt)
+        return bits_cnt;
+      nonfull = ~b->full[i];
+    }
+  idx = i * ELEM_BITS + lowest_bit (nonfull);
+  return idx < bits_cnt ? idx : bits_cnt;
+}
+
+/** Returns the index of the first bit in B at or after START
+   that is set to VALUE, or B's size if there is none. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value)
+{
+  size_t bits_cnt = elem_cnt (b->bit_cnt);
+  size_t idx = elem_idx (start);
+  elem_type elem;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+  elem = value ? b->bits[idx] : ~b->bits[idx];
+  elem &= ~(bit_mask (start) - 1);
+  while (elem == 0)
+    {
+      idx = value ? idx + 1 : next_nonfull_elem (b, idx + 1);
+      if (idx >= bits_cnt)
+        return b->bit_cnt;
+      elem = value ? b->bits[idx] : ~b->bits[idx];
+    }
+  start = idx * ELEM_BITS + lowest_bit (elem);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /** Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -298,13 +466,27 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 0)
+    return start;
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+
+      /* Jump from each run of VALUE bits to the next, and stop at
+         the first one that is long enough. */
+      while (i <= last)
+        {
+          size_t end;
+
+          i = next_bit (b, i, value);
+          if (i > last)
+            break;
+          end = next_bit (b, i, !value);
+          if (end - i >= cnt)
+            return i;
+          i = end;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -346,6 +528,7 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      rebuild_summary (b);
     }
   return success;
 }
@@ -0,0 +1,313 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/** Red-black tree.
+
+   See rbtree.h for basic information.  The algorithms follow
+   [CLRS] chapter 13, with null pointers for the leaves instead
+   of a sentinel node, which means that removal has to keep track
+   of the parent of the node it is fixing up. */
+
+/** Initializes tree T to order its elements using LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (less != NULL);
+
+  t->root = t->first = NULL;
+  t->less = less;
+  t->aux = aux;
+}
+
+/** Returns true if T is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *t)
+{
+  return t->root == NULL;
+}
+
+/** Returns the smallest element in T, or a null pointer if T is
+   empty. */
+struct rb_node *
+rb_first (const struct rb_tree *t)
+{
+  return t->first;
+}
+
+/** Returns the element that follows N in its tree, or a null
+   pointer if N is the largest. */
+struct rb_node *
+rb_next (const struct rb_node *n)
+{
+  ASSERT (n != NULL);
+
+  if (n->right != NULL)
+    {
+      n = n->right;
+      while (n->left != NULL)
+        n = n->left;
+      return (struct rb_node *) n;
+    }
+  while (n->parent != NULL && n == n->parent->right)
+    n = n->parent;
+  return n->parent;
+}
+
+/** Puts V where U is as the child of U's parent. */
+static void
+replace_child (struct rb_tree *t, struct rb_node *u, struct rb_node *v)
+{
+  if (u->parent == NULL)
+    t->root = v;
+  else if (u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+  if (v != NULL)
+    v->parent = u->parent;
+}
+
+/** Rotates X's right child up into X's place. */
+static void
+rotate_left (struct rb_tree *t, struct rb_node *x)
+{
+  struct rb_node *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  replace_child (t, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/** Rotates X's left child up into X's place. */
+static void
+rotate_right (struct rb_tree *t, struct rb_node *x)
+{
+  struct rb_node *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  replace_child (t, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/** Returns true if N is a red node, false if it is black or a
+   leaf. */
+static inline bool
+is_red (const struct rb_node *n)
+{
+  return n != NULL && n->red;
+}
+
+/** Inserts N into T, after any elements equal to it. */
+void
+rb_insert (struct rb_tree *t, struct rb_node *n)
+{
+  struct rb_node **link = &t->root;
+  struct rb_node *parent = NULL;
+  bool leftmost = true;
+
+  ASSERT (t != NULL);
+  ASSERT (n != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (t->less (n, parent, t->aux))
+        link = &parent->left;
+      else
+        {
+          link = &parent->right;
+          leftmost = false;
+        }
+    }
+  n->parent = parent;
+  n->left = n->right = NULL;
+  n->red = true;
+  *link = n;
+  if (leftmost)
+    t->first = n;
+
+  /* Restore the red-black properties: a red node's parent is
+     black. */
+  while (is_red (parent = n->parent))
+    {
+      struct rb_node *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+        {
+          struct rb_node *uncle = grandparent->right;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              n = grandparent;
+              continue;
+            }
+          if (n == parent->right)
+            {
+              rotate_left (t, parent);
+              n = parent;
+              parent = n->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (t, grandparent);
+        }
+      else
+        {
+          struct rb_node *uncle = grandparent->left;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              n = grandparent;
+              continue;
+            }
+          if (n == parent->left)
+            {
+              rotate_right (t, parent);
+              n = parent;
+              parent = n->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (t, grandparent);
+        }
+    }
+  t->root->red = false;
+}
+
+/** Removes N, which must be in T, from T. */
+void
+rb_remove (struct rb_tree *t, struct rb_node *n)
+{
+  struct rb_node *x, *parent;
+  bool removed_red;
+
+  ASSERT (t != NULL);
+  ASSERT (n != NULL);
+
+  if (t->first == n)
+    t->first = rb_next (n);
+
+  /* Unlink N, or its successor if N has two children, in which
+     case the successor takes N's place and color.  X is the node
+     that moves into the unlinked node's place, possibly a leaf,
+     and PARENT its new parent. */
+  removed_red = n->red;
+  if (n->left == NULL)
+    {
+      x = n->right;
+      parent = n->parent;
+      replace_child (t, n, x);
+    }
+  else if (n->right == NULL)
+    {
+      x = n->left;
+      parent = n->parent;
+      replace_child (t, n, x);
+    }
+  else
+    {
+      struct rb_node *y = n->right;
+
+      while (y->left != NULL)
+        y = y->left;
+      removed_red = y->red;
+      x = y->right;
+      if (y->parent == n)
+        parent = y;
+      else
+        {
+          parent = y->parent;
+          replace_child (t, y, x);
+          y->right = n->right;
+          y->right->parent = y;
+        }
+      replace_child (t, n, y);
+      y->left = n->left;
+      y->left->parent = y;
+      y->red = n->red;
+    }
+  if (removed_red)
+    return;
+
+  /* A black node is gone, so paths through X are one black node
+     short.  Push the deficit up until it can be absorbed. */
+  while (x != t->root && !is_red (x))
+    {
+      if (x == parent->left)
+        {
+          struct rb_node *sibling = parent->right;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (t, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->right))
+                {
+                  sibling->left->red = false;
+                  sibling->red = true;
+                  rotate_right (t, sibling);
+                  sibling = parent->right;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->right->red = false;
+              rotate_left (t, parent);
+              x = t->root;
+            }
+        }
+      else
+        {
+          struct rb_node *sibling = parent->left;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (t, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->left))
+                {
+                  sibling->right->red = false;
+                  sibling->red = true;
+                  rotate_left (t, sibling);
+                  sibling = parent->left;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->left->red = false;
+              rotate_right (t, parent);
+              x = t->root;
+            }
+        }
+    }
+  if (x != NULL)
+    x->red = false;
+}
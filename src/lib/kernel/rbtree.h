@@ -0,0 +1,61 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/** Red-black tree.
+
+   A binary search tree kept balanced by coloring each node red
+   or black, so that no path from the root to a leaf is more than
+   twice as long as any other.  Inserting and removing an element
+   are O(log n), and the smallest element is cached, so finding
+   it is O(1).
+
+   Like the lists in list.h, the tree does not use dynamic
+   allocation.  Each structure that can be in a tree embeds a
+   struct rb_node member, and rb_entry() converts a pointer to
+   the member back into one to the structure.  Elements that
+   compare equal are kept in the order they were inserted. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Tree element. */
+struct rb_node
+  {
+    struct rb_node *parent;     /**< Parent, or null for the root. */
+    struct rb_node *left;       /**< Left child, or null. */
+    struct rb_node *right;      /**< Right child, or null. */
+    bool red;                   /**< Red or black? */
+  };
+
+/** Converts pointer to tree element RB_NODE into a pointer to
+   the structure that RB_NODE is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element. */
+#define rb_entry(RB_NODE, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) (RB_NODE)                      \
+                     - offsetof (STRUCT, MEMBER)))
+
+/** Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_node *a,
+                           const struct rb_node *b, void *aux);
+
+/** Red-black tree. */
+struct rb_tree
+  {
+    struct rb_node *root;       /**< Root, or null if empty. */
+    struct rb_node *first;      /**< Smallest element, or null. */
+    rb_less_func *less;         /**< Comparison function. */
+    void *aux;                  /**< Auxiliary data for `less'. */
+  };
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+bool rb_empty (const struct rb_tree *);
+struct rb_node *rb_first (const struct rb_tree *);
+struct rb_node *rb_next (const struct rb_node *);
+void rb_insert (struct rb_tree *, struct rb_node *);
+void rb_remove (struct rb_tree *, struct rb_node *);
+
+#endif /**< lib/kernel/rbtree.h */
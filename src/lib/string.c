@@ -1,5 +1,58 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/** The block functions below move data a machine word at a time
+   where they can.  Copies and fills use the x86 string
+   instructions: a few single bytes bring the destination to a
+   word boundary, "rep movsl" or "rep stosl" handles the bulk, and
+   single bytes finish off the tail.  A block that is already
+   word-aligned and a whole number of words long, as every page
+   is, goes straight to the word loop.  Comparisons and searches
+   load a word at a time and fall back to bytes only to locate
+   the difference or the match within a word. */
+
+/** A machine word, which may be loaded from any address. */
+typedef unsigned long word_t __attribute__ ((may_alias, aligned (1)));
+
+/** Bytes in a word, and masks with 0x01 and 0x80 in each byte. */
+#define WORD_SIZE sizeof (unsigned long)
+#define ONES ((unsigned long) -1 / 0xff)
+#define HIGHS (ONES * 0x80)
+
+/** Returns nonzero if some byte in WORD is zero. */
+static inline unsigned long
+has_zero_byte (unsigned long word)
+{
+  return (word - ONES) & ~word & HIGHS;
+}
+
+/** Returns the number of bytes from P up to the next word
+   boundary. */
+static inline size_t
+bytes_to_align (const void *p)
+{
+  return -(uintptr_t) p & (WORD_SIZE - 1);
+}
+
+/** Copies SIZE bytes forward from SRC to DST. */
+static inline void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  size_t head = 0, words, tail;
+
+  if (((uintptr_t) dst | size) % WORD_SIZE != 0 && size >= 2 * WORD_SIZE)
+    head = bytes_to_align (dst);
+  words = (size - head) / WORD_SIZE;
+  tail = (size - head) % WORD_SIZE;
+
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (tail) : : "memory");
+}
 
 /** Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +65,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  copy_forward (dst, src, size);
 
   return dst_;
 }
@@ -29,20 +81,29 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
+  if (dst <= src || dst >= src + size) 
+    copy_forward (dst, src, size);
   else 
     {
+      /* DST overlaps the end of SRC, so copy backward: the odd
+         bytes at the end first, then whole words, with the
+         direction flag set for the string instruction and
+         cleared again afterward as the ABI requires. */
+      size_t words = size / WORD_SIZE;
+      size_t tail = size % WORD_SIZE;
+
       dst += size;
       src += size;
-      while (size-- > 0)
+      while (tail-- > 0)
         *--dst = *--src;
+
+      dst -= WORD_SIZE;
+      src -= WORD_SIZE;
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
     }
 
-  return dst;
+  return dst_;
 }
 
 /** Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +119,11 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words, then find the difference a byte at a
+     time. */
+  for (; size >= WORD_SIZE; a += WORD_SIZE, b += WORD_SIZE, size -= WORD_SIZE)
+    if (*(const word_t *) a != *(const word_t *) b)
+      break;
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -98,6 +164,14 @@ memchr (const void *block_, int ch_, size_t size)
 
   ASSERT (block != NULL || size == 0);
 
+  /* Look at single bytes up to a word boundary, then at whole
+     words until one holds CH, then at single bytes again. */
+  for (; size > 0 && bytes_to_align (block) != 0; size--, block++)
+    if (*block == ch)
+      return (void *) block;
+  for (; size >= WORD_SIZE; size -= WORD_SIZE, block += WORD_SIZE)
+    if (has_zero_byte (*(const word_t *) block ^ (ONES * ch)))
+      break;
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -279,11 +353,19 @@ void *
 memset (void *dst_, int value, size_t size) 
 {
   unsigned char *dst = dst_;
+  unsigned long word = ONES * (unsigned char) value;
+  size_t head = 0, words, tail;
 
   ASSERT (dst != NULL || size == 0);
   
-  while (size-- > 0)
-    *dst++ = value;
+  if (((uintptr_t) dst | size) % WORD_SIZE != 0 && size >= 2 * WORD_SIZE)
+    head = bytes_to_align (dst);
+  words = (size - head) / WORD_SIZE;
+  tail = (size - head) % WORD_SIZE;
+
+  asm volatile ("rep stosb" : "+D" (dst), "+c" (head) : "a" (word) : "memory");
+  asm volatile ("rep stosl" : "+D" (dst), "+c" (words) : "a" (word) : "memory");
+  asm volatile ("rep stosb" : "+D" (dst), "+c" (tail) : "a" (word) : "memory");
 
   return dst_;
 }
@@ -296,8 +378,15 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
-    continue;
+  /* Once P is word-aligned, a whole-word load cannot cross into
+     another page, so it is safe to read past the terminator. */
+  for (p = string; bytes_to_align (p) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  while (!has_zero_byte (*(const word_t *) p))
+    p += WORD_SIZE;
+  while (*p != '\0')
+    p++;
   return p - string;
 }
 
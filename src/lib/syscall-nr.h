@@ -28,7 +28,22 @@ enum
     SYS_MKDIR,                  /**< Create a directory. */
     SYS_READDIR,                /**< Reads a directory entry. */
     SYS_ISDIR,                  /**< Tests if a fd represents a directory. */
-    SYS_INUMBER                 /**< Returns the inode number for a fd. */
+    SYS_INUMBER,                /**< Returns the inode number for a fd. */
+
+    /* User-level synchronization. */
+    SYS_FUTEX_WAIT,             /**< Sleep while a word holds a value. */
+    SYS_FUTEX_WAKE,             /**< Wake threads sleeping on a word. */
+
+    /* Timekeeping. */
+    SYS_CLOCK_NS                /**< Read the monotonic clock. */
+  };
+
+/** Results of SYS_FUTEX_WAIT. */
+enum
+  {
+    FUTEX_WOKEN,                /**< Woken by SYS_FUTEX_WAKE. */
+    FUTEX_CHANGED,              /**< Word did not hold the expected value. */
+    FUTEX_TIMED_OUT             /**< Timeout passed first. */
   };
 
 #endif /**< lib/syscall-nr.h */
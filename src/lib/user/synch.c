@@ -0,0 +1,214 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/** Number of system calls made by the functions below. */
+static int syscall_cnt;
+
+/** Atomically sets *P to NEW if it holds OLD.  Returns the value
+   *P held before. */
+static inline int
+compare_exchange (int *p, int old, int new)
+{
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "+a" (old), "+m" (*p) : "r" (new) : "memory");
+  return old;
+}
+
+/** Atomically sets *P to NEW and returns the value it held
+   before. */
+static inline int
+exchange (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/** Atomically adds DELTA to *P and returns the value it held
+   before. */
+static inline int
+fetch_add (int *p, int delta)
+{
+  asm volatile ("lock xaddl %0, %1" : "+r" (delta), "+m" (*p) : : "memory");
+  return delta;
+}
+
+/** Sleeps while *P holds EXPECTED. */
+static void
+sleep_on (int *p, int expected)
+{
+  fetch_add (&syscall_cnt, 1);
+  futex_wait (p, expected, -1);
+}
+
+/** Wakes up to N threads sleeping on *P. */
+static void
+wake_on (int *p, int n)
+{
+  fetch_add (&syscall_cnt, 1);
+  futex_wake (p, n);
+}
+
+/** Initializes LOCK.  A lock can be held by at most a single
+   thread at any given time.  Unlike the kernel's locks, it does
+   not record its holder, so it is not recursive and nothing
+   checks that the releasing thread is the one that acquired
+   it. */
+void
+lock_init (struct lock *lock)
+{
+  lock->state = 0;
+}
+
+/** Acquires LOCK, sleeping until it becomes available if
+   necessary.
+
+   A lock that is taken while another thread sleeps on it is
+   marked contended, so that its release wakes the sleeper.  Once
+   a thread has slept, it takes the lock as contended itself,
+   because it cannot tell whether others still sleep. */
+void
+lock_acquire (struct lock *lock)
+{
+  int state = compare_exchange (&lock->state, 0, 1);
+
+  if (state == 0)
+    return;
+  if (state != 2)
+    state = exchange (&lock->state, 2);
+  while (state != 0)
+    {
+      sleep_on (&lock->state, 2);
+      state = exchange (&lock->state, 2);
+    }
+}
+
+/** Tries to acquire LOCK and returns true if successful or false
+   on failure.  Never sleeps. */
+bool
+lock_try_acquire (struct lock *lock)
+{
+  return compare_exchange (&lock->state, 0, 1) == 0;
+}
+
+/** Releases LOCK, which must be held by the current thread, and
+   wakes one thread sleeping on it, if any. */
+void
+lock_release (struct lock *lock)
+{
+  if (exchange (&lock->state, 0) == 2)
+    wake_on (&lock->state, 1);
+}
+
+/** Initializes SEMA to VALUE. */
+void
+sema_init (struct semaphore *sema, int value)
+{
+  sema->value = value;
+  sema->waiter_cnt = 0;
+}
+
+/** Down or "P" operation on SEMA.  Waits for its value to become
+   positive and then atomically decrements it. */
+void
+sema_down (struct semaphore *sema)
+{
+  while (!sema_try_down (sema))
+    {
+      /* Announce ourselves before checking the value again in the
+         kernel, so that a sema_up() either sees us or leaves a
+         value that keeps us from sleeping. */
+      fetch_add (&sema->waiter_cnt, 1);
+      sleep_on (&sema->value, 0);
+      fetch_add (&sema->waiter_cnt, -1);
+    }
+}
+
+/** Down or "P" operation on SEMA, but only if its value is
+   positive.  Returns true if the value was decremented, false
+   otherwise. */
+bool
+sema_try_down (struct semaphore *sema)
+{
+  int value = sema->value;
+
+  while (value > 0)
+    {
+      int old = compare_exchange (&sema->value, value, value - 1);
+      if (old == value)
+        return true;
+      value = old;
+    }
+  return false;
+}
+
+/** Up or "V" operation on SEMA.  Increments its value and wakes
+   one thread waiting for it, if any. */
+void
+sema_up (struct semaphore *sema)
+{
+  fetch_add (&sema->value, 1);
+  if (sema->waiter_cnt > 0)
+    wake_on (&sema->value, 1);
+}
+
+/** Initializes condition variable COND. */
+void
+cond_init (struct condition *cond)
+{
+  cond->seq = 0;
+  cond->waiter_cnt = 0;
+}
+
+/** Atomically releases LOCK and waits for COND to be signaled by
+   some other piece of code, then reacquires LOCK before
+   returning.  LOCK must be held before calling this function.
+
+   As with the kernel's condition variables, the condition must
+   be rechecked after the wait completes: besides being signaled
+   "Mesa" style, a waiter may occasionally wake without any
+   signal at all. */
+void
+cond_wait (struct condition *cond, struct lock *lock)
+{
+  int seq = cond->seq;
+
+  cond->waiter_cnt++;
+  lock_release (lock);
+  sleep_on (&cond->seq, seq);
+  lock_acquire (lock);
+  cond->waiter_cnt--;
+}
+
+/** If any threads are waiting on COND (protected by LOCK), then
+   this function wakes up one of them.  LOCK must be held before
+   calling this function. */
+void
+cond_signal (struct condition *cond, struct lock *lock UNUSED)
+{
+  if (cond->waiter_cnt > 0)
+    {
+      fetch_add (&cond->seq, 1);
+      wake_on (&cond->seq, 1);
+    }
+}
+
+/** Wakes up all threads, if any, waiting on COND (protected by
+   LOCK).  LOCK must be held before calling this function. */
+void
+cond_broadcast (struct condition *cond, struct lock *lock UNUSED)
+{
+  if (cond->waiter_cnt > 0)
+    {
+      fetch_add (&cond->seq, 1);
+      wake_on (&cond->seq, INT_MAX);
+    }
+}
+
+/** Returns the number of system calls the functions above have
+   made, for measuring how often they have to enter the kernel. */
+unsigned
+synch_syscall_cnt (void)
+{
+  return syscall_cnt;
+}
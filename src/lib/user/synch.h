@@ -0,0 +1,52 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/** User-level synchronization primitives.
+
+   Each one keeps its state in a word of user memory that it
+   updates with atomic instructions, and enters the kernel only
+   to sleep on that word or to wake those sleeping on it, through
+   futex_wait() and futex_wake().  An operation that does not have
+   to wait, and finds nobody waiting, makes no system call at
+   all. */
+
+/** Lock. */
+struct lock
+  {
+    int state;                  /**< 0: free, 1: held, 2: held, contended. */
+  };
+
+void lock_init (struct lock *);
+void lock_acquire (struct lock *);
+bool lock_try_acquire (struct lock *);
+void lock_release (struct lock *);
+
+/** Counting semaphore. */
+struct semaphore
+  {
+    int value;                  /**< Current value. */
+    int waiter_cnt;             /**< Threads about to sleep or sleeping. */
+  };
+
+void sema_init (struct semaphore *, int value);
+void sema_down (struct semaphore *);
+bool sema_try_down (struct semaphore *);
+void sema_up (struct semaphore *);
+
+/** Condition variable. */
+struct condition
+  {
+    int seq;                    /**< Bumped by every signal. */
+    int waiter_cnt;             /**< Waiters, protected by their lock. */
+  };
+
+void cond_init (struct condition *);
+void cond_wait (struct condition *, struct lock *);
+void cond_signal (struct condition *, struct lock *);
+void cond_broadcast (struct condition *, struct lock *);
+
+unsigned synch_syscall_cnt (void);
+
+#endif /**< lib/user/synch.h */
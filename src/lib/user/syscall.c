@@ -182,3 +182,23 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+futex_wait (const int *addr, int expected, int timeout_ms)
+{
+  return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout_ms);
+}
+
+int
+futex_wake (const int *addr, int n)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, n);
+}
+
+int64_t
+clock_ns (void)
+{
+  int64_t ns;
+  syscall1 (SYS_CLOCK_NS, &ns);
+  return ns;
+}
@@ -2,7 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <syscall-nr.h>
 
 /** Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,13 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/** User-level synchronization.  futex_wait() returns one of the
+   FUTEX_* results from <syscall-nr.h>.  A negative TIMEOUT_MS
+   waits without a time limit. */
+int futex_wait (const int *addr, int expected, int timeout_ms);
+int futex_wake (const int *addr, int n);
+
+/** Timekeeping.  Nanoseconds since boot, from a monotonic clock. */
+int64_t clock_ns (void);
+
 #endif /**< lib/user/syscall.h */
@@ -0,0 +1,64 @@
+/** Measures read throughput from a 512 kB file, once reading it
+   from start to end in 4 kB chunks and once reading 512-byte
+   sectors at random, and reports each in kB/s.  Running it with
+   and without "pintos --virtio" compares the virtio-blk and IDE
+   drivers.
+
+   Only reports numbers, so it passes as long as every read
+   succeeds. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (512 * 1024)
+#define SEQ_SIZE 4096
+#define RANDOM_SIZE 512
+#define RANDOM_CNT 1024
+
+static char buf[SEQ_SIZE];
+
+/** Returns the throughput in kB/s of moving BYTES in NS ns. */
+static int64_t
+kb_per_sec (int64_t bytes, int64_t ns)
+{
+  return ns > 0 ? bytes * 1000000000 / ns / 1024 : 0;
+}
+
+void
+test_main (void)
+{
+  int64_t start, seq_ns, random_ns;
+  size_t ofs;
+  int fd, i;
+
+  CHECK (create ("data", FILE_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += SEQ_SIZE)
+    if (write (fd, buf, SEQ_SIZE) != SEQ_SIZE)
+      fail ("write %d bytes at offset %zu failed", SEQ_SIZE, ofs);
+
+  seek (fd, 0);
+  start = clock_ns ();
+  for (ofs = 0; ofs < FILE_SIZE; ofs += SEQ_SIZE)
+    if (read (fd, buf, SEQ_SIZE) != SEQ_SIZE)
+      fail ("read %d bytes at offset %zu failed", SEQ_SIZE, ofs);
+  seq_ns = clock_ns () - start;
+
+  random_init (0);
+  start = clock_ns ();
+  for (i = 0; i < RANDOM_CNT; i++)
+    {
+      ofs = random_ulong () % (FILE_SIZE / RANDOM_SIZE) * RANDOM_SIZE;
+      seek (fd, ofs);
+      if (read (fd, buf, RANDOM_SIZE) != RANDOM_SIZE)
+        fail ("read %d bytes at offset %zu failed", RANDOM_SIZE, ofs);
+    }
+  random_ns = clock_ns () - start;
+  close (fd);
+
+  msg ("sequential reads: %lld kB/s", kb_per_sec (FILE_SIZE, seq_ns));
+  msg ("random reads: %lld kB/s",
+       kb_per_sec ((int64_t) RANDOM_SIZE * RANDOM_CNT, random_ns));
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (read-bench) sequential reads: 10240 kB/s
+# (read-bench) random reads: 2048 kB/s
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/(sequential|random) reads: \d+ kB\/s/, @output);
+fail "2 throughputs expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 2;
+
+pass;
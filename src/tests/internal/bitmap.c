@@ -0,0 +1,145 @@
+/** Test program and benchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count() and bitmap_contains()
+   against a bit-at-a-time reference on random bitmaps, and then
+   times bitmap_scan_and_flip() followed by freeing the bits it
+   found, the way the free map and swap slot map use it, on
+   bitmaps filled to several levels.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/clock.h"
+#include "threads/test.h"
+
+/** Number of bits in the bitmaps we test. */
+#define BIT_CNT 8192
+
+/** Fill levels to benchmark, in percent. */
+static const int fill_levels[] = {0, 50, 90, 99};
+#define FILL_CNT (sizeof fill_levels / sizeof *fill_levels)
+
+/** Scan and flip operations to time at each fill level. */
+#define OP_CNT 4096
+
+static void fill (struct bitmap *, int percent);
+static void verify (const struct bitmap *);
+static uint64_t time_scan_and_flip (struct bitmap *, size_t cnt);
+
+/** Test and benchmark the bitmap implementation. */
+void
+test (void) 
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  size_t i;
+
+  ASSERT (b != NULL);
+
+  printf ("testing bitmap operations:");
+  for (i = 0; i < FILL_CNT; i++)
+    {
+      fill (b, fill_levels[i]);
+      verify (b);
+      printf (" %d%%", fill_levels[i]);
+    }
+  printf (" done\n");
+
+  for (i = 0; i < FILL_CNT; i++)
+    {
+      size_t cnt;
+
+      for (cnt = 1; cnt <= 8; cnt *= 8)
+        {
+          fill (b, fill_levels[i]);
+          printf ("%d%% full, %zu bits: %"PRIu64" cycles per scan and flip\n",
+                  fill_levels[i], cnt, time_scan_and_flip (b, cnt));
+        }
+    }
+
+  bitmap_destroy (b);
+}
+
+/** Sets about PERCENT percent of the bits in B, at random. */
+static void
+fill (struct bitmap *b, int percent)
+{
+  size_t i;
+
+  bitmap_set_all (b, false);
+  for (i = 0; i < bitmap_size (b); i++)
+    if (random_ulong () % 100 < (unsigned long) percent)
+      bitmap_mark (b, i);
+}
+
+/** Returns true if the CNT bits starting at START in B are all
+   VALUE, testing them one at a time. */
+static bool
+all_are (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) != value)
+      return false;
+  return true;
+}
+
+/** Checks the multiple-bit operations on B against bit-at-a-time
+   equivalents over random ranges. */
+static void
+verify (const struct bitmap *b)
+{
+  int trial;
+
+  for (trial = 0; trial < 256; trial++)
+    {
+      size_t start = random_ulong () % BIT_CNT;
+      size_t cnt = random_ulong () % (BIT_CNT - start);
+      size_t scan_cnt = random_ulong () % 12;
+      bool value = random_ulong () % 2;
+      size_t expected, i;
+
+      expected = 0;
+      for (i = 0; i < cnt; i++)
+        if (bitmap_test (b, start + i) == value)
+          expected++;
+      ASSERT (bitmap_count (b, start, cnt, value) == expected);
+      ASSERT (bitmap_contains (b, start, cnt, value) == (expected > 0));
+
+      expected = BITMAP_ERROR;
+      for (i = start; i + scan_cnt <= BIT_CNT; i++)
+        if (all_are (b, i, scan_cnt, value))
+          {
+            expected = i;
+            break;
+          }
+      ASSERT (bitmap_scan (b, start, scan_cnt, value) == expected);
+    }
+}
+
+/** Allocates and frees runs of CNT false bits in B OP_CNT times,
+   and returns the average cycles each allocation took. */
+static uint64_t
+time_scan_and_flip (struct bitmap *b, size_t cnt)
+{
+  uint64_t cycles = 0;
+  int op;
+
+  for (op = 0; op < OP_CNT; op++)
+    {
+      uint64_t start = clock_cycles ();
+      size_t idx = bitmap_scan_and_flip (b, 0, cnt, false);
+      cycles += clock_cycles () - start;
+
+      if (idx != BITMAP_ERROR)
+        bitmap_set_multiple (b, idx, cnt, false);
+    }
+  return cycles / OP_CNT;
+}
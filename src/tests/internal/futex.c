@@ -0,0 +1,73 @@
+/** Test program for userprog/futex.c.
+
+   Checks that a timed futex wait that futex_wake() ends returns
+   FUTEX_WOKEN, even when the waiter does not get to run again
+   until after its timeout would have expired.  The timeout must
+   then not fire on a waiter that is no longer in the table.
+
+   Needs the priority scheduler, and a kernel built with
+   USERPROG.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <stdio.h>
+#include <syscall-nr.h>
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/test.h"
+#include "threads/thread.h"
+#include "userprog/futex.h"
+
+/** How long the waiter is willing to wait, in milliseconds. */
+#define TIMEOUT_MS 20
+
+static int word;
+static int result;
+static struct semaphore done;
+
+static thread_func waiter;
+
+void
+test (void)
+{
+  int64_t start;
+  int woken;
+
+  sema_init (&done, 0);
+  result = -1;
+
+  /* The waiter has a higher priority, so it goes to sleep on
+     WORD before we get back here. */
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter, NULL);
+
+  /* Wake it while outranking it, and keep it from running until
+     its timeout has come and gone. */
+  thread_set_priority (PRI_DEFAULT + 2);
+  woken = futex_wake_kernel (&word, 1);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < TIMEOUT_MS * TIMER_FREQ / 1000 + 2)
+    continue;
+  thread_set_priority (PRI_DEFAULT);
+
+  sema_down (&done);
+  ASSERT (woken == 1);
+  ASSERT (result == FUTEX_WOKEN);
+
+  /* A wait that nobody ends still runs out. */
+  ASSERT (futex_wait_kernel (&word, 0, TIMEOUT_MS) == FUTEX_TIMED_OUT);
+
+  printf ("futex: PASS\n");
+}
+
+/** Sleeps on WORD with a timeout and records how the wait
+   ended. */
+static void
+waiter (void *aux UNUSED)
+{
+  result = futex_wait_kernel (&word, 0, TIMEOUT_MS);
+  sema_up (&done);
+}
@@ -0,0 +1,167 @@
+/** Test program for lib/kernel/rbtree.c.
+
+   Inserts and removes elements at random, with many equal keys,
+   and after every change checks that walking the tree with
+   rb_first() and rb_next() visits exactly the elements in it, in
+   order, with equal keys in the order they were inserted, and
+   that the tree obeys the red-black rules.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/** Number of elements to draw from. */
+#define VALUE_CNT 256
+
+/** Number of random insertions and removals per round. */
+#define OP_CNT 4096
+
+/** Keys are drawn from 0...KEY_CNT - 1, so many are equal. */
+#define KEY_CNT 32
+
+/** A tree element. */
+struct value
+  {
+    struct rb_node node;        /**< Tree element. */
+    int key;                    /**< Sort key. */
+    unsigned seq;               /**< When it was last inserted. */
+    bool in_tree;               /**< Is it in the tree now? */
+  };
+
+static bool value_less (const struct rb_node *, const struct rb_node *,
+                        void *);
+static void verify_tree (const struct rb_tree *, size_t cnt);
+static int verify_subtree (const struct rb_node *, const struct rb_node *);
+
+/** Test the red-black tree implementation. */
+void
+test (void)
+{
+  static struct value values[VALUE_CNT];
+  int round;
+
+  printf ("testing random insertions and removals:");
+  for (round = 0; round < 10; round++)
+    {
+      struct rb_tree tree;
+      unsigned seq = 0;
+      size_t cnt = 0;
+      int i;
+
+      printf (" %d", round);
+      rb_init (&tree, value_less, NULL);
+      for (i = 0; i < VALUE_CNT; i++)
+        values[i].in_tree = false;
+      verify_tree (&tree, 0);
+
+      for (i = 0; i < OP_CNT; i++)
+        {
+          struct value *v = &values[random_ulong () % VALUE_CNT];
+
+          if (v->in_tree)
+            {
+              rb_remove (&tree, &v->node);
+              v->in_tree = false;
+              cnt--;
+            }
+          else
+            {
+              v->key = random_ulong () % KEY_CNT;
+              v->seq = seq++;
+              rb_insert (&tree, &v->node);
+              v->in_tree = true;
+              cnt++;
+            }
+          verify_tree (&tree, cnt);
+        }
+
+      /* Empty the tree, smallest element first. */
+      while (!rb_empty (&tree))
+        {
+          struct value *v = rb_entry (rb_first (&tree), struct value, node);
+          rb_remove (&tree, &v->node);
+          v->in_tree = false;
+          verify_tree (&tree, --cnt);
+        }
+      ASSERT (cnt == 0);
+    }
+
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/** Returns true if value A is less than value B, false
+   otherwise.  Only keys are compared. */
+static bool
+value_less (const struct rb_node *a_, const struct rb_node *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = rb_entry (a_, struct value, node);
+  const struct value *b = rb_entry (b_, struct value, node);
+
+  return a->key < b->key;
+}
+
+/** Verifies that TREE holds CNT elements, all of them in the tree,
+   in order by key and then by insertion, and that it is a valid
+   red-black tree. */
+static void
+verify_tree (const struct rb_tree *tree, size_t cnt)
+{
+  const struct value *prev = NULL;
+  struct rb_node *n;
+  size_t i = 0;
+
+  ASSERT (rb_empty (tree) == (cnt == 0));
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_subtree (tree->root, NULL);
+
+  /* rb_first() must be the leftmost node. */
+  n = tree->root;
+  while (n != NULL && n->left != NULL)
+    n = n->left;
+  ASSERT (rb_first (tree) == n);
+
+  for (n = rb_first (tree); n != NULL; n = rb_next (n))
+    {
+      const struct value *v = rb_entry (n, struct value, node);
+
+      ASSERT (v->in_tree);
+      ASSERT (prev == NULL || prev->key < v->key
+              || (prev->key == v->key && prev->seq < v->seq));
+      prev = v;
+      i++;
+      ASSERT (i <= cnt);
+    }
+  ASSERT (i == cnt);
+}
+
+/** Verifies the subtree rooted at N, whose parent should be
+   PARENT: parent pointers agree with child pointers, no red node
+   has a red child, and every path down to a leaf passes the same
+   number of black nodes.  Returns that number. */
+static int
+verify_subtree (const struct rb_node *n, const struct rb_node *parent)
+{
+  int left_height, right_height;
+
+  if (n == NULL)
+    return 1;
+
+  ASSERT (n->parent == parent);
+  if (n->red)
+    ASSERT ((n->left == NULL || !n->left->red)
+            && (n->right == NULL || !n->right->red));
+
+  left_height = verify_subtree (n->left, n);
+  right_height = verify_subtree (n->right, n);
+  ASSERT (left_height == right_height);
+  return left_height + !n->red;
+}
@@ -0,0 +1,158 @@
+/** Test program and benchmark for the block functions in
+   lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp(), memchr() and
+   strlen() against byte-at-a-time equivalents at every
+   alignment, and then reports how many bytes each of them moves
+   or examines per CPU cycle (as counted by the TSC), in
+   hundredths, for sizes from 1 byte to a 4 kB page.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/clock.h"
+#include "threads/test.h"
+
+/** Largest block we test, plus slack for misalignment. */
+#define MAX_SIZE 4096
+#define BUF_SIZE (MAX_SIZE + 16)
+
+/** Times each benchmark runs at each size. */
+#define REPEAT_CNT 256
+
+static unsigned char src[BUF_SIZE] __attribute__ ((aligned (16)));
+static unsigned char dst[BUF_SIZE] __attribute__ ((aligned (16)));
+static unsigned char ref[BUF_SIZE];
+static unsigned char tmp[BUF_SIZE];
+
+static void verify (void);
+static void benchmark (void);
+
+/** Test and benchmark the string implementation. */
+void
+test (void) 
+{
+  verify ();
+  benchmark ();
+}
+
+/** Fills BUF with random nonzero bytes. */
+static void
+randomize (unsigned char *buf)
+{
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    buf[i] = random_ulong () % 255 + 1;
+}
+
+/** Checks each function at every combination of small offsets
+   and a range of sizes. */
+static void
+verify (void)
+{
+  static const size_t sizes[] = {0, 1, 3, 4, 7, 8, 9, 31, 64, 100, 4096};
+  size_t s, so, doff, i;
+
+  printf ("testing string functions:");
+  for (s = 0; s < sizeof sizes / sizeof *sizes; s++)
+    for (so = 0; so < 8; so++)
+      for (doff = 0; doff < 8; doff++)
+        {
+          size_t size = sizes[s];
+
+          randomize (src);
+          randomize (dst);
+
+          memcpy (ref, dst, BUF_SIZE);
+          for (i = 0; i < size; i++)
+            ref[doff + i] = src[so + i];
+          ASSERT (memcpy (dst + doff, src + so, size) == dst + doff);
+          ASSERT (!memcmp (dst, ref, BUF_SIZE));
+          ASSERT (memcmp (dst + doff, src + so, size) == 0);
+          if (size > 0)
+            {
+              dst[doff + size - 1] ^= 1;
+              ASSERT (memcmp (dst + doff, src + so, size) != 0);
+            }
+
+          memcpy (ref, src, BUF_SIZE);
+          for (i = 0; i < size; i++)
+            tmp[i] = src[so + i];
+          for (i = 0; i < size; i++)
+            ref[doff + i] = tmp[i];
+          ASSERT (memmove (src + doff, src + so, size) == src + doff);
+          ASSERT (!memcmp (src, ref, BUF_SIZE));
+
+          memcpy (ref, dst, BUF_SIZE);
+          for (i = 0; i < size; i++)
+            ref[doff + i] = so;
+          ASSERT (memset (dst + doff, so, size) == dst + doff);
+          ASSERT (!memcmp (dst, ref, BUF_SIZE));
+
+          randomize (src);
+          if (size > 0)
+            src[so + size - 1] = 0;
+          ASSERT (memchr (src + so, 0, size)
+                  == (size > 0 ? src + so + size - 1 : NULL));
+          src[so + size] = 0;
+          ASSERT (strlen ((char *) src + so) == (size > 0 ? size - 1 : 0));
+        }
+  printf (" done\n");
+}
+
+/** Reports bytes per cycle for each function at each power of 2
+   up to MAX_SIZE. */
+static void
+benchmark (void)
+{
+  size_t size;
+
+  memset (src, 'x', BUF_SIZE);
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      uint64_t start, copy, fill, cmp, len;
+      int i;
+
+      src[size] = '\0';
+
+      start = clock_cycles ();
+      for (i = 0; i < REPEAT_CNT; i++)
+        memcpy (dst, src, size);
+      copy = clock_cycles () - start;
+
+      start = clock_cycles ();
+      for (i = 0; i < REPEAT_CNT; i++)
+        memset (dst, 0, size);
+      fill = clock_cycles () - start;
+
+      memcpy (dst, src, size);
+      start = clock_cycles ();
+      for (i = 0; i < REPEAT_CNT; i++)
+        if (memcmp (dst, src, size) != 0)
+          PANIC ("memcmp failed");
+      cmp = clock_cycles () - start;
+
+      start = clock_cycles ();
+      for (i = 0; i < REPEAT_CNT; i++)
+        if (strlen ((char *) src) != size)
+          PANIC ("strlen failed");
+      len = clock_cycles () - start;
+
+      src[size] = 'x';
+      printf ("%4zu bytes: memcpy %"PRIu64", memset %"PRIu64
+              ", memcmp %"PRIu64", strlen %"PRIu64
+              " hundredths of a byte per cycle\n", size,
+              100 * REPEAT_CNT * size / (copy + 1),
+              100 * REPEAT_CNT * size / (fill + 1),
+              100 * REPEAT_CNT * size / (cmp + 1),
+              100 * REPEAT_CNT * size / (len + 1));
+    }
+}
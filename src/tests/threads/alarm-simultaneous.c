@@ -18,6 +18,14 @@ test_alarm_simultaneous (void)
   test_sleep (3, 5);
 }
 
+/** Same as alarm-simultaneous, but run with -tickless, so that
+   the sleeps are timed by one-shot countdowns while idle. */
+void
+test_alarm_tickless (void) 
+{
+  test_sleep (3, 5);
+}
+
 /** Information about the test. */
 struct sleep_test 
   {
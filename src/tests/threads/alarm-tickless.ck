@@ -0,0 +1,34 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# The periodic tick must have been stopped while every thread slept.
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "no timer ticks were skipped while idle\n"
+  if !grep (/Timer: \d+ ticks, [1-9]\d* skipped while idle/, @output);
+
+check_expected ([<<'EOF']);
+(alarm-tickless) begin
+(alarm-tickless) Creating 3 threads to sleep 5 times each.
+(alarm-tickless) Each thread sleeps 10 ticks each time.
+(alarm-tickless) Within an iteration, all threads should wake up on the same tick.
+(alarm-tickless) iteration 0, thread 0: woke up after 10 ticks
+(alarm-tickless) iteration 0, thread 1: woke up 0 ticks later
+(alarm-tickless) iteration 0, thread 2: woke up 0 ticks later
+(alarm-tickless) iteration 1, thread 0: woke up 10 ticks later
+(alarm-tickless) iteration 1, thread 1: woke up 0 ticks later
+(alarm-tickless) iteration 1, thread 2: woke up 0 ticks later
+(alarm-tickless) iteration 2, thread 0: woke up 10 ticks later
+(alarm-tickless) iteration 2, thread 1: woke up 0 ticks later
+(alarm-tickless) iteration 2, thread 2: woke up 0 ticks later
+(alarm-tickless) iteration 3, thread 0: woke up 10 ticks later
+(alarm-tickless) iteration 3, thread 1: woke up 0 ticks later
+(alarm-tickless) iteration 3, thread 2: woke up 0 ticks later
+(alarm-tickless) iteration 4, thread 0: woke up 10 ticks later
+(alarm-tickless) iteration 4, thread 1: woke up 0 ticks later
+(alarm-tickless) iteration 4, thread 2: woke up 0 ticks later
+(alarm-tickless) end
+EOF
+pass;
@@ -0,0 +1,76 @@
+/** Microbenchmark for thread_create() and thread_exit().
+
+   For each of several batch sizes N, repeatedly creates N
+   threads that exit as soon as they run, waits for all of them
+   to finish, and reports the average number of CPU cycles (as
+   counted by the TSC) per thread, from creation to exit.  The
+   creating thread runs above the new threads, so each batch is
+   created before any of it runs.
+
+   Only reports numbers, so it passes as long as every round
+   completes. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/clock.h"
+
+static thread_func quick_thread;
+
+/** Batch sizes to measure. */
+static const int batch_sizes[] = {1, 8, 32};
+#define ROUND_CNT (sizeof batch_sizes / sizeof *batch_sizes)
+#define THREAD_CNT 1024         /**< Threads to create per round. */
+
+static int running_cnt;                 /**< Threads of the batch still running. */
+static struct semaphore done;           /**< Upped by the last thread of a batch. */
+
+void
+test_create_bench (void) 
+{
+  size_t round;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Keep the creating thread above the threads it creates. */
+  thread_set_priority (PRI_DEFAULT + 1);
+
+  sema_init (&done, 0);
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      int batch = batch_sizes[round];
+      uint64_t start, cycles;
+      int created, i;
+
+      start = clock_cycles ();
+      for (created = 0; created < THREAD_CNT; created += batch) 
+        {
+          running_cnt = batch;
+          for (i = 0; i < batch; i++) 
+            if (thread_create ("quick", PRI_DEFAULT, quick_thread, NULL)
+                == TID_ERROR)
+              fail ("could not create thread %d", created + i);
+          sema_down (&done);
+        }
+      cycles = clock_cycles () - start;
+
+      msg ("batches of %d: %"PRIu64" cycles per thread created and exited",
+           batch, cycles / THREAD_CNT);
+    }
+
+  thread_set_priority (PRI_DEFAULT);
+}
+
+static void
+quick_thread (void *aux UNUSED) 
+{
+  enum intr_level old_level = intr_disable ();
+  if (--running_cnt == 0)
+    sema_up (&done);
+  intr_set_level (old_level);
+}
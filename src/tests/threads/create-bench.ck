@@ -0,0 +1,22 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (create-bench) batches of 1: 21520 cycles per thread created and exited
+# (create-bench) batches of 8: 18535 cycles per thread created and exited
+# (create-bench) batches of 32: 18541 cycles per thread created and exited
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/batches of \d+: \d+ cycles per thread/, @output);
+fail "3 rounds expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 3;
+
+pass;
@@ -0,0 +1,157 @@
+/** Checks that deadline threads meet their deadlines under a
+   CPU-bound background load.
+
+   Two periodic deadline threads each do a job of a fixed number
+   of ticks every period and count the jobs that finish after
+   their deadline.  A third deadline thread never stops running,
+   so it is throttled every period, and two ordinary threads at
+   the highest priority spin in the background the whole time.
+   Together the deadline threads ask for 75% of the CPU, so a
+   further request for 30% must be rejected.  None of the jobs
+   should miss its deadline, and the background threads should
+   still get the CPU that is left over. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/** A periodic deadline thread. */
+struct periodic
+  {
+    const char *name;
+    int64_t runtime, deadline, period;  /**< Parameters, in ticks. */
+    int work;                           /**< Ticks of work per job. */
+    int job_cnt;                        /**< Jobs to do. */
+    int miss_cnt;                       /**< Jobs done late. */
+  };
+
+static struct periodic periodics[] =
+  {
+    {"edf a", 3, 10, 10, 2, 50, 0},
+    {"edf b", 5, 15, 20, 4, 25, 0},
+  };
+#define PERIODIC_CNT (sizeof periodics / sizeof *periodics)
+#define BACKGROUND_CNT 2
+
+static struct semaphore admitted;       /**< Upped once per admission. */
+static struct semaphore done;           /**< Upped by each thread as it ends. */
+static volatile bool stop;              /**< Tells the others to finish. */
+static volatile int background_ticks;   /**< Ticks seen by background threads. */
+
+static thread_func periodic_thread;
+static thread_func hog_thread;
+static thread_func background_thread;
+
+void
+test_edf_miss (void) 
+{
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&admitted, 0);
+  sema_init (&done, 0);
+
+  msg ("Admitting periodic threads (3, 10, 10) and (5, 15, 20).");
+  for (i = 0; i < PERIODIC_CNT; i++)
+    thread_create (periodics[i].name, PRI_DEFAULT, periodic_thread,
+                   &periodics[i]);
+  msg ("Admitting an overrunning thread (2, 10, 10).");
+  thread_create ("edf hog", PRI_DEFAULT, hog_thread, NULL);
+  for (i = 0; i < PERIODIC_CNT + 1; i++)
+    sema_down (&admitted);
+
+  /* Share the CPU with the background threads, so as to be able
+     to stop them. */
+  thread_set_priority (PRI_MAX);
+  msg ("Starting %d CPU-bound background threads.", BACKGROUND_CNT);
+  for (i = 0; i < BACKGROUND_CNT; i++)
+    thread_create ("background", PRI_MAX, background_thread, NULL);
+
+  if (thread_set_deadline (6, 20, 20))
+    fail ("admitted a thread past 100%% utilisation");
+  msg ("Thread asking for (6, 20, 20) was rejected.");
+
+  for (i = 0; i < PERIODIC_CNT; i++)
+    sema_down (&done);
+  stop = true;
+  for (i = 0; i < BACKGROUND_CNT + 1; i++)
+    sema_down (&done);
+
+  for (i = 0; i < PERIODIC_CNT; i++)
+    msg ("%s: %d jobs, %d deadline misses.", periodics[i].name,
+         periodics[i].job_cnt, periodics[i].miss_cnt);
+  if (background_ticks == 0)
+    fail ("background threads did not run");
+  msg ("Background threads ran.");
+  thread_set_priority (PRI_DEFAULT);
+}
+
+/** Does P_'s jobs, one per period. */
+static void
+periodic_thread (void *p_) 
+{
+  struct periodic *p = p_;
+  int i;
+
+  if (!thread_set_deadline (p->runtime, p->deadline, p->period))
+    fail ("%s was not admitted", p->name);
+  sema_up (&admitted);
+
+  for (i = 0; i < p->job_cnt; i++)
+    {
+      int64_t deadline = thread_get_deadline ();
+      int64_t last = timer_ticks ();
+      int work = 0;
+
+      while (work < p->work)
+        {
+          int64_t now = timer_ticks ();
+          if (now != last)
+            work++;
+          last = now;
+        }
+      if (timer_ticks () > deadline)
+        p->miss_cnt++;
+      thread_deadline_yield ();
+    }
+  sema_up (&done);
+}
+
+/** Spins as a deadline thread that always overruns. */
+static void
+hog_thread (void *aux UNUSED) 
+{
+  if (!thread_set_deadline (2, 10, 10))
+    fail ("hog was not admitted");
+  sema_up (&admitted);
+
+  while (!stop)
+    continue;
+  sema_up (&done);
+}
+
+/** Spins as an ordinary thread. */
+static void
+background_thread (void *aux UNUSED) 
+{
+  int64_t last = timer_ticks ();
+
+  while (!stop)
+    {
+      int64_t now = timer_ticks ();
+      if (now != last)
+        {
+          enum intr_level old_level = intr_disable ();
+          background_ticks++;
+          intr_set_level (old_level);
+        }
+      last = now;
+    }
+  sema_up (&done);
+}
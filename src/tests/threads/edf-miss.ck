@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-miss) begin
+(edf-miss) Admitting periodic threads (3, 10, 10) and (5, 15, 20).
+(edf-miss) Admitting an overrunning thread (2, 10, 10).
+(edf-miss) Starting 2 CPU-bound background threads.
+(edf-miss) Thread asking for (6, 20, 20) was rejected.
+(edf-miss) edf a: 50 jobs, 0 deadline misses.
+(edf-miss) edf b: 25 jobs, 0 deadline misses.
+(edf-miss) Background threads ran.
+(edf-miss) end
+EOF
+pass;
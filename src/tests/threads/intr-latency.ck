@@ -0,0 +1,23 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (intr-latency) Arming 2000 timeouts for the same tick.
+# (intr-latency) 2000 timeouts ran over 5321000 cycles.
+# (intr-latency) Interrupts were off for at most 14200 cycles at a time.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "missing timeout span\n"
+  if !grep (/2000 timeouts ran over \d+ cycles\./, @output);
+fail "missing interrupt-off time\n"
+  if !grep (/Interrupts were off for at most \d+ cycles at a time\./, @output);
+
+pass;
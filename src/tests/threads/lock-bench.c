@@ -0,0 +1,114 @@
+/** Microbenchmark for lock_acquire() and lock_release() under
+   contention.
+
+   For each of several configurations, creates N threads at four
+   different priorities that each take the same D locks in order,
+   yield while holding all of them so that the others pile up
+   behind the first one and donate their priorities, and then
+   release them in reverse order.  Lets them run for one second
+   and reports the average number of CPU cycles (as counted by
+   the TSC) per acquire/release pair, including the context
+   switches the contention causes.  With donation that allocates
+   or rescans the holder's locks the figure climbs with N and D.
+
+   Only reports numbers, so it passes as long as every round
+   completes. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/clock.h"
+#include "devices/timer.h"
+
+static thread_func contender;
+
+/** Number of threads and of nested locks in each round. */
+static const struct
+  {
+    int thread_cnt;
+    int depth;
+  }
+rounds[] = {{1, 1}, {8, 1}, {64, 1}, {8, 8}, {64, 8}};
+#define ROUND_CNT (sizeof rounds / sizeof *rounds)
+
+#define DEPTH_MAX 8
+
+static struct lock locks[DEPTH_MAX];    /**< Locks contended for. */
+static int depth;                       /**< Locks taken this round. */
+static volatile bool stop;              /**< Tells contenders to finish. */
+static volatile int64_t pair_cnt;       /**< Acquire/release pairs this round. */
+static int running_cnt;                 /**< Contenders still running. */
+static struct semaphore done;           /**< Upped by the last contender. */
+
+void
+test_lock_bench (void)
+{
+  size_t round;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Keep the measuring thread above every contender. */
+  thread_set_priority (PRI_DEFAULT + 1);
+
+  for (i = 0; i < DEPTH_MAX; i++)
+    lock_init (&locks[i]);
+  sema_init (&done, 0);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      int thread_cnt = rounds[round].thread_cnt;
+      uint64_t start, cycles;
+      int64_t pairs;
+
+      depth = rounds[round].depth;
+      stop = false;
+      running_cnt = thread_cnt;
+      for (i = 0; i < thread_cnt; i++)
+        if (thread_create ("contender", PRI_DEFAULT - i % 4, contender, NULL)
+            == TID_ERROR)
+          fail ("could not create thread %d of %d", i, thread_cnt);
+
+      /* Measure for one second. */
+      pair_cnt = 0;
+      start = clock_cycles ();
+      timer_sleep (TIMER_FREQ);
+      stop = true;
+      cycles = clock_cycles () - start;
+      pairs = pair_cnt;
+      sema_down (&done);
+
+      if (pairs == 0)
+        fail ("no locks taken by %d threads", thread_cnt);
+      msg ("%d threads, %d locks deep: %"PRIu64" cycles per acquire/release",
+           thread_cnt, depth, cycles / (uint64_t) pairs);
+    }
+
+  thread_set_priority (PRI_DEFAULT);
+}
+
+static void
+contender (void *aux UNUSED)
+{
+  enum intr_level old_level;
+  int i;
+
+  while (!stop)
+    {
+      for (i = 0; i < depth; i++)
+        lock_acquire (&locks[i]);
+      thread_yield ();
+      for (i = depth - 1; i >= 0; i--)
+        lock_release (&locks[i]);
+      pair_cnt += depth;
+    }
+
+  old_level = intr_disable ();
+  if (--running_cnt == 0)
+    sema_up (&done);
+  intr_set_level (old_level);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (lock-bench) 1 threads, 1 locks deep: 2130 cycles per acquire/release
+# (lock-bench) 8 threads, 1 locks deep: 4410 cycles per acquire/release
+# (lock-bench) 64 threads, 1 locks deep: 4455 cycles per acquire/release
+# (lock-bench) 8 threads, 8 locks deep: 1260 cycles per acquire/release
+# (lock-bench) 64 threads, 8 locks deep: 1285 cycles per acquire/release
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/\d+ threads, \d+ locks deep: \d+ cycles per acquire\/release/, @output);
+fail "5 rounds expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 5;
+
+pass;
@@ -0,0 +1,73 @@
+/** Microbenchmark for palloc_get_multiple() and
+   palloc_free_multiple().
+
+   Keeps a working set of up to SLOT_CNT allocations from the
+   kernel pool, three quarters of them single pages and the rest
+   runs of 2 to 8 pages, and repeatedly frees a random one and
+   allocates a new one in its place.  Reports the average number
+   of CPU cycles (as counted by the TSC) per allocate/free pair,
+   and then, with the working set still allocated, how many pages
+   are free and how large the largest free block is, which shows
+   how badly the mix has fragmented the pool.
+
+   Only reports numbers, so it passes as long as every allocation
+   succeeds. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <random.h>
+#include "devices/clock.h"
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+
+#define SLOT_CNT 32             /**< Allocations kept live at once. */
+#define ROUND_CNT 20000         /**< Allocate/free pairs to time. */
+
+/** A live allocation. */
+static struct
+  {
+    void *pages;
+    size_t page_cnt;
+  }
+slots[SLOT_CNT];
+
+/** Fills slot I with a new allocation of random size. */
+static void
+fill_slot (int i)
+{
+  size_t page_cnt = random_ulong () % 4 != 0 ? 1 : 2 + random_ulong () % 7;
+
+  slots[i].pages = palloc_get_multiple (0, page_cnt);
+  if (slots[i].pages == NULL)
+    fail ("could not allocate %zu pages", page_cnt);
+  slots[i].page_cnt = page_cnt;
+}
+
+void
+test_palloc_bench (void)
+{
+  size_t free_cnt, largest_free;
+  uint64_t start, cycles;
+  int i;
+
+  random_init (0);
+  for (i = 0; i < SLOT_CNT; i++)
+    fill_slot (i);
+
+  start = clock_cycles ();
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      int slot = random_ulong () % SLOT_CNT;
+      palloc_free_multiple (slots[slot].pages, slots[slot].page_cnt);
+      fill_slot (slot);
+    }
+  cycles = clock_cycles () - start;
+  msg ("%"PRIu64" cycles per allocate/free", cycles / ROUND_CNT);
+
+  palloc_pool_stats (0, &free_cnt, &largest_free);
+  msg ("%zu pages free, largest free block %zu pages",
+       free_cnt, largest_free);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    palloc_free_multiple (slots[i].pages, slots[i].page_cnt);
+}
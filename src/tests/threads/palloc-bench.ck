@@ -0,0 +1,22 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (palloc-bench) 412 cycles per allocate/free
+# (palloc-bench) 1795 pages free, largest free block 1024 pages
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "allocate/free timing missing\n"
+  if !grep (/\d+ cycles per allocate\/free/, @output);
+fail "fragmentation report missing\n"
+  if !grep (/\d+ pages free, largest free block \d+ pages/, @output);
+
+pass;
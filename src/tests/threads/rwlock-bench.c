@@ -0,0 +1,126 @@
+/** Compares the throughput of a lock and a readers-writer lock
+   protecting read-mostly data.
+
+   For each of several thread counts N, creates N threads that
+   each loop taking the lock, yielding the CPU once while holding
+   it, as a critical section that blocks would, and releasing it.
+   Nine accesses in ten are reads and one is a write.  Runs once
+   with an ordinary lock, which serializes every access, and once
+   with a readers-writer lock taken shared for the reads, for one
+   second each, and reports the number of accesses completed.
+
+   Only reports numbers, so it passes as long as every round
+   completes. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func accessor;
+
+/** Numbers of threads to measure. */
+static const int thread_cnts[] = {4, 16, 64};
+#define ROUND_CNT (sizeof thread_cnts / sizeof *thread_cnts)
+
+static struct lock lock;                /**< Used when !use_rwlock. */
+static struct rwlock rwlock;            /**< Used when use_rwlock. */
+static bool use_rwlock;                 /**< Which one this round uses. */
+static volatile bool stop;              /**< Tells accessors to finish. */
+static volatile int64_t access_cnt;     /**< Accesses done this round. */
+static int running_cnt;                 /**< Accessors still running. */
+static struct semaphore done;           /**< Upped by the last accessor. */
+
+static int64_t run_round (int thread_cnt);
+
+void
+test_rwlock_bench (void)
+{
+  size_t round;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Keep the measuring thread above the accessors. */
+  thread_set_priority (PRI_DEFAULT + 1);
+
+  lock_init (&lock);
+  rwlock_init (&rwlock);
+  sema_init (&done, 0);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      int thread_cnt = thread_cnts[round];
+
+      use_rwlock = false;
+      msg ("%d threads, lock: %"PRId64" accesses per second",
+           thread_cnt, run_round (thread_cnt));
+      use_rwlock = true;
+      msg ("%d threads, rwlock: %"PRId64" accesses per second",
+           thread_cnt, run_round (thread_cnt));
+    }
+
+  thread_set_priority (PRI_DEFAULT);
+}
+
+/** Runs THREAD_CNT accessors for one second and returns the
+   number of accesses they completed. */
+static int64_t
+run_round (int thread_cnt)
+{
+  int64_t accesses;
+  int i;
+
+  stop = false;
+  running_cnt = thread_cnt;
+  access_cnt = 0;
+  for (i = 0; i < thread_cnt; i++)
+    if (thread_create ("accessor", PRI_DEFAULT, accessor, NULL) == TID_ERROR)
+      fail ("could not create thread %d of %d", i, thread_cnt);
+
+  timer_sleep (TIMER_FREQ);
+  stop = true;
+  accesses = access_cnt;
+  sema_down (&done);
+
+  if (accesses == 0)
+    fail ("no accesses by %d threads", thread_cnt);
+  return accesses;
+}
+
+static void
+accessor (void *aux UNUSED)
+{
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; !stop; i++)
+    {
+      bool write = i % 10 == 0;
+
+      if (!use_rwlock)
+        lock_acquire (&lock);
+      else if (write)
+        rwlock_acquire_write (&rwlock);
+      else
+        rwlock_acquire_read (&rwlock);
+
+      thread_yield ();
+
+      if (!use_rwlock)
+        lock_release (&lock);
+      else if (write)
+        rwlock_release_write (&rwlock);
+      else
+        rwlock_release_read (&rwlock);
+      access_cnt++;
+    }
+
+  old_level = intr_disable ();
+  if (--running_cnt == 0)
+    sema_up (&done);
+  intr_set_level (old_level);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (rwlock-bench) 4 threads, lock: 41000 accesses per second
+# (rwlock-bench) 4 threads, rwlock: 97000 accesses per second
+# (rwlock-bench) 16 threads, lock: 40500 accesses per second
+# (rwlock-bench) 16 threads, rwlock: 98500 accesses per second
+# (rwlock-bench) 64 threads, lock: 39800 accesses per second
+# (rwlock-bench) 64 threads, rwlock: 96000 accesses per second
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/\d+ threads, (rw)?lock: \d+ accesses per second/, @output);
+fail "6 rounds expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 6;
+
+pass;
@@ -0,0 +1,61 @@
+/** The main thread and a higher-priority reader both hold a
+   readers-writer lock shared when an even higher-priority writer
+   blocks on it.  The writer's priority must be donated to both
+   readers, and taken back from each as it releases the lock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_func;
+static thread_func writer_func;
+
+static struct rwlock rw;
+static struct semaphore go;
+
+void
+test_rwlock_donate (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  sema_init (&go, 0);
+
+  rwlock_acquire_read (&rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_func, NULL);
+  thread_create ("writer", PRI_DEFAULT + 5, writer_func, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+
+  sema_up (&go);
+  rwlock_release_read (&rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+reader_func (void *aux UNUSED)
+{
+  rwlock_acquire_read (&rw);
+  msg ("Reader acquired rw shared.");
+  sema_down (&go);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  rwlock_release_read (&rw);
+  msg ("Reader finished.");
+}
+
+static void
+writer_func (void *aux UNUSED)
+{
+  rwlock_acquire_write (&rw);
+  msg ("Writer acquired rw exclusively.");
+  rwlock_release_write (&rw);
+  msg ("Writer finished.");
+}
@@ -0,0 +1,57 @@
+/** Checks that readers and writers take turns.
+
+   While the main thread holds a readers-writer lock shared, a
+   writer W1 blocks on it, then a reader R1 arrives.  R1 must wait
+   behind the waiting writer even though the lock is only held
+   shared.  Then writer W2 and reader R2 arrive too, each at a
+   higher priority than the threads before.  When the main thread
+   lets go, the higher-priority writer, W2, goes first, and after
+   it both waiting readers are let in together, ahead of W1,
+   which goes last. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_func;
+static thread_func writer_func;
+
+static struct rwlock rw;
+
+void
+test_rwlock_fair (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  thread_create ("W1", PRI_DEFAULT + 2, writer_func, NULL);
+  thread_create ("R1", PRI_DEFAULT + 3, reader_func, NULL);
+  thread_create ("W2", PRI_DEFAULT + 4, writer_func, NULL);
+  thread_create ("R2", PRI_DEFAULT + 5, reader_func, NULL);
+  msg ("Main thread releasing rw.");
+  rwlock_release_read (&rw);
+  msg ("Main thread finished.");
+}
+
+static void
+reader_func (void *aux UNUSED)
+{
+  rwlock_acquire_read (&rw);
+  msg ("%s reading, %d readers.", thread_name (), rw.reader_cnt);
+  rwlock_release_read (&rw);
+}
+
+static void
+writer_func (void *aux UNUSED)
+{
+  rwlock_acquire_write (&rw);
+  msg ("%s writing.", thread_name ());
+  rwlock_release_write (&rw);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-fair) begin
+(rwlock-fair) Main thread releasing rw.
+(rwlock-fair) W2 writing.
+(rwlock-fair) R2 reading, 2 readers.
+(rwlock-fair) R1 reading, 1 readers.
+(rwlock-fair) W1 writing.
+(rwlock-fair) Main thread finished.
+(rwlock-fair) end
+EOF
+pass;
@@ -0,0 +1,76 @@
+/** Exercises rwlock_try_acquire_write(), rwlock_downgrade() and
+   rwlock_upgrade().
+
+   Downgrading must let in a reader that was waiting.  Upgrading
+   as the only reader must not wait.  Upgrading while another
+   thread reads must wait for it, donating priority to it
+   meanwhile, and a second thread trying to upgrade at the same
+   time must be refused rather than deadlock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_func;
+static thread_func upgrader_func;
+
+static struct rwlock rw;
+static struct semaphore acquired;
+
+void
+test_rwlock_upgrade (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  sema_init (&acquired, 0);
+
+  if (!rwlock_try_acquire_write (&rw))
+    fail ("rwlock_try_acquire_write() failed on a free lock");
+  msg ("Acquired rw exclusively without waiting.");
+  thread_create ("R", PRI_DEFAULT + 1, reader_func, NULL);
+  rwlock_downgrade (&rw);
+  msg ("Downgraded rw to shared.");
+
+  if (!rwlock_upgrade (&rw) || !rwlock_held_for_write (&rw))
+    fail ("sole reader could not upgrade");
+  msg ("Upgraded rw without waiting.");
+  rwlock_release_write (&rw);
+
+  rwlock_acquire_read (&rw);
+  thread_create ("R2", PRI_DEFAULT - 1, upgrader_func, NULL);
+  sema_down (&acquired);
+  if (!rwlock_upgrade (&rw) || !rwlock_held_for_write (&rw))
+    fail ("upgrade failed");
+  msg ("Main thread upgraded rw after waiting.  Readers left: %d.",
+       rw.reader_cnt);
+  rwlock_release_write (&rw);
+}
+
+static void
+reader_func (void *aux UNUSED)
+{
+  rwlock_acquire_read (&rw);
+  msg ("%s reading, %d readers.", thread_name (), rw.reader_cnt);
+  rwlock_release_read (&rw);
+}
+
+static void
+upgrader_func (void *aux UNUSED)
+{
+  rwlock_acquire_read (&rw);
+  sema_up (&acquired);
+  msg ("%s should have priority %d.  Actual priority: %d.",
+       thread_name (), PRI_DEFAULT, thread_get_priority ());
+  if (rwlock_upgrade (&rw))
+    fail ("two readers upgraded at once");
+  msg ("%s could not upgrade while main thread was upgrading.",
+       thread_name ());
+  rwlock_release_read (&rw);
+}
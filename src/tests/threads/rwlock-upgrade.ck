@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-upgrade) begin
+(rwlock-upgrade) Acquired rw exclusively without waiting.
+(rwlock-upgrade) R reading, 2 readers.
+(rwlock-upgrade) Downgraded rw to shared.
+(rwlock-upgrade) Upgraded rw without waiting.
+(rwlock-upgrade) R2 should have priority 31.  Actual priority: 31.
+(rwlock-upgrade) R2 could not upgrade while main thread was upgrading.
+(rwlock-upgrade) Main thread upgraded rw after waiting.  Readers left: 0.
+(rwlock-upgrade) end
+EOF
+pass;
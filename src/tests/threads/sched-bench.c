@@ -0,0 +1,107 @@
+/** Microbenchmark for the scheduler's run queue.
+
+   For each of several ready-thread counts N, creates N threads
+   at the same priority that do nothing but call thread_yield()
+   in a loop, lets them run for one second, and reports the
+   average number of CPU cycles (as counted by the TSC) spent per
+   yield, that is, per trip through schedule().  With a run queue
+   whose cost grows with the number of ready threads the figure
+   climbs with N; with a constant-time run queue it stays flat.
+
+   sched-bench runs under the priority scheduler and
+   sched-bench-mlfqs under the 4.4BSD scheduler.  Both only report
+   numbers, so they pass as long as every round completes. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/clock.h"
+#include "devices/timer.h"
+
+static thread_func yield_thread;
+static void sched_bench (void);
+
+/** Numbers of ready threads to measure. */
+static const int thread_cnts[] = {1, 8, 32, 128, 256};
+#define ROUND_CNT (sizeof thread_cnts / sizeof *thread_cnts)
+
+static volatile bool stop;              /**< Tells yielders to finish. */
+static volatile int64_t yield_cnt;      /**< Yields done this round. */
+static int running_cnt;                 /**< Yielders still running. */
+static struct semaphore done;           /**< Upped by the last yielder. */
+
+void
+test_sched_bench (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Keep the creating thread above the yielders. */
+  thread_set_priority (PRI_DEFAULT + 1);
+  sched_bench ();
+  thread_set_priority (PRI_DEFAULT);
+}
+
+void
+test_sched_bench_mlfqs (void) 
+{
+  ASSERT (thread_mlfqs);
+  sched_bench ();
+}
+
+static void
+sched_bench (void) 
+{
+  size_t round;
+
+  sema_init (&done, 0);
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      int thread_cnt = thread_cnts[round];
+      uint64_t start, cycles;
+      int64_t yields;
+      int i;
+
+      stop = false;
+      running_cnt = thread_cnt;
+      for (i = 0; i < thread_cnt; i++) 
+        if (thread_create ("yielder", PRI_DEFAULT, yield_thread, NULL)
+            == TID_ERROR)
+          fail ("could not create thread %d of %d", i, thread_cnt);
+
+      /* Measure for one second. */
+      yield_cnt = 0;
+      start = clock_cycles ();
+      timer_sleep (TIMER_FREQ);
+      stop = true;
+      cycles = clock_cycles () - start;
+      yields = yield_cnt;
+      sema_down (&done);
+
+      if (yields == 0)
+        fail ("no yields with %d ready threads", thread_cnt);
+      msg ("%d ready threads: %"PRIu64" cycles per schedule",
+           thread_cnt, cycles / (uint64_t) yields);
+    }
+}
+
+static void
+yield_thread (void *aux UNUSED) 
+{
+  enum intr_level old_level;
+
+  while (!stop) 
+    {
+      thread_yield ();
+      yield_cnt++;
+    }
+
+  old_level = intr_disable ();
+  if (--running_cnt == 0)
+    sema_up (&done);
+  intr_set_level (old_level);
+}
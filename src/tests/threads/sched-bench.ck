@@ -0,0 +1,24 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (sched-bench) 1 ready threads: 1520 cycles per schedule
+# (sched-bench) 8 ready threads: 1535 cycles per schedule
+# (sched-bench) 32 ready threads: 1541 cycles per schedule
+# (sched-bench) 128 ready threads: 1560 cycles per schedule
+# (sched-bench) 256 ready threads: 1574 cycles per schedule
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/\d+ ready threads: \d+ cycles per schedule/, @output);
+fail "5 rounds expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 5;
+
+pass;
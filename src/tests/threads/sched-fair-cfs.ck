@@ -0,0 +1,35 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (sched-fair-cfs) Thread 0 (nice 0) received 411 ticks, 41.1% of the CPU.
+# (sched-fair-cfs) Thread 1 (nice 0) received 411 ticks, 41.1% of the CPU.
+# (sched-fair-cfs) Thread 2 (nice 5) received 134 ticks, 13.4% of the CPU.
+# (sched-fair-cfs) Thread 3 (nice 10) received 44 ticks, 4.4% of the CPU.
+#
+# The shares should follow the threads' weights: the two nice 0
+# threads even, and each nicer thread well behind.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@share);
+foreach (@output) {
+    push (@share, $1 + $2 / 10)
+      if /Thread \d+ \(nice -?\d+\) received \d+ ticks, (\d+)\.(\d)% of/;
+}
+fail "4 threads expected but " . scalar (@share) . " found\n"
+  if @share != 4;
+fail "nice 0 threads got $share[0]% and $share[1]% of the CPU\n"
+  if abs ($share[0] - $share[1]) > 10;
+fail "nice 5 thread got $share[2]% of the CPU, more than a nice 0 thread\n"
+  if $share[2] >= $share[0] || $share[2] >= $share[1];
+fail "nice 10 thread got $share[3]% of the CPU, more than the nice 5 thread\n"
+  if $share[3] >= $share[2];
+pass;
@@ -0,0 +1,23 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (sched-fair-mlfqs) Thread 0 (nice 0) received 250 ticks, 25.0% of the CPU.
+# (sched-fair-mlfqs) Thread 1 (nice 0) received 250 ticks, 25.0% of the CPU.
+# (sched-fair-mlfqs) Thread 2 (nice 5) received 250 ticks, 25.0% of the CPU.
+# (sched-fair-mlfqs) Thread 3 (nice 10) received 250 ticks, 25.0% of the CPU.
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@threads) = grep (/Thread \d+ \(nice -?\d+\) received \d+ ticks/, @output);
+fail "4 threads expected but " . scalar (@threads) . " found\n"
+  if @threads != 4;
+
+pass;
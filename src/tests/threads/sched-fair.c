@@ -0,0 +1,120 @@
+/** Fairness benchmark for the schedulers.
+
+   Starts four CPU-bound threads with nice values 0, 0, 5, and
+   10, lets them spin for 10 seconds, and reports how many timer
+   ticks each one saw while running and what share of the total
+   that is.  The priority scheduler has no notion of nice, so
+   under it the threads just run round-robin.  The completely
+   fair scheduler should give them about 41%, 41%, 13%, and 4%,
+   in proportion to their weights of 1024, 1024, 335, and 110.
+
+   sched-fair runs under the priority scheduler, sched-fair-mlfqs
+   under the 4.4BSD scheduler, and sched-fair-cfs under the
+   completely fair scheduler.  Only the last one checks the
+   shares, loosely; the others just report them. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void sched_fair (void);
+
+void
+test_sched_fair (void) 
+{
+  ASSERT (!thread_mlfqs && !thread_cfs);
+  sched_fair ();
+}
+
+void
+test_sched_fair_mlfqs (void) 
+{
+  ASSERT (thread_mlfqs);
+  thread_set_nice (-20);
+  sched_fair ();
+}
+
+void
+test_sched_fair_cfs (void) 
+{
+  ASSERT (thread_cfs);
+  sched_fair ();
+}
+
+#define THREAD_CNT 4
+#define START_DELAY 1           /**< Seconds before threads start spinning. */
+#define SPIN_TIME 10            /**< Seconds the threads spin for. */
+
+static const int nices[THREAD_CNT] = {0, 0, 5, 10};
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+    int nice;
+  };
+
+static thread_func load_thread;
+
+static void
+sched_fair (void) 
+{
+  struct thread_info info[THREAD_CNT];
+  int64_t start_time;
+  int total;
+  int i;
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tick_count = 0;
+      ti->nice = nices[i];
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+
+  msg ("Sleeping %d seconds to let threads run, please wait...",
+       START_DELAY + SPIN_TIME + 1);
+  timer_sleep ((START_DELAY + SPIN_TIME + 1) * TIMER_FREQ);
+
+  total = 0;
+  for (i = 0; i < THREAD_CNT; i++)
+    total += info[i].tick_count;
+  if (total == 0)
+    fail ("threads received no ticks");
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      int permille = info[i].tick_count * 1000 / total;
+      msg ("Thread %d (nice %d) received %d ticks, %d.%d%% of the CPU.",
+           i, info[i].nice, info[i].tick_count, permille / 10, permille % 10);
+    }
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = START_DELAY * TIMER_FREQ;
+  int64_t spin_time = sleep_time + SPIN_TIME * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  if (thread_mlfqs || thread_cfs)
+    thread_set_nice (ti->nice);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
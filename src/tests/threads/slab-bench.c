@@ -0,0 +1,98 @@
+/** Compares object caches against malloc().
+
+   For each of several object sizes, allocates OBJ_CNT objects
+   from a new kmem_cache and then frees them all, ROUND_CNT times
+   over, and does the same with malloc() and free().  Reports the
+   average number of CPU cycles (as counted by the TSC) per
+   allocate/free pair with each, and how many kernel pool pages
+   OBJ_CNT live objects took with each.
+
+   Only reports numbers, so it passes as long as every allocation
+   succeeds. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "devices/clock.h"
+
+/** Object sizes to measure. */
+static const size_t obj_sizes[] = {20, 48, 100, 536};
+#define SIZE_CNT (sizeof obj_sizes / sizeof *obj_sizes)
+
+#define OBJ_CNT 256             /**< Objects live at once. */
+#define ROUND_CNT 64            /**< Times to allocate and free them. */
+
+static struct kmem_cache caches[SIZE_CNT];
+static void *objs[OBJ_CNT];
+
+/** Returns the number of free pages in the kernel pool. */
+static size_t
+kernel_free_pages (void)
+{
+  size_t free_cnt, largest_free;
+
+  palloc_pool_stats (0, &free_cnt, &largest_free);
+  return free_cnt;
+}
+
+/** Allocates OBJ_CNT objects of SIZE bytes, from CACHE if it is
+   nonnull or with malloc() otherwise, and then frees them,
+   ROUND_CNT times.  Returns the average cycles per
+   allocate/free pair and stores into *PAGES the number of pages
+   the live objects took in the first round. */
+static uint64_t
+measure (struct kmem_cache *cache, size_t size, size_t *pages)
+{
+  uint64_t start, cycles = 0;
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      size_t before = kernel_free_pages ();
+
+      start = clock_cycles ();
+      for (i = 0; i < OBJ_CNT; i++)
+        {
+          objs[i] = cache != NULL ? kmem_cache_alloc (cache) : malloc (size);
+          if (objs[i] == NULL)
+            fail ("could not allocate %zu-byte object %d", size, i);
+        }
+      cycles += clock_cycles () - start;
+
+      if (round == 0)
+        *pages = before - kernel_free_pages ();
+
+      start = clock_cycles ();
+      for (i = 0; i < OBJ_CNT; i++)
+        if (cache != NULL)
+          kmem_cache_free (cache, objs[i]);
+        else
+          free (objs[i]);
+      cycles += clock_cycles () - start;
+    }
+  return cycles / (ROUND_CNT * OBJ_CNT);
+}
+
+void
+test_slab_bench (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE_CNT; i++)
+    {
+      size_t size = obj_sizes[i];
+      size_t cache_pages, malloc_pages;
+      uint64_t cache_cycles, malloc_cycles;
+
+      kmem_cache_init (&caches[i], "slab-bench", size, NULL);
+      cache_cycles = measure (&caches[i], size, &cache_pages);
+      malloc_cycles = measure (NULL, size, &malloc_pages);
+
+      msg ("%zu-byte objects: kmem_cache %"PRIu64" cycles, %zu pages; "
+           "malloc %"PRIu64" cycles, %zu pages",
+           size, cache_cycles, cache_pages, malloc_cycles, malloc_pages);
+    }
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (slab-bench) 20-byte objects: kmem_cache 95 cycles, 2 pages; malloc 120 cycles, 2 pages
+# (slab-bench) 48-byte objects: kmem_cache 96 cycles, 4 pages; malloc 118 cycles, 5 pages
+# (slab-bench) 100-byte objects: kmem_cache 98 cycles, 7 pages; malloc 121 cycles, 9 pages
+# (slab-bench) 536-byte objects: kmem_cache 104 cycles, 37 pages; malloc 126 cycles, 86 pages
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/\d+-byte objects: kmem_cache \d+ cycles, \d+ pages; malloc \d+ cycles, \d+ pages/, @output);
+fail "4 sizes expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 4;
+
+pass;
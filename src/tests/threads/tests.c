@@ -14,6 +14,7 @@ static const struct test tests[] =
     {"alarm-single", test_alarm_single},
     {"alarm-multiple", test_alarm_multiple},
     {"alarm-simultaneous", test_alarm_simultaneous},
+    {"alarm-tickless", test_alarm_tickless},
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
@@ -25,6 +26,15 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"timeout-stress", test_timeout_stress},
+    {"lock-bench", test_lock_bench},
+    {"rwlock-donate", test_rwlock_donate},
+    {"rwlock-fair", test_rwlock_fair},
+    {"rwlock-upgrade", test_rwlock_upgrade},
+    {"rwlock-bench", test_rwlock_bench},
+    {"workqueue", test_workqueue},
+    {"intr-latency", test_intr_latency},
+    {"edf-miss", test_edf_miss},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
@@ -38,6 +48,14 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"sched-bench", test_sched_bench},
+    {"sched-bench-mlfqs", test_sched_bench_mlfqs},
+    {"sched-fair", test_sched_fair},
+    {"sched-fair-mlfqs", test_sched_fair_mlfqs},
+    {"sched-fair-cfs", test_sched_fair_cfs},
+    {"create-bench", test_create_bench},
+    {"palloc-bench", test_palloc_bench},
+    {"slab-bench", test_slab_bench},
   };
 
 static const char *test_name;
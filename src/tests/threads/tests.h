@@ -8,6 +8,7 @@ typedef void test_func (void);
 extern test_func test_alarm_single;
 extern test_func test_alarm_multiple;
 extern test_func test_alarm_simultaneous;
+extern test_func test_alarm_tickless;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
@@ -23,6 +24,15 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_timeout_stress;
+extern test_func test_lock_bench;
+extern test_func test_rwlock_donate;
+extern test_func test_rwlock_fair;
+extern test_func test_rwlock_upgrade;
+extern test_func test_rwlock_bench;
+extern test_func test_workqueue;
+extern test_func test_intr_latency;
+extern test_func test_edf_miss;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +42,14 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_sched_bench;
+extern test_func test_sched_bench_mlfqs;
+extern test_func test_sched_fair;
+extern test_func test_sched_fair_mlfqs;
+extern test_func test_sched_fair_cfs;
+extern test_func test_create_bench;
+extern test_func test_palloc_bench;
+extern test_func test_slab_bench;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,131 @@
+/** Arms, moves, and cancels thousands of kernel timeouts at
+   random ticks, some of them further out than the timing wheel
+   spans, and verifies that exactly the ones left armed fire, each
+   on its own expiry tick. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "devices/timeout.h"
+#include "devices/timer.h"
+
+#define TIMEOUT_CNT 2000        /**< Timeouts that may fire. */
+#define FAR_CNT 500             /**< Timeouts far out, all cancelled. */
+#define CHURN_CNT 20000         /**< Arm-then-cancel iterations. */
+#define MIN_DELAY 50            /**< Shortest delay, in ticks. */
+#define MAX_DELAY 650           /**< Longest delay, in ticks. */
+
+struct stress_timeout
+  {
+    struct timeout timeout;
+    int64_t fired;              /**< Tick it fired on, or -1. */
+    bool cancelled;             /**< Cancelled by the test? */
+  };
+
+static void record_fire (void *);
+static int64_t random_delay (void);
+
+void
+test_timeout_stress (void)
+{
+  struct stress_timeout *timeouts;
+  struct timeout churn;
+  int64_t start;
+  int fired_cnt, cancelled_cnt;
+  int i;
+
+  timeouts = malloc (sizeof *timeouts * (TIMEOUT_CNT + FAR_CNT));
+  if (timeouts == NULL)
+    PANIC ("couldn't allocate timeouts");
+  random_init (0);
+
+  msg ("Arming %d timeouts %d to %d ticks out.",
+       TIMEOUT_CNT, MIN_DELAY, MAX_DELAY);
+  msg ("Arming %d more beyond the span of the wheel.", FAR_CNT);
+  start = timer_ticks ();
+  for (i = 0; i < TIMEOUT_CNT + FAR_CNT; i++)
+    {
+      struct stress_timeout *st = &timeouts[i];
+      int64_t expires = start + random_delay ();
+
+      if (i >= TIMEOUT_CNT)
+        expires += (int64_t) 1 << 30;
+      timeout_init (&st->timeout, record_fire, st);
+      st->fired = -1;
+      st->cancelled = false;
+      timeout_add (&st->timeout, expires);
+    }
+
+  msg ("Moving every 4th timeout and cancelling every 3rd and the far ones.");
+  for (i = 0; i < TIMEOUT_CNT; i += 4)
+    timeout_add (&timeouts[i].timeout, start + random_delay ());
+  for (i = 0; i < TIMEOUT_CNT + FAR_CNT; i++)
+    if (i % 3 == 0 || i >= TIMEOUT_CNT)
+      {
+        if (!timeout_cancel (&timeouts[i].timeout))
+          fail ("timeout %d was not pending when cancelled", i);
+        timeouts[i].cancelled = true;
+      }
+
+  msg ("Arming and cancelling one timeout %d times.", CHURN_CNT);
+  timeout_init (&churn, record_fire, NULL);
+  for (i = 0; i < CHURN_CNT; i++)
+    {
+      timeout_add (&churn, start + random_delay () + (i % 2) * (1 << 20));
+      if (!timeout_cancel (&churn))
+        fail ("churn timeout was not pending when cancelled");
+    }
+  if (timeout_cancel (&churn))
+    fail ("churn timeout was pending after being cancelled");
+
+  timer_sleep (MAX_DELAY + 10);
+
+  fired_cnt = cancelled_cnt = 0;
+  for (i = 0; i < TIMEOUT_CNT + FAR_CNT; i++)
+    {
+      struct stress_timeout *st = &timeouts[i];
+
+      if (timeout_pending (&st->timeout))
+        fail ("timeout %d is still pending", i);
+      if (st->cancelled)
+        {
+          if (st->fired != -1)
+            fail ("cancelled timeout %d fired on tick %"PRId64, i, st->fired);
+          cancelled_cnt++;
+        }
+      else
+        {
+          if (st->fired != st->timeout.expires)
+            fail ("timeout %d due on tick %"PRId64" fired on tick %"PRId64,
+                  i, st->timeout.expires, st->fired);
+          fired_cnt++;
+        }
+    }
+  msg ("%d timeouts fired on time, %d cancelled timeouts did not fire.",
+       fired_cnt, cancelled_cnt);
+
+  free (timeouts);
+}
+
+/** Records the tick on which timeout AUX fired. */
+static void
+record_fire (void *aux)
+{
+  struct stress_timeout *st = aux;
+
+  if (st == NULL)
+    fail ("churn timeout fired");
+  if (st->fired != -1)
+    fail ("timeout fired twice");
+  st->fired = timer_ticks ();
+}
+
+/** Returns a random delay between MIN_DELAY and MAX_DELAY
+   ticks. */
+static int64_t
+random_delay (void)
+{
+  return MIN_DELAY + random_ulong () % (MAX_DELAY - MIN_DELAY + 1);
+}
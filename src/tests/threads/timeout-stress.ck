@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timeout-stress) begin
+(timeout-stress) Arming 2000 timeouts 50 to 650 ticks out.
+(timeout-stress) Arming 500 more beyond the span of the wheel.
+(timeout-stress) Moving every 4th timeout and cancelling every 3rd and the far ones.
+(timeout-stress) Arming and cancelling one timeout 20000 times.
+(timeout-stress) 1333 timeouts fired on time, 1167 cancelled timeouts did not fire.
+(timeout-stress) end
+EOF
+pass;
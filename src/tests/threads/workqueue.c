@@ -0,0 +1,106 @@
+/** Runs work items on a low- and a high-priority work queue,
+   queued from a thread and from a timeout, and checks that they
+   run in order, at their queue's priority, that they may sleep,
+   and that a cancelled item does not run. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timeout.h"
+#include "devices/timer.h"
+
+struct test_item
+  {
+    struct work work;
+    const char *name;
+    bool sleeps;                /**< Sleep for a tick when run? */
+    bool ran;                   /**< Has it run? */
+  };
+
+static work_func run_item;
+static timeout_func queue_from_timeout;
+
+static void item_init (struct test_item *, const char *name, bool sleeps);
+
+static struct workqueue *high, *low;
+
+void
+test_workqueue (void)
+{
+  struct test_item items[3], hi, from_timeout, cancelled;
+  struct timeout timeout;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  high = workqueue_create ("wq-high", PRI_DEFAULT + 5);
+  low = workqueue_create ("wq-low", PRI_DEFAULT - 5);
+  if (high == NULL || low == NULL)
+    fail ("could not create work queues");
+
+  msg ("Queueing 3 items on the low queue.");
+  item_init (&items[0], "low item 0", true);
+  item_init (&items[1], "low item 1", true);
+  item_init (&items[2], "low item 2", true);
+  for (i = 0; i < 3; i++)
+    workqueue_add (low, &items[i].work);
+  msg ("Flushing the low queue.");
+  workqueue_flush (low);
+  msg ("Low queue flushed.");
+
+  item_init (&hi, "high item", false);
+  workqueue_add (high, &hi.work);
+  msg ("Queued on the high queue.");
+
+  item_init (&from_timeout, "item queued by a timeout", false);
+  timeout_init (&timeout, queue_from_timeout, &from_timeout);
+  timeout_add (&timeout, timer_ticks () + 2);
+  timer_sleep (5);
+  msg ("Slept.");
+
+  item_init (&cancelled, "cancelled item", false);
+  workqueue_add (low, &cancelled.work);
+  if (workqueue_add (low, &cancelled.work))
+    fail ("queued a pending item twice");
+  if (!workqueue_cancel (low, &cancelled.work))
+    fail ("pending item could not be cancelled");
+  if (workqueue_cancel (low, &cancelled.work))
+    fail ("cancelled item was still pending");
+  workqueue_flush (low);
+  if (cancelled.ran)
+    fail ("cancelled item ran");
+  msg ("Cancelled item did not run.");
+}
+
+static void
+item_init (struct test_item *item, const char *name, bool sleeps)
+{
+  work_init (&item->work, run_item, item);
+  item->name = name;
+  item->sleeps = sleeps;
+  item->ran = false;
+}
+
+/** Work function for the items above. */
+static void
+run_item (void *item_)
+{
+  struct test_item *item = item_;
+
+  if (item->sleeps)
+    timer_sleep (1);
+  item->ran = true;
+  msg ("%s ran.", item->name);
+}
+
+/** Timeout function that queues work from interrupt context. */
+static void
+queue_from_timeout (void *item)
+{
+  struct test_item *ti = item;
+
+  workqueue_add (high, &ti->work);
+}
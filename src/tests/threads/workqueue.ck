@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Queueing 3 items on the low queue.
+(workqueue) Flushing the low queue.
+(workqueue) low item 0 ran.
+(workqueue) low item 1 ran.
+(workqueue) low item 2 ran.
+(workqueue) Low queue flushed.
+(workqueue) high item ran.
+(workqueue) Queued on the high queue.
+(workqueue) item queued by a timeout ran.
+(workqueue) Slept.
+(workqueue) Cancelled item did not run.
+(workqueue) end
+EOF
+pass;
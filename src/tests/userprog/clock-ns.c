@@ -0,0 +1,33 @@
+/** Reads the monotonic clock many times in a row, checking that
+   it never goes backward, then sleeps for 50 ms in futex_wait()
+   and checks that the clock saw at least 40 ms of it go by. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static int word;
+  int64_t start, prev, now;
+  int i;
+
+  start = prev = clock_ns ();
+  CHECK (start > 0, "clock has started");
+  for (i = 0; i < 1000; i++)
+    {
+      now = clock_ns ();
+      if (now < prev)
+        fail ("clock went back from %lld to %lld ns", prev, now);
+      prev = now;
+    }
+  msg ("clock never went backward");
+
+  start = clock_ns ();
+  futex_wait (&word, 0, 50);
+  now = clock_ns ();
+  if (now - start < 40 * 1000 * 1000)
+    fail ("50 ms sleep took only %lld ns", now - start);
+  msg ("50 ms sleep took at least 40 ms");
+}
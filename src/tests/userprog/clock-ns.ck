@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clock-ns) begin
+(clock-ns) clock has started
+(clock-ns) clock never went backward
+(clock-ns) 50 ms sleep took at least 40 ms
+(clock-ns) end
+clock-ns: exit(0)
+EOF
+pass;
@@ -0,0 +1,18 @@
+/** Waits on a word at a misaligned address, then on one in
+   kernel space.  The process must be terminated with exit code
+   -1 by the first. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static int words[2];
+
+  futex_wait ((int *) ((char *) words + 1), 0, 0);
+  msg ("misaligned word accepted");
+  futex_wait ((int *) 0xc0000000, 0, 0);
+  fail ("should have exited with -1");
+}
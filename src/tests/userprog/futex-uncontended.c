@@ -0,0 +1,40 @@
+/** Takes and releases a lock, downs and ups a semaphore, and
+   signals a condition variable nobody waits on, many times over,
+   and checks that none of it entered the kernel. */
+
+#include <synch.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ITER_CNT 10000
+
+void
+test_main (void) 
+{
+  struct lock lock;
+  struct semaphore sema;
+  struct condition cond;
+  int i;
+
+  lock_init (&lock);
+  sema_init (&sema, 1);
+  cond_init (&cond);
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      lock_acquire (&lock);
+      if (lock_try_acquire (&lock))
+        fail ("acquired a held lock");
+      cond_signal (&cond, &lock);
+      cond_broadcast (&cond, &lock);
+      lock_release (&lock);
+
+      sema_down (&sema);
+      if (sema_try_down (&sema))
+        fail ("downed a semaphore at zero");
+      sema_up (&sema);
+    }
+  msg ("%d rounds of lock, semaphore, and condition operations", ITER_CNT);
+  msg ("%u system calls", synch_syscall_cnt ());
+}
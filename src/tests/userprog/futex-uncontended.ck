@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-uncontended) begin
+(futex-uncontended) 10000 rounds of lock, semaphore, and condition operations
+(futex-uncontended) 0 system calls
+(futex-uncontended) end
+futex-uncontended: exit(0)
+EOF
+pass;
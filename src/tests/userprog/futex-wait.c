@@ -0,0 +1,25 @@
+/** Checks the results of futex_wait() and futex_wake() when
+   nobody else touches the word: waiting on a value the word does
+   not hold returns at once, waiting on the value it holds runs
+   out the timeout, and waking finds nobody to wake. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static int word = 5;
+  int stack_word = 7;
+
+  CHECK (futex_wait (&word, 4, -1) == FUTEX_CHANGED,
+         "wait on a value the word does not hold");
+  CHECK (futex_wait (&word, 5, 0) == FUTEX_TIMED_OUT,
+         "wait with zero timeout");
+  CHECK (futex_wait (&word, 5, 50) == FUTEX_TIMED_OUT,
+         "wait with 50 ms timeout");
+  CHECK (futex_wait (&stack_word, 7, 20) == FUTEX_TIMED_OUT,
+         "wait on the stack with 20 ms timeout");
+  CHECK (futex_wake (&word, 1) == 0, "wake with nobody waiting");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wait) begin
+(futex-wait) wait on a value the word does not hold
+(futex-wait) wait with zero timeout
+(futex-wait) wait with 50 ms timeout
+(futex-wait) wait on the stack with 20 ms timeout
+(futex-wait) wake with nobody waiting
+(futex-wait) end
+futex-wait: exit(0)
+EOF
+pass;
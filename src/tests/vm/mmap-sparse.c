@@ -0,0 +1,49 @@
+/** Maps a large file and touches only a few of its pages, which must
+   read back the data written to them, from the last to the first,
+   with untouched pages in between. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (512 * 1024)
+#define STRIDE (64 * 1024)
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  char buf[16];
+  int handle;
+  mapid_t map;
+  size_t ofs;
+
+  CHECK (create ("sparse", FILE_SIZE), "create \"sparse\"");
+  CHECK ((handle = open ("sparse")) > 1, "open \"sparse\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += STRIDE)
+    {
+      snprintf (buf, sizeof buf, "page %zu", ofs / 4096);
+      seek (handle, ofs);
+      if (write (handle, buf, sizeof buf) != sizeof buf)
+        fail ("write at offset %zu failed", ofs);
+    }
+  CHECK ((map = mmap (handle, actual)) != MAP_FAILED, "mmap \"sparse\"");
+
+  /* Touch one page per stride, from the end back to the start. */
+  for (ofs = FILE_SIZE; ofs > 0; ofs -= STRIDE)
+    {
+      size_t page_ofs = ofs - STRIDE;
+      snprintf (buf, sizeof buf, "page %zu", page_ofs / 4096);
+      if (memcmp (actual + page_ofs, buf, sizeof buf))
+        fail ("bad data at offset %zu of mmap'd region", page_ofs);
+    }
+
+  /* The last byte of the file is mapped even though nothing wrote it. */
+  if (actual[FILE_SIZE - 1] != 0)
+    fail ("last byte of mmap'd region is not zero");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-sparse) begin
+(mmap-sparse) create "sparse"
+(mmap-sparse) open "sparse"
+(mmap-sparse) mmap "sparse"
+(mmap-sparse) end
+EOF
+pass;
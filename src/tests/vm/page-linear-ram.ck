@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-linear-ram) begin
+(page-linear-ram) initialize
+(page-linear-ram) read pass
+(page-linear-ram) read/modify/write pass one
+(page-linear-ram) read/modify/write pass two
+(page-linear-ram) read pass
+(page-linear-ram) end
+EOF
+pass;
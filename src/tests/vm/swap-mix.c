@@ -0,0 +1,68 @@
+/** Times random reads from a file, first on an idle system and
+   then while child-linear processes push pages out to swap and
+   fault them back in, and reports the average time per read for
+   each.  The file system and swap disks sit on different IDE
+   channels, so the reads should slow down far less than if they
+   queued up behind the swap traffic.
+
+   Only reports numbers, so it passes as long as every read and
+   every child succeeds. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (256 * 1024)
+#define READ_SIZE 512
+#define READ_CNT 256
+#define CHILD_CNT 2
+
+static char buf[READ_SIZE];
+
+/** Returns the average time in ns taken by READ_CNT reads of
+   READ_SIZE bytes at random sector-aligned offsets in FD. */
+static int64_t
+time_reads (int fd)
+{
+  int64_t start = clock_ns ();
+  int i;
+
+  for (i = 0; i < READ_CNT; i++)
+    {
+      size_t ofs = random_ulong () % (FILE_SIZE / READ_SIZE) * READ_SIZE;
+      seek (fd, ofs);
+      if (read (fd, buf, READ_SIZE) != READ_SIZE)
+        fail ("read %d bytes at offset %zu failed", READ_SIZE, ofs);
+    }
+  return (clock_ns () - start) / READ_CNT;
+}
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int64_t idle_ns, busy_ns;
+  size_t ofs;
+  int fd, i;
+
+  CHECK (create ("data", FILE_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += READ_SIZE)
+    if (write (fd, buf, READ_SIZE) != READ_SIZE)
+      fail ("write %d bytes at offset %zu failed", READ_SIZE, ofs);
+
+  random_init (0);
+  idle_ns = time_reads (fd);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK ((children[i] = exec ("child-linear")) != -1,
+           "exec \"child-linear\"");
+  busy_ns = time_reads (fd);
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (children[i]) == 0x42, "wait for child %d", i);
+
+  msg ("random reads alone: %lld ns each", idle_ns);
+  msg ("random reads during swapping: %lld ns each", busy_ns);
+  close (fd);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+
+# The expected output looks like this, with varying numbers:
+#
+# (swap-mix) random reads alone: 181234 ns each
+# (swap-mix) random reads during swapping: 402345 ns each
+
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (@rounds) = grep (/random reads (alone|during swapping): \d+ ns each/,
+                     @output);
+fail "2 timings expected but " . scalar (@rounds) . " found\n"
+  if @rounds != 2;
+
+pass;
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "devices/clock.h"
 #include "devices/kbd.h"
 #include "devices/input.h"
 #include "devices/serial.h"
@@ -16,11 +17,13 @@
 #include "devices/vga.h"
 #include "devices/rtc.h"
 #include "threads/interrupt.h"
+#include "threads/kstack.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -34,6 +37,9 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/pci.h"
+#include "devices/ramdisk.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -49,6 +55,11 @@ static bool format_filesys;
    overriding the defaults. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
+
+/** -ramdisk, -ramdisk-from: Size in kB and initial contents of
+   the RAM disk. */
+static size_t ramdisk_kb;
+static const char *ramdisk_image_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
@@ -100,6 +111,7 @@ pintos_init (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  kstack_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -121,10 +133,15 @@ pintos_init (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  clock_init ();
+  smp_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
+  pci_init ();
   ide_init ();
+  virtio_blk_init ();
+  ramdisk_init (ramdisk_kb, ramdisk_image_name);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -292,6 +309,12 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-pio"))
+        ide_pio = true;
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-ramdisk-from"))
+        ramdisk_image_name = value;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -301,13 +324,21 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-cfs"))
+        thread_cfs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
 #ifdef USERPROG
+      else if (!strcmp (name, "-guard"))
+        kstack_guard = true;
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
+  if (thread_mlfqs && thread_cfs)
+    PANIC ("-mlfqs and -cfs are mutually exclusive");
 
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
@@ -418,13 +449,19 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -pio               Move IDE disk data without DMA.\n"
+          "  -ramdisk=KB        Create RAM disk ram0 of KB kB.\n"
+          "  -ramdisk-from=BDEV Preload ram0 from BDEV, sized to fit by default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -cfs               Use completely fair scheduler.\n"
+          "  -tickless          Stop the timer tick while idle.\n"
 #ifdef USERPROG
+          "  -guard             Put a guard page below each thread's stack.\n"
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
           );
@@ -6,8 +6,12 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/clock.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 
 /** Programmable Interrupt Controller (PIC) registers.
@@ -43,9 +47,29 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /**< Are we processing an external interrupt? */
-static bool yield_on_return;    /**< Should we yield on interrupt return? */
+   interrupt returns.  Whether we are processing one, and whether
+   to yield on return, is tracked per CPU in struct cpu.
+
+   Work that can wait until the interrupt is acknowledged belongs
+   in a softirq (see threads/softirq.h), which runs on the way out
+   with interrupts back on.  The handlers proper are then all that
+   delays the next interrupt, and intr_off_cycles_max() reports
+   the longest any of them took.
+
+   Turning interrupts off affects only the CPU that does it.  It
+   keeps interrupt handlers and other threads on that CPU out of
+   a critical section, but not code on other CPUs, so data that
+   several CPUs share is guarded by a spinlock of its own as well
+   (see threads/spinlock.h): each ready queue, each palloc pool,
+   the timeout wheel, each semaphore's waiters, and so on. */
+
+/** Interrupts delivered through the local APIC, which are
+   acknowledged there instead of on the PIC. */
+static bool lapic_vector[INTR_CNT];
+
+/** Most CPU cycles an external interrupt has kept interrupts
+   off, from entry through acknowledgement. */
+static uint64_t off_cycles_max;
 
 /** Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -54,6 +78,7 @@ static void pic_end_of_interrupt (int irq);
 /** Interrupt Descriptor Table helpers. */
 static uint64_t make_intr_gate (void (*) (void), int dpl);
 static uint64_t make_trap_gate (void (*) (void), int dpl);
+static uint64_t make_task_gate (uint16_t tss_sel);
 static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 
 /** Interrupt handlers. */
@@ -88,7 +113,7 @@ enum intr_level
 intr_enable (void) 
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+  ASSERT (!cpu_current ()->in_external_intr);
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -157,6 +182,15 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/** Loads the IDT set up by intr_init() on an application
+   processor. */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 /** Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -206,23 +240,51 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/** Returns true during processing of an external interrupt
-   and false at all other times. */
+/** Registers local APIC interrupt VEC_NO to invoke HANDLER, which
+   is named NAME for debugging purposes.  The handler executes
+   with interrupts disabled, like that of an external interrupt. */
+void
+intr_register_lapic (uint8_t vec_no, intr_handler_func *handler,
+                     const char *name)
+{
+  ASSERT (vec_no >= LAPIC_TIMER_VEC && vec_no < LAPIC_SPURIOUS_VEC);
+  register_handler (vec_no, 0, INTR_OFF, handler, name);
+  lapic_vector[vec_no] = true;
+}
+
+/** Makes exception VEC_NO switch to the hardware task whose TSS
+   is selected by TSS_SEL, instead of invoking a handler through
+   intr_handler().  The task runs on a stack of its own, so it
+   can handle an exception taken when the kernel stack is
+   unusable.  NAME is the exception's name for debugging
+   purposes. */
+void
+intr_register_task (uint8_t vec_no, uint16_t tss_sel, const char *name)
+{
+  ASSERT (vec_no < 0x20);
+  ASSERT (intr_handlers[vec_no] == NULL);
+  idt[vec_no] = make_task_gate (tss_sel);
+  intr_names[vec_no] = name;
+}
+
+/** Returns true during processing of an external interrupt,
+   including its softirqs, and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  struct cpu *c = cpu_current ();
+  return c->in_external_intr || c->in_softirq;
 }
 
 /** During processing of an external interrupt, directs the
    interrupt handler to yield to a new process just before
-   returning from the interrupt.  May not be called at any other
-   time. */
+   returning from the interrupt, once softirqs have run.  May not
+   be called at any other time. */
 void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
 /** 8259A Programmable Interrupt Controller. */
@@ -327,6 +389,22 @@ make_trap_gate (void (*function) (void), int dpl)
   return make_gate (function, dpl, 15);
 }
 
+/** Creates a task gate that switches to the task whose TSS is
+   selected by TSS_SEL.  See [IA32-v3a] 6.2.5 "Task-Gate
+   Descriptor". */
+static uint64_t
+make_task_gate (uint16_t tss_sel)
+{
+  uint32_t e0, e1;
+
+  e0 = (uint32_t) tss_sel << 16;        /**< TSS segment selector. */
+  e1 = ((1 << 15)                       /**< Present. */
+        | (0 << 13)                     /**< Descriptor privilege level. */
+        | (5 << 8));                    /**< Task gate. */
+
+  return e0 | ((uint64_t) e1 << 32);
+}
+
 /** Returns a descriptor that yields the given LIMIT and BASE when
    used as an operand for the LIDT instruction. */
 static inline uint64_t
@@ -346,19 +424,28 @@ intr_handler (struct intr_frame *frame)
 {
   bool external;
   intr_handler_func *handler;
+  uint64_t start = 0;
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or local APIC
+     (see below).  An external interrupt handler cannot sleep. */
+  external = ((frame->vec_no >= 0x20 && frame->vec_no < 0x30)
+              || lapic_vector[frame->vec_no]);
   if (external) 
     {
+      struct cpu *c = cpu_current ();
+
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!c->in_external_intr);
 
-      in_external_intr = true;
-      yield_on_return = false;
+      start = clock_cycles ();
+      c->in_external_intr = true;
+
+      /* An interrupt taken while softirqs run leaves yielding to
+         them. */
+      if (!c->in_softirq)
+        c->yield_on_return = false;
     }
 
   /* Invoke the interrupt's handler. */
@@ -377,14 +464,29 @@ intr_handler (struct intr_frame *frame)
   /* Complete the processing of an external interrupt. */
   if (external) 
     {
-      ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (intr_context ());
+      struct cpu *c = cpu_current ();
+      uint64_t cycles;
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
-
-      if (yield_on_return) 
-        thread_yield (); 
+      ASSERT (intr_get_level () == INTR_OFF);
+      ASSERT (c->in_external_intr);
+
+      c->in_external_intr = false;
+      if (lapic_vector[frame->vec_no])
+        lapic_eoi ();
+      else
+        pic_end_of_interrupt (frame->vec_no); 
+
+      cycles = clock_cycles () - start;
+      if (cycles > off_cycles_max)
+        off_cycles_max = cycles;
+
+      if (!c->in_softirq)
+        {
+          if (c->softirq_pending != 0)
+            softirq_run ();
+          if (c->yield_on_return) 
+            thread_yield (); 
+        }
     }
 }
 
@@ -430,6 +532,26 @@ intr_dump_frame (const struct intr_frame *f)
           f->cs, f->ds, f->es, f->ss);
 }
 
+/** Returns the most CPU cycles, as counted by the time-stamp
+   counter, that an external interrupt has kept interrupts off
+   since boot or the last call to intr_off_cycles_reset().  The
+   softirqs it raised are not counted, since they run with
+   interrupts on. */
+uint64_t
+intr_off_cycles_max (void)
+{
+  return off_cycles_max;
+}
+
+/** Starts a new measurement for intr_off_cycles_max(). */
+void
+intr_off_cycles_reset (void)
+{
+  enum intr_level old_level = intr_disable ();
+  off_cycles_max = 0;
+  intr_set_level (old_level);
+}
+
 /** Returns the name of interrupt VEC. */
 const char *
 intr_name (uint8_t vec) 
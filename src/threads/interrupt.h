@@ -58,12 +58,19 @@ struct intr_frame
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
+void intr_register_lapic (uint8_t vec, intr_handler_func *,
+                          const char *name);
+void intr_register_task (uint8_t vec, uint16_t tss_sel, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
 
+uint64_t intr_off_cycles_max (void);
+void intr_off_cycles_reset (void);
+
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
@@ -0,0 +1,172 @@
+#include "threads/kstack.h"
+#include <debug.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/spinlock.h"
+
+/** Thread pages.  See kstack.h for an overview. */
+
+#define CACHE_MAX 32            /**< Most thread pages kept for reuse. */
+
+bool kstack_guard;
+
+/** Freed pages or slots, each linked through its first word. */
+static void *page_cache;
+static size_t page_cache_cnt;
+static void *slot_cache;
+
+/** Number of slots ever set up.  Slots are used in order. */
+static size_t slot_cnt;
+
+/** Guards the caches and slot_cnt. */
+static struct spinlock cache_lock = SPINLOCK_INITIALIZER;
+
+static void *cache_pop (void **cache, size_t *cnt);
+static void *slot_alloc (void);
+
+/** Sets aside the page tables for the guarded slot area, if
+   "-guard" was given.  They go into init_page_dir before any
+   process page directory copies it, so every address space sees
+   the same slots.  Called by main() after paging_init(). */
+void
+kstack_init (void)
+{
+  uintptr_t va;
+
+  if (!kstack_guard)
+    return;
+
+  ASSERT ((uintptr_t) ptov (init_ram_pages * PGSIZE - 1) < KSTACK_AREA);
+  for (va = KSTACK_AREA;
+       va < KSTACK_AREA + KSTACK_SLOT_CNT * KSTACK_SLOT_SIZE;
+       va += PGSIZE * (PGSIZE / sizeof (uint32_t)))
+    {
+      uint32_t *pde = init_page_dir + pd_no ((void *) va);
+
+      ASSERT (*pde == 0);
+      *pde = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+    }
+}
+
+/** Returns a page, or a slot if "-guard" was given, for a new
+   thread, or a null pointer if memory is exhausted.  Neither the
+   `struct thread' at its start nor its stack is cleared. */
+void *
+kstack_alloc (void)
+{
+  void *t;
+
+  if ((t = cache_pop (&slot_cache, NULL)) != NULL
+      || (kstack_guard && (t = slot_alloc ()) != NULL)
+      || (t = cache_pop (&page_cache, &page_cache_cnt)) != NULL)
+    return t;
+  return palloc_get_page (0);
+}
+
+/** Releases thread page or slot T, which kstack_alloc()
+   returned.  It is kept for reuse if there is room. */
+void
+kstack_free (void *t)
+{
+  enum intr_level old_level;
+  bool cached = true;
+
+  old_level = intr_disable ();
+  spin_acquire (&cache_lock);
+  if (kstack_in_area (t))
+    {
+      *(void **) t = slot_cache;
+      slot_cache = t;
+    }
+  else if (page_cache_cnt < CACHE_MAX)
+    {
+      *(void **) t = page_cache;
+      page_cache = t;
+      page_cache_cnt++;
+    }
+  else
+    cached = false;
+  spin_release (&cache_lock);
+  intr_set_level (old_level);
+
+  if (!cached)
+    palloc_free_page (t);
+}
+
+/** Returns true if ADDR is in the guard page of a slot. */
+bool
+kstack_is_guard (const void *addr)
+{
+  return (kstack_in_area (addr)
+          && ((uintptr_t) addr & (KSTACK_SLOT_SIZE - 1)) / PGSIZE == 1);
+}
+
+/** Takes a page or slot off CACHE and returns it, or returns a
+   null pointer if CACHE is empty.  Decrements *CNT, if CNT is
+   non-null. */
+static void *
+cache_pop (void **cache, size_t *cnt)
+{
+  enum intr_level old_level;
+  void *t;
+
+  old_level = intr_disable ();
+  spin_acquire (&cache_lock);
+  t = *cache;
+  if (t != NULL)
+    {
+      *cache = *(void **) t;
+      if (cnt != NULL)
+        (*cnt)--;
+    }
+  spin_release (&cache_lock);
+  intr_set_level (old_level);
+  return t;
+}
+
+/** Sets up the next unused slot with newly allocated pages and
+   returns it, or returns a null pointer if there are no slots or
+   pages left. */
+static void *
+slot_alloc (void)
+{
+  void *pages[KSTACK_SLOT_PAGES];
+  enum intr_level old_level;
+  uint8_t *slot;
+  int i;
+
+  for (i = 0; i < KSTACK_SLOT_PAGES; i++)
+    if (i != 1 && (pages[i] = palloc_get_page (0)) == NULL)
+      {
+        while (--i >= 0)
+          if (i != 1)
+            palloc_free_page (pages[i]);
+        return NULL;
+      }
+
+  old_level = intr_disable ();
+  spin_acquire (&cache_lock);
+  if (slot_cnt < KSTACK_SLOT_CNT)
+    {
+      slot = (uint8_t *) KSTACK_AREA + slot_cnt++ * KSTACK_SLOT_SIZE;
+      for (i = 0; i < KSTACK_SLOT_PAGES; i++)
+        {
+          uint8_t *va = slot + i * PGSIZE;
+          uint32_t *pt = pde_get_pt (init_page_dir[pd_no (va)]);
+
+          pt[pt_no (va)] = i != 1 ? pte_create_kernel (pages[i], true) : 0;
+        }
+    }
+  else
+    slot = NULL;
+  spin_release (&cache_lock);
+  intr_set_level (old_level);
+
+  if (slot == NULL)
+    for (i = 0; i < KSTACK_SLOT_PAGES; i++)
+      if (i != 1)
+        palloc_free_page (pages[i]);
+  return slot;
+}
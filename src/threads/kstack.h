@@ -0,0 +1,66 @@
+#ifndef THREADS_KSTACK_H
+#define THREADS_KSTACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/** Thread pages.
+
+   Each thread's `struct thread' and kernel stack share one page,
+   as described at the top of thread.h.  Pages of threads that
+   exit are kept in a small cache and handed to the next threads
+   created, without going back through the page allocator or
+   being cleared, since init_thread() clears `struct thread'
+   itself and a stack needs no clearing.
+
+   With the "-guard" option, a thread instead gets a slot of
+   KSTACK_SLOT_PAGES pages in an area of kernel virtual memory set
+   aside for the purpose: its `struct thread' in the first page,
+   an unmapped guard page, and a stack of the remaining pages, so
+   that a stack that overflows faults on the guard page instead of
+   overwriting the thread.  Slots are aligned to their size, so
+   the thread that owns a stack address is still found by
+   rounding it down.  Slots keep their pages when their threads
+   exit and are reused, so their mappings never change and never
+   need to be flushed from the TLB. */
+
+#define KSTACK_AREA (0xf0000000)        /**< Base of the guarded slot area. */
+#define KSTACK_SLOT_PAGES 4             /**< Pages per slot. */
+#define KSTACK_SLOT_SIZE (KSTACK_SLOT_PAGES * PGSIZE)
+#define KSTACK_SLOT_CNT 1024            /**< Number of slots. */
+
+/** If true, give threads guarded stacks.
+   Controlled by kernel command-line option "-guard". */
+extern bool kstack_guard;
+
+void kstack_init (void);
+void *kstack_alloc (void);
+void kstack_free (void *);
+bool kstack_is_guard (const void *);
+
+/** Returns true if ADDR lies in the guarded slot area. */
+static inline bool
+kstack_in_area (const void *addr)
+{
+  return ((uintptr_t) addr - KSTACK_AREA
+          < (uintptr_t) KSTACK_SLOT_CNT * KSTACK_SLOT_SIZE);
+}
+
+/** Returns the thread page whose stack holds ADDR. */
+static inline void *
+kstack_owner (const void *addr)
+{
+  if (kstack_in_area (addr))
+    return (void *) ((uintptr_t) addr & ~(uintptr_t) (KSTACK_SLOT_SIZE - 1));
+  return pg_round_down (addr);
+}
+
+/** Returns the top of the stack of thread page T. */
+static inline void *
+kstack_top (const void *t)
+{
+  return (uint8_t *) t + (kstack_in_area (t) ? KSTACK_SLOT_SIZE : PGSIZE);
+}
+
+#endif /**< threads/kstack.h */
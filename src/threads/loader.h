@@ -8,6 +8,11 @@
 /** Physical address of kernel base. */
 #define LOADER_KERN_BASE 0x20000       /**< 128 kB. */
 
+/** Physical address at which application processors start
+   executing in real mode.  Must be page-aligned, below 1 MB, and
+   clear of the loader and the kernel. */
+#define LOADER_AP_START 0x8000         /**< 32 kB. */
+
 /** Kernel virtual address at which all physical memory is mapped.
    Must be aligned on a 4 MB boundary. */
 #define LOADER_PHYS_BASE 0xc0000000     /**< 3 GB. */
@@ -1,14 +1,16 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/clock.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /** Page allocator.  Hands out memory in page-size (or
@@ -23,22 +25,76 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free pages form
+   blocks of 2**ORDER pages, aligned to their size within the
+   pool, with a free list per order.  A request for N pages takes
+   the smallest block of at least N pages, splitting larger ones
+   as needed, and gives back the pages past the first N.  Freed
+   pages merge with their buddies into ever larger blocks, so
+   that allocating and freeing take time logarithmic in the pool
+   size.  That is short enough to do under a spinlock, one per
+   pool, taken with interrupts off, so pages may be freed even
+   from the scheduler, and the two pools do not contend.
+
+   While a CPU has nothing to run, its idle thread zeroes free
+   user pool pages ahead of time and keeps them on a short list,
+   so that a single zeroed user page, which is what every new
+   stack page needs, can usually be handed out without clearing
+   it on the page fault path. */
+
+/** Number of block orders, enough for pools of up to 2 GB. */
+#define ORDER_CNT 20
+
+/** Value in a pool's order_map for pages that do not start a
+   free block. */
+#define NOT_FREE 0xff
 
 /** A memory pool. */
 struct pool
   {
-    struct lock lock;                   /**< Mutual exclusion. */
-    struct bitmap *used_map;            /**< Bitmap of free pages. */
     uint8_t *base;                      /**< Base of pool. */
+    size_t page_cnt;                    /**< Number of pages in pool. */
+    size_t free_cnt;                    /**< Number of free pages. */
+    uint8_t *order_map;                 /**< Per page: order of the free
+                                           block it starts, or NOT_FREE. */
+    struct list free_lists[ORDER_CNT];  /**< Free blocks of each order. */
+    struct spinlock lock;               /**< Guards free_cnt, order_map
+                                           and free_lists. */
+  };
+
+/** Header kept in the first page of each free block. */
+struct free_block
+  {
+    struct list_elem elem;              /**< Element in a free list. */
   };
 
 /** Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/** User pages zeroed in advance by palloc_zero_idle().  While
+   they wait here they are allocated, off the user pool's free
+   lists, and count against its free_cnt.  Protected by the user
+   pool's lock. */
+#define ZEROED_MAX 64
+static void *zeroed_pages[ZEROED_MAX];
+static size_t zeroed_cnt;       /**< Pages in zeroed_pages. */
+static size_t zeroing_cnt;      /**< Pages being zeroed by idle threads. */
+
+/** Statistics. */
+static long long zeroed_hits;           /**< Zeroed requests served from the list. */
+static long long zeroed_misses;         /**< Zeroed requests cleared on demand. */
+static long long demand_zero_cycles;    /**< Cycles spent clearing on demand. */
+static long long idle_zero_pages;       /**< Pages zeroed by idle threads. */
+static long long idle_zero_cycles;      /**< Cycles idle threads spent on them. */
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_alloc (struct pool *, size_t page_cnt);
+static void pool_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void *zeroed_pop (void);
 
 /** Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -66,29 +122,52 @@ palloc_init (size_t user_page_limit)
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
    available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   FLAGS, in which case the kernel panics.
+
+   A single zeroed user page comes from the pages zeroed in
+   advance, if there are any.  Those pages also count as free for
+   any other single user page request. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  bool zeroed = (flags & (PAL_USER | PAL_ZERO)) == (PAL_USER | PAL_ZERO);
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if (zeroed && page_cnt == 1 && (pages = zeroed_pop ()) != NULL)
+    {
+      zeroed_hits++;
+      return pages;
+    }
 
-  if (page_idx != BITMAP_ERROR)
+  old_level = intr_disable ();
+  spin_acquire (&pool->lock);
+  page_idx = pool_alloc (pool, page_cnt);
+  spin_release (&pool->lock);
+  intr_set_level (old_level);
+
+  if (page_idx != SIZE_MAX)
     pages = pool->base + PGSIZE * page_idx;
+  else if (flags & PAL_USER && page_cnt == 1)
+    pages = zeroed_pop ();
   else
     pages = NULL;
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if (zeroed)
+        {
+          uint64_t start = clock_cycles ();
+          memset (pages, 0, PGSIZE * page_cnt);
+          demand_zero_cycles += clock_cycles () - start;
+          zeroed_misses += page_cnt;
+        }
+      else if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -118,6 +197,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -137,8 +217,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  spin_acquire (&pool->lock);
+  pool_free (pool, page_idx, page_cnt);
+  spin_release (&pool->lock);
+  intr_set_level (old_level);
 }
 
 /** Frees the page at PAGE. */
@@ -148,25 +231,158 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/** Zeroes one free user page and puts it on the list of zeroed
+   pages, with interrupts on while it is cleared.  Returns true if
+   it did, false if the list is full or no page could be taken
+   without waiting.  Called by the idle thread with interrupts off
+   when it has nothing to run. */
+bool
+palloc_zero_idle (void)
+{
+  struct pool *pool = &user_pool;
+  size_t page_idx;
+  uint8_t *page;
+  uint64_t start, cycles;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spin_acquire (&pool->lock);
+  if (zeroed_cnt + zeroing_cnt >= ZEROED_MAX)
+    page_idx = SIZE_MAX;
+  else
+    page_idx = pool_alloc (pool, 1);
+  if (page_idx == SIZE_MAX)
+    {
+      spin_release (&pool->lock);
+      return false;
+    }
+  zeroing_cnt++;
+  spin_release (&pool->lock);
+  page = pool->base + PGSIZE * page_idx;
+
+  intr_enable ();
+  start = clock_cycles ();
+  memset (page, 0, PGSIZE);
+  cycles = clock_cycles () - start;
+  intr_disable ();
+
+  spin_acquire (&pool->lock);
+  zeroing_cnt--;
+  zeroed_pages[zeroed_cnt++] = page;
+  idle_zero_pages++;
+  idle_zero_cycles += cycles;
+  spin_release (&pool->lock);
+  return true;
+}
+
+/** Stores the number of free pages in the user pool, if FLAGS
+   has PAL_USER set, or else in the kernel pool, into *FREE_CNT,
+   and the number of pages in its largest free block into
+   *LARGEST_FREE.  Pages zeroed in advance do not count as
+   free. */
+void
+palloc_pool_stats (enum palloc_flags flags, size_t *free_cnt,
+                   size_t *largest_free)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  int order;
+
+  old_level = intr_disable ();
+  spin_acquire (&pool->lock);
+  *free_cnt = pool->free_cnt;
+  *largest_free = 0;
+  for (order = ORDER_CNT - 1; order >= 0; order--)
+    if (!list_empty (&pool->free_lists[order]))
+      {
+        *largest_free = (size_t) 1 << order;
+        break;
+      }
+  spin_release (&pool->lock);
+  intr_set_level (old_level);
+}
+
+/** Prints statistics about zeroed user pages and about how
+   fragmented each pool is.  The cycles saved are estimated from
+   the average cost of clearing a page on demand, or while idle if
+   none has been cleared on demand. */
+void
+palloc_print_stats (void)
+{
+  static const struct
+    {
+      const char *name;
+      enum palloc_flags flags;
+    }
+  pools[] = {{"kernel", 0}, {"user", PAL_USER}};
+  long long saved = 0;
+  size_t i;
+
+  if (zeroed_misses > 0)
+    saved = demand_zero_cycles / zeroed_misses * zeroed_hits;
+  else if (idle_zero_pages > 0)
+    saved = idle_zero_cycles / idle_zero_pages * zeroed_hits;
+  printf ("Palloc: %lld of %lld zeroed user page requests served "
+          "pre-zeroed, about %lld cycles saved\n",
+          zeroed_hits, zeroed_hits + zeroed_misses, saved);
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      size_t free_cnt, largest_free;
+
+      palloc_pool_stats (pools[i].flags, &free_cnt, &largest_free);
+      printf ("Palloc: %s pool has %zu pages free, "
+              "largest free block %zu pages\n",
+              pools[i].name, free_cnt, largest_free);
+    }
+}
+
+/** Takes a page off the list of zeroed user pages and returns
+   it, or returns a null pointer if the list is empty. */
+static void *
+zeroed_pop (void)
+{
+  enum intr_level old_level;
+  void *page = NULL;
+
+  old_level = intr_disable ();
+  spin_acquire (&user_pool.lock);
+  if (zeroed_cnt > 0)
+    page = zeroed_pages[--zeroed_cnt];
+  spin_release (&user_pool.lock);
+  intr_set_level (old_level);
+  return page;
+}
+
 /** Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's order_map at its base.
+     Calculate the space needed for it
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t map_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (map_pages > page_cnt)
+    PANIC ("Not enough memory in %s for order map.", name);
+  page_cnt -= map_pages;
+  if (page_cnt > (size_t) 1 << (ORDER_CNT - 1) << 1)
+    PANIC ("Too many pages in %s.", name);
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, with all of its pages free. */
+  p->order_map = base;
+  memset (p->order_map, NOT_FREE, page_cnt);
+  p->base = (uint8_t *) base + map_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = 0;
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  spin_init (&p->lock);
+  pool_free (p, 0, page_cnt);
 }
 
 /** Returns true if PAGE was allocated from POOL,
@@ -176,7 +392,97 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/** Returns the free block header at PAGE_IDX in POOL. */
+static struct free_block *
+block_at (struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/** Puts the free block of 2**ORDER pages at PAGE_IDX on POOL's
+   free list for ORDER. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  pool->order_map[page_idx] = order;
+  list_push_front (&pool->free_lists[order], &block_at (pool, page_idx)->elem);
+}
+
+/** Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or SIZE_MAX if no free block is big
+   enough.  Interrupts must be off. */
+static size_t
+pool_alloc (struct pool *pool, size_t page_cnt)
+{
+  struct free_block *b;
+  size_t page_idx;
+  int order, want;
+
+  for (want = 0; want < ORDER_CNT && ((size_t) 1 << want) < page_cnt; want++)
+    continue;
+  for (order = want; order < ORDER_CNT; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order >= ORDER_CNT)
+    return SIZE_MAX;
+
+  b = list_entry (list_pop_front (&pool->free_lists[order]),
+                  struct free_block, elem);
+  page_idx = ((uint8_t *) b - pool->base) / PGSIZE;
+  pool->order_map[page_idx] = NOT_FREE;
+
+  /* Split off upper halves until the block is the right size. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+  pool->free_cnt -= (size_t) 1 << order;
+
+  /* Give back what the request does not use. */
+  if (page_cnt < (size_t) 1 << order)
+    pool_free (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
+}
+
+/** Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks they split into, merging each with its
+   buddy for as long as that is free too.  Interrupts must be
+   off, except while the pool is being initialized. */
+static void
+pool_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
+
+  pool->free_cnt += page_cnt;
+  while (page_cnt > 0)
+    {
+      size_t idx = page_idx;
+      int order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && (idx & (((size_t) 2 << order) - 1)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+
+      ASSERT (pool->order_map[idx] == NOT_FREE);
+      while (order + 1 < ORDER_CNT)
+        {
+          size_t buddy = idx ^ ((size_t) 1 << order);
+          if (buddy >= pool->page_cnt || pool->order_map[buddy] != order)
+            break;
+          list_remove (&block_at (pool, buddy)->elem);
+          pool->order_map[buddy] = NOT_FREE;
+          idx &= ~((size_t) 1 << order);
+          order++;
+        }
+      push_block (pool, idx, order);
+    }
+}
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #define PAGING_ENABLED true
@@ -18,5 +19,9 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_zero_idle (void);
+void palloc_pool_stats (enum palloc_flags, size_t *free_cnt,
+                        size_t *largest_free);
+void palloc_print_stats (void);
 
 #endif /**< threads/palloc.h */
@@ -0,0 +1,242 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/spinlock.h"
+#include "threads/vaddr.h"
+
+/** Object caches.
+
+   Each slab is a single page from the kernel pool, with a header
+   at its start followed by as many objects as fit.  A free
+   object holds a pointer to the next free object of its slab, at
+   the start of the object unless the cache has a constructor, in
+   which case the pointer goes just past the object so as not to
+   disturb its constructed state.  The header also lets
+   kmem_cache_free() check that an object belongs to the cache it
+   is freed to.
+
+   A cache keeps the slabs that have free objects on a list, and
+   takes new objects from the first of them.  A slab whose last
+   object is freed goes back to the page allocator, unless it is
+   the cache's only empty slab, which is kept so that a cache
+   whose use hovers around a slab boundary does not churn
+   pages. */
+
+/** Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/** Alignment of objects within a slab. */
+#define OBJ_ALIGN sizeof (void *)
+
+/** Slab header. */
+struct slab
+  {
+    unsigned magic;             /**< Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /**< Owning cache. */
+    struct list_elem elem;      /**< Element in cache's slab list. */
+    size_t free_cnt;            /**< Number of free objects. */
+    void *free;                 /**< First free object. */
+  };
+
+/** Offset of the first object in a slab. */
+#define SLAB_HEADER ROUND_UP (sizeof (struct slab), OBJ_ALIGN)
+
+/** All caches, for kmem_print_stats().  Caches are never
+   destroyed, so the list only grows, under caches_lock. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+static struct spinlock caches_lock = SPINLOCK_INITIALIZER;
+
+/** Returns the link stored in free object OBJ of cache C. */
+static inline void **
+obj_link (const struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
+
+/** Initializes C as a cache of SIZE-byte objects named NAME.  If
+   CTOR is nonnull, it is called on each object as its slab is
+   created. */
+void
+kmem_cache_init (struct kmem_cache *c, const char *name, size_t size,
+                 kmem_ctor *ctor)
+{
+  enum intr_level old_level;
+
+  ASSERT (c != NULL);
+  ASSERT (size > 0);
+
+  c->name = name;
+  c->obj_size = size;
+  c->ctor = ctor;
+  if (ctor == NULL)
+    {
+      c->link_ofs = 0;
+      c->stride = ROUND_UP (size < sizeof (void *) ? sizeof (void *) : size,
+                            OBJ_ALIGN);
+    }
+  else
+    {
+      c->link_ofs = ROUND_UP (size, OBJ_ALIGN);
+      c->stride = c->link_ofs + ROUND_UP (sizeof (void *), OBJ_ALIGN);
+    }
+  c->objs_per_slab = (PGSIZE - SLAB_HEADER) / c->stride;
+  ASSERT (c->objs_per_slab > 0);
+
+  lock_init (&c->lock);
+  list_init (&c->slabs);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->in_use = 0;
+  c->peak_in_use = 0;
+  c->alloc_cnt = 0;
+
+  old_level = intr_disable ();
+  spin_acquire (&caches_lock);
+  list_push_back (&all_caches, &c->elem);
+  spin_release (&caches_lock);
+  intr_set_level (old_level);
+}
+
+/** Allocates a new slab for C, constructs its objects, and puts
+   it on C's slab list.  Returns false if no page is
+   available. */
+static bool
+grow (struct kmem_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return false;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  s->free = NULL;
+  for (i = c->objs_per_slab; i-- > 0; )
+    {
+      void *obj = (uint8_t *) s + SLAB_HEADER + i * c->stride;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *obj_link (c, obj) = s->free;
+      s->free = obj;
+    }
+  list_push_front (&c->slabs, &s->elem);
+  c->slab_cnt++;
+  c->empty_cnt++;
+  return true;
+}
+
+/** Allocates and returns an object from C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->slabs) && !grow (c))
+    {
+      lock_release (&c->lock);
+      return NULL;
+    }
+
+  s = list_entry (list_front (&c->slabs), struct slab, elem);
+  if (s->free_cnt == c->objs_per_slab)
+    c->empty_cnt--;
+  obj = s->free;
+  s->free = *obj_link (c, obj);
+  if (--s->free_cnt == 0)
+    list_remove (&s->elem);
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/** Frees OBJ, which must have been allocated from C.  A null
+   OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT ((pg_ofs (obj) - SLAB_HEADER) % c->stride == 0);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  *obj_link (c, obj) = s->free;
+  s->free = obj;
+  if (s->free_cnt++ == 0)
+    list_push_front (&c->slabs, &s->elem);
+  c->in_use--;
+
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      if (c->empty_cnt > 0)
+        {
+          list_remove (&s->elem);
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+      else
+        c->empty_cnt++;
+    }
+  lock_release (&c->lock);
+}
+
+/** Returns the number of bytes malloc() would set aside for a
+   SIZE-byte block: the next power of 2 of at least 16 bytes, or
+   whole pages past 1 kB. */
+static size_t
+malloc_size (size_t size)
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+    if (block_size >= size)
+      return block_size;
+  return PGSIZE * DIV_ROUND_UP (size + 3 * sizeof (void *), PGSIZE);
+}
+
+/** Prints statistics about each object cache, including how
+   much memory its peak use would have taken beyond that in
+   blocks from malloc(). */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      long long saved = ((long long) malloc_size (c->obj_size)
+                         - (long long) c->stride) * c->peak_in_use;
+
+      printf ("Slab: %s: %zu of %zu-byte objects in use (peak %zu) "
+              "in %zu slabs, %llu allocated, %lld bytes saved over malloc\n",
+              c->name, c->in_use, c->obj_size, c->peak_in_use,
+              c->slab_cnt, c->alloc_cnt, saved);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/** Constructor for the objects of a cache. */
+typedef void kmem_ctor (void *obj);
+
+/** A cache of objects of a single size.
+
+   Objects are carved out of page-sized slabs at their exact size
+   (rounded up only for alignment), instead of at the next power
+   of 2 as malloc() would, and freed objects are kept on per-slab
+   free lists for reuse by the next allocation.
+
+   If the cache has a constructor, it is called once on each
+   object when its slab is created, not on every allocation, so
+   users must free objects back to the cache in their constructed
+   state. */
+struct kmem_cache
+  {
+    const char *name;           /**< Name, for statistics. */
+    size_t obj_size;            /**< Size of an object in bytes. */
+    size_t stride;              /**< Bytes between objects in a slab. */
+    size_t link_ofs;            /**< Offset of a free object's link. */
+    size_t objs_per_slab;       /**< Objects in each slab. */
+    kmem_ctor *ctor;            /**< Constructor, or a null pointer. */
+    struct lock lock;           /**< Protects the remaining members. */
+    struct list slabs;          /**< Slabs with free objects. */
+    size_t empty_cnt;           /**< Slabs with every object free. */
+    size_t slab_cnt;            /**< Slabs allocated. */
+    size_t in_use;              /**< Objects allocated. */
+    size_t peak_in_use;         /**< Most objects ever allocated at once. */
+    unsigned long long alloc_cnt; /**< Allocations ever made. */
+    struct list_elem elem;      /**< Element in list of all caches. */
+  };
+
+void kmem_cache_init (struct kmem_cache *, const char *name, size_t size,
+                      kmem_ctor *);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#endif /**< threads/slab.h */
@@ -0,0 +1,384 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <packed.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/kstack.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#endif
+
+/** Symmetric multiprocessing.
+
+   Processors are found through the MP configuration table of
+   [MP] chapter 4, which the BIOS leaves in low memory.  Each
+   application processor is started with the INIT-SIPI-SIPI
+   sequence into the real-mode trampoline in ap-start.S, which
+   brings it into the kernel's address space on the stack of an
+   idle thread prepared for it.  From then on it takes part in
+   scheduling like the boot CPU, see thread.c.
+
+   Turning interrupts off keeps out only the calling CPU's own
+   interrupts, so data shared between CPUs has spinlocks of its
+   own, see threads/spinlock.h.  Device interrupts,
+   including the PIT, keep going to the boot CPU only; each
+   application processor ticks from its own local APIC timer. */
+
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+bool smp_started;
+
+#ifdef USERPROG
+/** Serializes smp_tlb_shootdown(). */
+static struct spinlock tlb_lock = SPINLOCK_INITIALIZER;
+#endif
+
+/** MP floating pointer structure. */
+struct mp_fp
+  {
+    char signature[4];          /**< "_MP_". */
+    uint32_t conf_paddr;        /**< Physical address of struct mp_conf. */
+    uint8_t length;             /**< Size in 16-byte units. */
+    uint8_t revision;           /**< Version of the specification. */
+    uint8_t checksum;           /**< All bytes must sum to 0. */
+    uint8_t features[5];        /**< Feature information. */
+  }
+PACKED;
+
+/** MP configuration table header. */
+struct mp_conf
+  {
+    char signature[4];          /**< "PCMP". */
+    uint16_t length;            /**< Size of header and entries. */
+    uint8_t revision;           /**< Version of the specification. */
+    uint8_t checksum;           /**< All bytes must sum to 0. */
+    char oem_id[8];             /**< Manufacturer. */
+    char product_id[12];        /**< Product family. */
+    uint32_t oem_table;         /**< OEM configuration table. */
+    uint16_t oem_length;        /**< Size of OEM table. */
+    uint16_t entry_cnt;         /**< Number of entries that follow. */
+    uint32_t lapic_paddr;       /**< Physical address of local APICs. */
+    uint16_t ext_length;        /**< Size of extended entries. */
+    uint8_t ext_checksum;       /**< Checksum of extended entries. */
+    uint8_t reserved;
+  }
+PACKED;
+
+/** MP configuration table processor entry. */
+struct mp_proc
+  {
+    uint8_t type;               /**< MP_PROC. */
+    uint8_t apic_id;            /**< Local APIC ID. */
+    uint8_t apic_version;       /**< Local APIC version. */
+    uint8_t flags;              /**< MP_PROC_* flags. */
+    uint32_t signature;         /**< CPU type. */
+    uint32_t features;          /**< CPUID feature flags. */
+    uint8_t reserved[8];
+  }
+PACKED;
+
+#define MP_PROC 0               /**< Processor entry type. */
+#define MP_PROC_ENABLED 0x01    /**< Processor is usable. */
+#define MP_PROC_BSP 0x02        /**< Processor is the boot CPU. */
+#define MP_ENTRY_SIZE 8         /**< Size of every other entry type. */
+
+/** Milliseconds to wait for an application processor to start. */
+#define AP_START_TIMEOUT 100
+
+/** Application processor trampoline, in ap-start.S. */
+extern const char ap_start[], ap_start_end[];
+extern const char ap_gdt[], ap_cr3[], ap_stack[], ap_entry[];
+
+static struct mp_conf *mp_find_config (void);
+static void ap_main (void) NO_RETURN;
+static intr_handler_func ap_timer_interrupt;
+static intr_handler_func resched_interrupt;
+static intr_handler_func tlb_interrupt;
+static intr_handler_func spurious_interrupt;
+
+/** Starts every application processor listed in the MP
+   configuration table, if there are any.  Must be called with
+   interrupts on, after timer_calibrate(). */
+void
+smp_init (void)
+{
+  uint8_t ap_ids[CPU_MAX - 1];
+  int ap_cnt = 0;
+  struct mp_conf *conf;
+  uint8_t *p, *end;
+  uint32_t *boot_pd;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  conf = mp_find_config ();
+  if (conf == NULL)
+    return;
+
+  /* Collect the application processors. */
+  p = (uint8_t *) (conf + 1);
+  end = (uint8_t *) conf + conf->length;
+  while (p < end)
+    if (*p == MP_PROC)
+      {
+        struct mp_proc *proc = (struct mp_proc *) p;
+        if ((proc->flags & MP_PROC_ENABLED) && !(proc->flags & MP_PROC_BSP)
+            && ap_cnt < CPU_MAX - 1)
+          ap_ids[ap_cnt++] = proc->apic_id;
+        p += sizeof *proc;
+      }
+    else
+      p += MP_ENTRY_SIZE;
+  if (ap_cnt == 0)
+    return;
+
+  lapic_init (conf->lapic_paddr);
+  cpus[0].apic_id = lapic_id ();
+  intr_register_lapic (LAPIC_TIMER_VEC, ap_timer_interrupt, "APIC Timer");
+  intr_register_lapic (LAPIC_RESCHED_VEC, resched_interrupt, "Reschedule IPI");
+  intr_register_lapic (LAPIC_TLB_VEC, tlb_interrupt, "TLB Shootdown IPI");
+  intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF, spurious_interrupt,
+                     "APIC Spurious Interrupt");
+
+  /* Install the trampoline.  Its page directory also maps the
+     low 4 MB at virtual address 0, where the trampoline is
+     running when it turns on paging. */
+  boot_pd = palloc_get_page (PAL_ASSERT);
+  memcpy (boot_pd, init_page_dir, PGSIZE);
+  boot_pd[0] = init_page_dir[pd_no (PHYS_BASE)];
+  memcpy (ptov (LOADER_AP_START), ap_start, ap_start_end - ap_start);
+  *(uint32_t *) ptov (LOADER_AP_START + (ap_cr3 - ap_start)) = vtop (boot_pd);
+  *(void **) ptov (LOADER_AP_START + (ap_entry - ap_start)) = ap_main;
+
+  smp_started = true;
+
+  /* Start the application processors one at a time, so that each
+     knows its index from cpu_cnt. */
+  for (i = 0; i < ap_cnt; i++)
+    {
+      struct cpu *c = &cpus[cpu_cnt];
+      int ms;
+
+      c->id = cpu_cnt;
+      c->apic_id = ap_ids[i];
+      *(void **) ptov (LOADER_AP_START + (ap_stack - ap_start))
+        = thread_create_ap_idle (c);
+
+      lapic_start_ap (c->apic_id, LOADER_AP_START);
+      for (ms = 0; ms < AP_START_TIMEOUT && !c->started; ms++)
+        timer_mdelay (1);
+      if (!c->started)
+        {
+          printf ("smp: CPU with APIC ID %d did not start\n", c->apic_id);
+          break;
+        }
+    }
+
+  palloc_free_page (boot_pd);
+  printf ("smp: %d CPUs online.\n", cpu_cnt);
+}
+
+/** Returns the CPU that is executing the caller. */
+struct cpu *
+cpu_current (void)
+{
+  uint32_t *esp;
+
+  if (!smp_started)
+    return &cpus[0];
+
+  /* Same as running_thread() in thread.c.  Every thread records
+     the CPU it runs on. */
+  asm ("mov %%esp, %0" : "=g" (esp));
+  return ((struct thread *) kstack_owner (esp))->cpu;
+}
+
+/** Asks CPU C to reschedule on return from its current
+   interrupt, or as soon as it next enables interrupts. */
+void
+smp_send_reschedule (struct cpu *c)
+{
+  lapic_send_ipi (c->apic_id, LAPIC_RESCHED_VEC);
+}
+
+#ifdef USERPROG
+/** Flushes the TLB of every other CPU that has page directory PD
+   loaded, and waits until all of them have done so.  The caller
+   has already flushed its own. */
+void
+smp_tlb_shootdown (uint32_t *pd)
+{
+  struct cpu *self;
+  enum intr_level old_level;
+  int i;
+
+  if (!smp_started)
+    return;
+
+  /* Each CPU has room for one request at a time, so shootdowns
+     take turns. */
+  old_level = intr_disable ();
+  spin_acquire (&tlb_lock);
+  self = cpu_current ();
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *c = &cpus[i];
+      if (c != self && c->loaded_pd == pd)
+        {
+          c->tlb_flush_pd = pd;
+          lapic_send_ipi (c->apic_id, LAPIC_TLB_VEC);
+        }
+    }
+
+  /* The other CPUs answer from tlb_interrupt(), or from
+     spin_wait() if they are spinning with interrupts off. */
+  for (i = 0; i < cpu_cnt; i++)
+    while (cpus[i].tlb_flush_pd != NULL)
+      spin_wait ();
+  spin_release (&tlb_lock);
+  intr_set_level (old_level);
+}
+#endif
+
+/** Performs a TLB flush requested of the calling CPU by
+   smp_tlb_shootdown(), if any. */
+void
+smp_tlb_poll (void)
+{
+  struct cpu *c = cpu_current ();
+  uint32_t *pd = c->tlb_flush_pd;
+
+  if (pd != NULL)
+    {
+      uint32_t cr3;
+
+      /* Reloading CR3 flushes the TLB.  See [IA32-v3a] 3.12
+         "Translation Lookaside Buffers (TLBs)". */
+      asm volatile ("movl %%cr3, %0" : "=r" (cr3));
+      if (cr3 == vtop (pd))
+        asm volatile ("movl %0, %%cr3" : : "r" (cr3) : "memory");
+      c->tlb_flush_pd = NULL;
+    }
+}
+
+/** Searches the LEN bytes at physical address PADDR for an MP
+   floating pointer structure. */
+static struct mp_fp *
+mp_search (uintptr_t paddr, size_t len)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + len;
+
+  for (; p + sizeof (struct mp_fp) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4))
+      {
+        uint8_t sum = 0;
+        size_t i;
+
+        for (i = 0; i < sizeof (struct mp_fp); i++)
+          sum += p[i];
+        if (sum == 0)
+          return (struct mp_fp *) p;
+      }
+  return NULL;
+}
+
+/** Returns the MP configuration table, or a null pointer if
+   there is none.  The floating pointer structure is in the first
+   kB of the extended BIOS data area, in the last kB of base
+   memory, or in the BIOS ROM, see [MP] 4.1. */
+static struct mp_conf *
+mp_find_config (void)
+{
+  const uint8_t *bda = ptov (0x400);
+  uintptr_t ebda = (uintptr_t) *(const uint16_t *) (bda + 0x0e) << 4;
+  uintptr_t base_end = (uintptr_t) *(const uint16_t *) (bda + 0x13) * 1024;
+  struct mp_fp *fp = NULL;
+  struct mp_conf *conf;
+  uint8_t sum = 0;
+  uint16_t i;
+
+  if (ebda != 0)
+    fp = mp_search (ebda, 1024);
+  if (fp == NULL && base_end >= 1024)
+    fp = mp_search (base_end - 1024, 1024);
+  if (fp == NULL)
+    fp = mp_search (0xf0000, 0x10000);
+  if (fp == NULL || fp->conf_paddr == 0
+      || fp->conf_paddr >= init_ram_pages * PGSIZE)
+    return NULL;
+
+  conf = ptov (fp->conf_paddr);
+  if (memcmp (conf->signature, "PCMP", 4))
+    return NULL;
+  for (i = 0; i < conf->length; i++)
+    sum += ((uint8_t *) conf)[i];
+  return sum == 0 ? conf : NULL;
+}
+
+/** First C code run by an application processor, on the stack
+   of its idle thread, with interrupts off. */
+static void
+ap_main (void)
+{
+  struct cpu *c = cpu_current ();
+  uint64_t gdtr_operand;
+
+  /* Switch to the kernel's page directory and to a GDT address
+     that does not depend on the boot page directory. */
+  gdtr_operand = (uint64_t) (uint32_t) ap_gdt << 16 | (3 * 8 - 1);
+  asm volatile ("lgdt %0" : : "m" (gdtr_operand));
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  intr_init_ap ();
+  lapic_init_ap ();
+#ifdef USERPROG
+  tss_init_ap (c->id);
+  gdt_init_ap (c->id);
+#endif
+
+  ASSERT (c->id == cpu_cnt);
+  cpu_cnt++;
+  c->started = true;
+  thread_start_ap ();
+}
+
+/** Local APIC timer interrupt handler of application
+   processors. */
+static void
+ap_timer_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_tick ();
+}
+
+/** Reschedule IPI handler. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED)
+{
+  intr_yield_on_return ();
+}
+
+/** TLB shootdown IPI handler. */
+static void
+tlb_interrupt (struct intr_frame *args UNUSED)
+{
+  smp_tlb_poll ();
+}
+
+/** Spurious interrupts need no acknowledgement. */
+static void
+spurious_interrupt (struct intr_frame *args UNUSED)
+{
+}
@@ -0,0 +1,56 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Maximum number of CPUs supported. */
+#define CPU_MAX 8
+
+struct thread;
+
+/** Per-CPU state.
+
+   cpus[0] is the boot CPU.  Application processors found in the
+   MP configuration table are numbered from 1 in the order they
+   were started. */
+struct cpu
+  {
+    int id;                             /**< Index into cpus[]. */
+    uint8_t apic_id;                    /**< Local APIC ID. */
+    volatile bool started;              /**< Running and scheduling threads? */
+
+    /* Owned by thread.c. */
+    struct thread *idle_thread;         /**< This CPU's idle thread. */
+    struct thread *cur;                 /**< Thread running on this CPU. */
+    unsigned thread_ticks;              /**< # of timer ticks since last yield. */
+
+    /* Owned by interrupt.c. */
+    bool in_external_intr;              /**< Are we processing an external interrupt? */
+    bool yield_on_return;               /**< Should we yield on interrupt return? */
+
+    /* Owned by softirq.c. */
+    unsigned softirq_pending;           /**< Bit N set if softirq N is raised. */
+    bool in_softirq;                    /**< Are we running softirqs? */
+
+    /* Owned by smp.c. */
+    uint32_t *volatile tlb_flush_pd;    /**< Page directory to flush from the TLB. */
+    uint32_t *volatile loaded_pd;       /**< Set by pagedir_activate(). */
+  };
+
+extern struct cpu cpus[CPU_MAX];
+
+/** Number of CPUs scheduling threads, 1 until smp_init() has
+   started the application processors. */
+extern int cpu_cnt;
+
+/** True once application processors may be running. */
+extern bool smp_started;
+
+void smp_init (void);
+struct cpu *cpu_current (void);
+void smp_send_reschedule (struct cpu *);
+void smp_tlb_shootdown (uint32_t *pd);
+void smp_tlb_poll (void);
+
+#endif /**< threads/smp.h */
@@ -0,0 +1,73 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+
+/** Handler of each softirq. */
+static softirq_func *handlers[SOFTIRQ_CNT];
+
+/** Times softirq_run() goes back for softirqs raised while it
+   ran before leaving the rest for the next interrupt, so that
+   an interrupt storm cannot keep the interrupted thread from
+   ever resuming. */
+#define RESTART_MAX 10
+
+/** Makes FUNC the handler of softirq NR.  Each softirq can have
+   only one handler. */
+void
+softirq_register (enum softirq nr, softirq_func *func)
+{
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (handlers[nr] == NULL);
+  ASSERT (func != NULL);
+
+  handlers[nr] = func;
+}
+
+/** Marks softirq NR to run on this CPU.  Usually called by an
+   external interrupt handler, in which case it runs as the
+   interrupt returns.  Otherwise, it runs on the next return from
+   an external interrupt. */
+void
+softirq_raise (enum softirq nr)
+{
+  enum intr_level old_level;
+
+  ASSERT (nr < SOFTIRQ_CNT);
+
+  old_level = intr_disable ();
+  cpu_current ()->softirq_pending |= 1u << nr;
+  intr_set_level (old_level);
+}
+
+/** Runs the handlers of the softirqs raised on this CPU with
+   interrupts on.  Called by intr_handler() with interrupts off
+   after it has acknowledged an external interrupt that did not
+   arrive while softirqs were running; returns with interrupts
+   off. */
+void
+softirq_run (void)
+{
+  struct cpu *c = cpu_current ();
+  int restart;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!c->in_softirq);
+
+  c->in_softirq = true;
+  for (restart = 0; c->softirq_pending != 0 && restart < RESTART_MAX;
+       restart++)
+    {
+      unsigned pending = c->softirq_pending;
+      int nr;
+
+      c->softirq_pending = 0;
+      intr_enable ();
+      for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+        if (pending & (1u << nr))
+          handlers[nr] ();
+      intr_disable ();
+    }
+  c->in_softirq = false;
+}
@@ -0,0 +1,39 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+/** Software interrupts, for the part of an interrupt handler's
+   work that need not be done with interrupts off.
+
+   An external interrupt handler raises a softirq with
+   softirq_raise() and returns.  Once the interrupt has been
+   acknowledged, and before the interrupted thread resumes or
+   yields, the handlers of all raised softirqs run on the same
+   CPU with interrupts turned back on, so that further interrupts
+   are taken while they work.
+
+   A softirq handler counts as interrupt context: it may not
+   sleep, and should call intr_yield_on_return() rather than
+   yield.  It may be interrupted, but never by another softirq
+   handler on the same CPU, so a handler never runs concurrently
+   with itself.  A softirq raised while the handlers run, even
+   its own, runs before they return. */
+
+/** Softirq numbers, in the order in which they run. */
+enum softirq
+  {
+    SOFTIRQ_TIMER,              /**< Timer wheel and scheduler bookkeeping. */
+    SOFTIRQ_BLOCK,              /**< Block device completions. */
+    SOFTIRQ_VIRTIO,             /**< virtio device completions. */
+    SOFTIRQ_SERIAL,             /**< Serial port input. */
+    SOFTIRQ_CNT                 /**< Number of softirqs. */
+  };
+
+typedef void softirq_func (void);
+
+void softirq_register (enum softirq, softirq_func *);
+void softirq_raise (enum softirq);
+
+/* For threads/interrupt.c. */
+void softirq_run (void);
+
+#endif /**< threads/softirq.h */
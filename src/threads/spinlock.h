@@ -0,0 +1,101 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/smp.h"
+
+/** A busy-waiting lock for mutual exclusion between CPUs.
+
+   Unlike a `struct lock', a spinlock has no owner thread and
+   never sleeps, so it may be taken in interrupt handlers and
+   with interrupts off.  It must only be held briefly.
+
+   Turning interrupts off only keeps other code on the same CPU
+   out, so each structure that several CPUs share has a spinlock
+   of its own.  Interrupts must be off while a spinlock is held,
+   or an interrupt handler that wants the same lock could spin
+   forever on its own CPU.  The usual pattern is
+
+        old_level = intr_disable ();
+        spin_acquire (&lock);
+        ...
+        spin_release (&lock);
+        intr_set_level (old_level);
+
+   A thread must not switch away, or call anything that might,
+   such as sema_up() or lock_acquire(), while holding a
+   spinlock.  thread_block_unlock() releases one as the thread
+   goes to sleep. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /**< 0 if free, 1 if held. */
+  };
+
+/** Initializer for a free spinlock. */
+#define SPINLOCK_INITIALIZER { 0 }
+
+/** Hints to the CPU that it is in a spin-wait loop.
+   See [IA32-v2b] "PAUSE". */
+static inline void
+cpu_relax (void)
+{
+  asm volatile ("pause" : : : "memory");
+}
+
+/** Initializes L as a free spinlock. */
+static inline void
+spin_init (struct spinlock *l)
+{
+  l->locked = 0;
+}
+
+/** Spins once in a loop that waits for another CPU.  Also
+   answers TLB shootdowns, because a CPU spinning with interrupts
+   off cannot take the IPI, and the CPU it waits for may be
+   waiting in turn for it to flush. */
+static inline void
+spin_wait (void)
+{
+  cpu_relax ();
+  smp_tlb_poll ();
+}
+
+/** Tries to acquire L without waiting.  Returns true if
+   successful, false if L was already held.  `xchg' with a memory
+   operand is implicitly locked, see [IA32-v2b] "XCHG". */
+static inline bool
+spin_try_acquire (struct spinlock *l)
+{
+  uint32_t old = 1;
+
+  asm volatile ("xchgl %0, %1" : "+r" (old), "+m" (l->locked) : : "memory");
+  return old == 0;
+}
+
+/** Returns true if L is currently held by some CPU. */
+static inline bool
+spin_is_locked (const struct spinlock *l)
+{
+  return l->locked != 0;
+}
+
+/** Acquires L, spinning until it becomes free. */
+static inline void
+spin_acquire (struct spinlock *l)
+{
+  while (!spin_try_acquire (l))
+    while (spin_is_locked (l))
+      spin_wait ();
+}
+
+/** Releases L.  Stores are not reordered with older stores on
+   x86, so a plain store after a compiler barrier suffices. */
+static inline void
+spin_release (struct spinlock *l)
+{
+  asm volatile ("" : : : "memory");
+  l->locked = 0;
+}
+
+#endif /**< threads/spinlock.h */
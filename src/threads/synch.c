@@ -30,8 +30,236 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
-#include "threads/malloc.h"
+
+/** Locking.
+
+   Each wait queue has a spinlock, which for a semaphore also
+   guards its value.  A waiting thread's `waitq' member is
+   guarded by its own `waitq_lock' as well, taken after the
+   queue's, so that waitq_requeue() can find the queue of a
+   thread whose priority changes.
+
+   Priority donation walks from lock to holder to lock, so the
+   holders and donations of all locks, the donations and
+   priorities of threads, and the state of readers-writer locks
+   are guarded by one spinlock, donation_lock.  It comes before
+   any wait queue's lock.  Wait queue locks come before the
+   scheduler's. */
+struct spinlock donation_lock = SPINLOCK_INITIALIZER;
+
+/** Wait queues.
+
+   `threads' holds every waiter in the order they are to be woken,
+   and `heads' holds, through their `head_elem', only the first
+   waiter of each priority present, in the same order.  Waking
+   the next thread takes it off the front of `threads', and
+   queueing a thread walks `heads', which has at most one entry
+   per priority level however many threads wait, to find the end
+   of its priority's run.
+
+   A waiter remembers the priority it was queued at, so that when
+   a donation changes its priority it can be found and moved to
+   its new place by waitq_requeue().
+
+   Except where noted, the caller must hold the queue's lock. */
+
+/** Returns the thread whose `head_elem' is E. */
+static struct thread *
+head_thread (struct list_elem *e)
+{
+  return list_entry (e, struct thread, head_elem);
+}
+
+/** Initializes Q as an empty wait queue. */
+void
+waitq_init (struct waitq *q)
+{
+  list_init (&q->threads);
+  list_init (&q->heads);
+  spin_init (&q->lock);
+}
+
+/** Returns true if no thread is waiting in Q. */
+bool
+waitq_empty (struct waitq *q)
+{
+  return list_empty (&q->threads);
+}
+
+/** Links T into Q behind every waiter of its priority or
+   higher. */
+static void
+waitq_link (struct waitq *q, struct thread *t)
+{
+  struct list_elem *e, *next;
+
+  for (e = list_begin (&q->heads); e != list_end (&q->heads); e = list_next (e))
+    if (head_thread (e)->wait_priority <= t->priority)
+      break;
+
+  t->waitq = q;
+  t->wait_priority = t->priority;
+  if (e != list_end (&q->heads) && head_thread (e)->wait_priority == t->priority)
+    {
+      /* Join the end of this priority's run. */
+      next = list_next (e);
+      list_insert (next != list_end (&q->heads)
+                   ? &head_thread (next)->elem : list_end (&q->threads),
+                   &t->elem);
+    }
+  else
+    {
+      /* Start a run for this priority. */
+      list_insert (e != list_end (&q->heads)
+                   ? &head_thread (e)->elem : list_end (&q->threads),
+                   &t->elem);
+      list_insert (e, &t->head_elem);
+    }
+}
+
+/** Unlinks T from the wait queue it is in. */
+static void
+waitq_unlink (struct thread *t)
+{
+  struct waitq *q = t->waitq;
+  struct list_elem *prev = list_prev (&t->elem);
+  struct list_elem *next = list_next (&t->elem);
+
+  ASSERT (q != NULL);
+
+  if (prev == list_head (&q->threads)
+      || list_entry (prev, struct thread, elem)->wait_priority
+         != t->wait_priority)
+    {
+      /* T heads its run.  Hand that over to the next in line. */
+      if (next != list_end (&q->threads)
+          && list_entry (next, struct thread, elem)->wait_priority
+             == t->wait_priority)
+        list_insert (&t->head_elem,
+                     &list_entry (next, struct thread, elem)->head_elem);
+      list_remove (&t->head_elem);
+    }
+  list_remove (&t->elem);
+  t->waitq = NULL;
+}
+
+/** Adds T to Q behind every waiter of its priority or higher. */
+void
+waitq_push (struct waitq *q, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&q->lock));
+
+  spin_acquire (&t->waitq_lock);
+  ASSERT (t->waitq == NULL);
+  waitq_link (q, t);
+  spin_release (&t->waitq_lock);
+}
+
+/** Removes and returns the thread to wake next from Q, which
+   must not be empty. */
+struct thread *
+waitq_pop (struct waitq *q)
+{
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&q->lock));
+  ASSERT (!waitq_empty (q));
+
+  t = list_entry (list_front (&q->threads), struct thread, elem);
+  spin_acquire (&t->waitq_lock);
+  waitq_unlink (t);
+  spin_release (&t->waitq_lock);
+  return t;
+}
+
+/** Returns the highest priority of the threads in Q, or -1 if Q
+   is empty. */
+int
+waitq_max_priority (struct waitq *q)
+{
+  if (list_empty (&q->heads))
+    return -1;
+  return list_entry (list_begin (&q->heads),
+                     struct thread, head_elem)->wait_priority;
+}
+
+/** Moves T to the place for its current priority in the wait
+   queue it is in, if any, after the priority has changed.  Takes
+   the queue's lock itself. */
+void
+waitq_requeue (struct thread *t)
+{
+  struct waitq *q;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* T's own lock keeps it in its queue, but the queue's lock
+     comes first, so only try for that and start over if it is
+     busy. */
+  for (;;)
+    {
+      spin_acquire (&t->waitq_lock);
+      q = t->waitq;
+      if (q == NULL)
+        {
+          spin_release (&t->waitq_lock);
+          return;
+        }
+      if (spin_try_acquire (&q->lock))
+        break;
+      spin_release (&t->waitq_lock);
+      spin_wait ();
+    }
+
+  if (t->priority != t->wait_priority)
+    {
+      waitq_unlink (t);
+      waitq_link (q, t);
+    }
+  spin_release (&q->lock);
+  spin_release (&t->waitq_lock);
+}
+
+/** Removes the thread to wake next from Q, which must not be
+   empty, and unblocks it.  A thread that has queued itself but
+   not blocked yet is left running; it finds in waitq_sleep()
+   that it is no longer queued. */
+static void
+waitq_wake (struct waitq *q)
+{
+  struct thread *t = waitq_pop (q);
+
+  if (t->status == THREAD_BLOCKED)
+    thread_unblock (t);
+}
+
+/** Blocks the current thread, which is in Q, until it is taken
+   out of it.  Q's lock is released while the thread sleeps and
+   held again on return. */
+static void
+waitq_sleep (struct waitq *q)
+{
+  while (thread_current ()->waitq == q)
+    {
+      thread_block_unlock (&q->lock);
+      spin_acquire (&q->lock);
+    }
+}
+
+/** Yields the CPU if a ready thread now outranks the current
+   one. */
+static void
+yield_if_outranked (void)
+{
+  if (thread_mlfqs)
+    thread_try_yiled_mlps ();
+  else
+    thread_try_yiled ();
+}
 
 /** Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -48,7 +276,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  waitq_init (&sema->waiters);
 }
 
 /** Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -67,13 +295,14 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  spin_acquire (&sema->waiters.lock);
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
-      // list_insert_ordered(&sema->waiters, &thread_current ()->elem, thread_priority_bigger, NULL);
-      thread_block ();
+      waitq_push (&sema->waiters, thread_current ());
+      waitq_sleep (&sema->waiters);
     }
   sema->value--;
+  spin_release (&sema->waiters.lock);
   intr_set_level (old_level);
 }
 
@@ -91,6 +320,7 @@ sema_try_down (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
+  spin_acquire (&sema->waiters.lock);
   if (sema->value > 0) 
     {
       sema->value--;
@@ -98,11 +328,23 @@ sema_try_down (struct semaphore *sema)
     }
   else
     success = false;
+  spin_release (&sema->waiters.lock);
   intr_set_level (old_level);
 
   return success;
 }
 
+/** Increments SEMA's value and unblocks the highest-priority
+   thread waiting for it, if any, without yielding.  The lock of
+   SEMA's waiters must be held. */
+static void
+sema_wake (struct semaphore *sema)
+{
+  if (!waitq_empty (&sema->waiters))
+    waitq_wake (&sema->waiters);
+  sema->value++;
+}
+
 /** Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -111,27 +353,14 @@ void
 sema_up (struct semaphore *sema) 
 {
   enum intr_level old_level;
-  struct thread *t;
+
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  // bool need_yiled = false;
-  
-  if (!list_empty (&sema->waiters)) {
-    struct list_elem *l = list_min (&sema->waiters, thread_priority_bigger, NULL);
-    list_remove(l);
-    t = list_entry (l, struct thread, elem);
-    // need_yiled = t->priority > thread_current()->priority;
-    thread_unblock (t);
-  }
-  sema->value++;
-  if (thread_mlfqs) {
-    thread_try_yiled_mlps();
-  } else {
-    thread_try_yiled();
-  }
-  
-
+  spin_acquire (&sema->waiters.lock);
+  sema_wake (sema);
+  spin_release (&sema->waiters.lock);
+  yield_if_outranked ();
   intr_set_level (old_level);
 }
 
@@ -194,134 +423,110 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->donation = -1;
 }
 
-
-static bool
-donate_priority_bigger (const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED) 
+/** Makes the current thread the holder of LOCK, which it has
+   just downed, and moves the donation of any threads still
+   waiting for LOCK over to it.  donation_lock and the lock of
+   LOCK's waiters must be held. */
+static void
+lock_take (struct lock *lock)
 {
-  const struct donated_priority *a = list_entry (a_, struct donated_priority, elem);
-  const struct donated_priority *b = list_entry (b_, struct donated_priority, elem);
-  
-  return a->priority > b->priority;
-}
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&donation_lock));
 
-static struct thread * 
-donate_priority (struct lock *lock) {
-  ASSERT(!thread_mlfqs);
-  enum intr_level old_level;
-  struct thread *self = thread_current();
-  struct thread *donated_t = NULL;
-
-  /** 关中断，保护lock->holder，以及thread->priority、ready_queue*/
-  old_level = intr_disable ();
-  donated_t = lock->holder;
-
-  if (self == donated_t) {
-    printf("bad donated!\n");
-  }
-
-  /** 不能自己捐给自己*/
-  ASSERT(self != donated_t);
-
-  /** 因为目标线程可能已经受到过捐赠
-   * 但是该捐赠可能会被撤回
-   * 因此只要其原始优先级较低，就进行捐赠
-  */
-  if (donated_t != NULL && donated_t->origin_priority < self->priority) {
-    struct donated_priority *donate = (struct donated_priority *)malloc(sizeof donate_priority); // 在release_donate中free
-    if (donate == NULL) {
-      PANIC("malloc failed");
-    }
-    donate->lock = lock;
-    donate->priority = self->priority;
-    list_push_back(&donated_t->donated_list, &donate->elem);
-    if (donated_t->priority < self->priority) {
-      thread_priority_change(donated_t, self->priority);
+  lock->holder = thread_current ();
+  if (!thread_mlfqs)
+    {
+      lock->donation = waitq_max_priority (&lock->semaphore.waiters);
+      thread_donation_change (lock->holder, -1, lock->donation);
     }
-  }
-
-  intr_set_level (old_level);
-  return donated_t;
 }
 
-static int max(int a, int b) {
-  return a > b ? a : b;
-}
+static void rwlock_donate (struct rwlock *, int priority);
 
-/** 收回优先级捐赠
- * 修改线程优先级到合法值
-*/
+/** Makes LOCK donate at least PRIORITY to its holder, and passes
+   any resulting rise in the holder's priority on along the chain
+   of locks that holders are waiting for, however long it is.
+   Stops as soon as a holder's priority does not change.  Each
+   lock carries its own donation, so nothing is allocated.
+   donation_lock must be held. */
 static void
-release_donate (struct lock *lock) {
-  ASSERT(!thread_mlfqs);
-  struct thread *t = thread_current();
-
-  enum intr_level old_level;
-  old_level = intr_disable ();
+donate_priority (struct lock *lock, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&donation_lock));
 
-  if ( list_empty(&t->donated_list)) {
-    intr_set_level (old_level);
-    return ;
-  }
-
-  struct list_elem *le;
-  struct donated_priority *d;
-  for (le = list_begin(&t->donated_list); le != list_end(&t->donated_list); ){
-    d = list_entry (le, struct donated_priority, elem);
-    if (d->lock == lock) {
-      struct list_elem *temp =  le;
-      le = list_next(le);
-      list_remove(temp);
-      free(d);
-    } else {
-      le = list_next(le);
+  while (lock != NULL && lock->holder != NULL && lock->donation < priority)
+    {
+      struct thread *holder = lock->holder;
+
+      ASSERT (holder != thread_current ());
+      thread_donation_change (holder, lock->donation, priority);
+      lock->donation = priority;
+      if (holder->priority != priority)
+        break;
+      if (holder->wait_rwlock != NULL)
+        {
+          rwlock_donate (holder->wait_rwlock, priority);
+          break;
+        }
+      lock = holder->wait_lock;
     }
-  }
-
-  thread_set_priority(thread_current()->origin_priority);
-  intr_set_level (old_level);
-  return ;
 }
 
 /** Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   While we wait, our priority is donated to the holder of LOCK,
+   and through it to the holders of any locks it is waiting for
+   in turn.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
+   we need to sleep.
+
+   This is sema_down() on LOCK's semaphore, except that it sleeps
+   with donation_lock held until it blocks, so that the holder
+   cannot change before our donation to it is made. */
 void
 lock_acquire (struct lock *lock)
 {
-  // struct donated_priority donate_info = {};
+  struct thread *t = thread_current ();
+  struct semaphore *sema = &lock->semaphore;
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
-  struct thread *t = thread_current();
-  if (!thread_mlfqs) {
-    t->wait_lock = lock;
-    struct thread *handle_thread = t;
 
-    for (int i = 0;
-         i < DONATE_MAX && handle_thread != NULL && handle_thread->wait_lock != NULL; i++)
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  spin_acquire (&sema->waiters.lock);
+  while (sema->value == 0)
     {
-      handle_thread = donate_priority(handle_thread->wait_lock);
+      waitq_push (&sema->waiters, t);
+      spin_release (&sema->waiters.lock);
+      if (!thread_mlfqs)
+        {
+          t->wait_lock = lock;
+          donate_priority (lock, t->priority);
+        }
+      thread_block_unlock (&donation_lock);
+      spin_acquire (&donation_lock);
+      spin_acquire (&sema->waiters.lock);
     }
-
-    t->wait_lock = lock;
-  }
-  
-  sema_down (&lock->semaphore);
-  lock->holder = t;
+  sema->value--;
   t->wait_lock = NULL;
-  // withdraw_donate(&donate_info, donated_t);
+  lock_take (lock);
+  spin_release (&sema->waiters.lock);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
 }
 
-
-
 /** Tries to acquires LOCK and returns true if successful or false
    on failure.  The lock must not already be held by the current
    thread.
@@ -331,17 +536,47 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
-  success = sema_try_down (&lock->semaphore);
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  spin_acquire (&lock->semaphore.waiters.lock);
+  success = lock->semaphore.value > 0;
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->semaphore.value--;
+      lock_take (lock);
+    }
+  spin_release (&lock->semaphore.waiters.lock);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
   return success;
 }
 
+/** Gives up LOCK, which the current thread holds, together with
+   its donation, and unblocks the waiter that gets it next,
+   without yielding.  donation_lock must be held. */
+static void
+lock_drop (struct lock *lock)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&donation_lock));
+
+  if (!thread_mlfqs)
+    {
+      thread_donation_change (lock->holder, lock->donation, -1);
+      lock->donation = -1;
+    }
+  lock->holder = NULL;
+  spin_acquire (&lock->semaphore.waiters.lock);
+  sema_wake (&lock->semaphore);
+  spin_release (&lock->semaphore.waiters.lock);
+}
+
 /** Releases LOCK, which must be owned by the current thread.
 
    An interrupt handler cannot acquire a lock, so it does not
@@ -350,15 +585,17 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-  lock->holder = NULL;
-  
-  sema_up (&lock->semaphore);
-
-  if (!thread_mlfqs)
-    release_donate(lock);
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  lock_drop (lock);
+  spin_release (&donation_lock);
+  yield_if_outranked ();
+  intr_set_level (old_level);
 }
 
 /** Returns true if the current thread holds LOCK, false
@@ -372,14 +609,6 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/** One semaphore in a list. */
-struct semaphore_elem 
-  {
-    struct list_elem elem;              /**< List element. */
-    struct semaphore semaphore;         /**< This semaphore. */
-    struct thread *t;
-  };
-
 /** Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -388,17 +617,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
-}
-
-static bool
-cond_priority_bigger (const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED) 
-{
-  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem, elem);
-  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem, elem);
-  
-  return a->t->priority > b->t->priority;
+  waitq_init (&cond->waiters);
 }
 
 /** Atomically releases LOCK and waits for COND to be signaled by
@@ -424,19 +643,28 @@ cond_priority_bigger (const struct list_elem *a_, const struct list_elem *b_,
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
-  struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
-  
-  waiter.t = thread_current();
-  sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
-  // list_insert_ordered(&cond->waiters, &waiter.elem, cond_priority_bigger, NULL);
-  lock_release (lock);
-  sema_down (&waiter.semaphore);
+
+  /* Queue up before giving up LOCK, so that a signal sent as soon
+     as another thread takes it is not missed. */
+  old_level = intr_disable ();
+  spin_acquire (&cond->waiters.lock);
+  waitq_push (&cond->waiters, thread_current ());
+  spin_release (&cond->waiters.lock);
+
+  spin_acquire (&donation_lock);
+  lock_drop (lock);
+  spin_release (&donation_lock);
+
+  spin_acquire (&cond->waiters.lock);
+  waitq_sleep (&cond->waiters);
+  spin_release (&cond->waiters.lock);
+  intr_set_level (old_level);
   lock_acquire (lock);
 }
 
@@ -450,17 +678,23 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  enum intr_level old_level;
+  bool woke;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) {
-    struct list_elem *e = list_min(&cond->waiters, cond_priority_bigger, NULL);
-    list_remove(e);
-    sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
-  }
-    
+  old_level = intr_disable ();
+  spin_acquire (&cond->waiters.lock);
+  woke = !waitq_empty (&cond->waiters);
+  if (woke)
+    waitq_wake (&cond->waiters);
+  spin_release (&cond->waiters.lock);
+  if (woke)
+    yield_if_outranked ();
+  intr_set_level (old_level);
 }
 
 /** Wakes up all threads, if any, waiting on COND (protected by
@@ -470,12 +704,504 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
    make sense to try to signal a condition variable within an
    interrupt handler. */
 void
-cond_broadcast (struct condition *cond, struct lock *lock) 
+cond_broadcast (struct condition *cond, struct lock *lock UNUSED) 
 {
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  spin_acquire (&cond->waiters.lock);
+  while (!waitq_empty (&cond->waiters))
+    waitq_wake (&cond->waiters);
+  spin_release (&cond->waiters.lock);
+  yield_if_outranked ();
+  intr_set_level (old_level);
+}
+
+/** Initializes readers-writer lock RW.  Any number of threads
+   may hold RW shared ("read") at once, or a single thread may
+   hold it exclusively ("write").
+
+   Waiting is fair to both sides.  A thread asking to read waits
+   if a writer holds RW or is waiting for it, so a stream of
+   readers cannot starve a writer.  When a writer releases RW,
+   every waiting reader is let in together before the next
+   writer, so writers cannot starve readers either.  Within each
+   side, waiters are let in by priority and then in order of
+   arrival.
+
+   Waiters donate their priority to every current holder, as for
+   locks.  Like locks, readers-writer locks are not recursive.
+   Their state is guarded by donation_lock, and their wait queues
+   by their own locks as usual. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->writer = NULL;
+  list_init (&rw->readers);
+  rw->reader_cnt = 0;
+  rw->upgrader = NULL;
+  waitq_init (&rw->read_waiters);
+  waitq_init (&rw->write_waiters);
+  rw->donation = -1;
+}
+
+/** Returns the current thread's shared hold on RW, or a null
+   pointer if it does not hold RW shared. */
+static struct rwlock_hold *
+find_read_hold (const struct rwlock *rw)
+{
+  struct thread *t = thread_current ();
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (t->read_holds[i].rwlock == rw)
+      return &t->read_holds[i];
+  return NULL;
+}
+
+/** Returns true if no thread is waiting in Q, which is one of a
+   readers-writer lock's wait queues. */
+static bool
+rwlock_queue_empty (struct waitq *q)
+{
+  bool empty;
 
-  while (!list_empty (&cond->waiters))
-    cond_signal (cond, lock);
+  spin_acquire (&q->lock);
+  empty = waitq_empty (q);
+  spin_release (&q->lock);
+  return empty;
 }
 
+/** Returns the highest priority of the threads in Q, which is one
+   of a readers-writer lock's wait queues, or -1 if Q is
+   empty. */
+static int
+rwlock_queue_max (struct waitq *q)
+{
+  int priority;
+
+  spin_acquire (&q->lock);
+  priority = waitq_max_priority (q);
+  spin_release (&q->lock);
+  return priority;
+}
+
+/** Removes and returns the thread to wake next from Q, which is
+   one of a readers-writer lock's wait queues, or returns a null
+   pointer if Q is empty. */
+static struct thread *
+rwlock_queue_pop (struct waitq *q)
+{
+  struct thread *t = NULL;
+
+  spin_acquire (&q->lock);
+  if (!waitq_empty (q))
+    t = waitq_pop (q);
+  spin_release (&q->lock);
+  return t;
+}
+
+/** Returns the highest priority of the threads waiting for RW, or
+   -1 if none is. */
+static int
+rwlock_waiters_max (struct rwlock *rw)
+{
+  int priority = rwlock_queue_max (&rw->read_waiters);
+  int writers = rwlock_queue_max (&rw->write_waiters);
+
+  if (writers > priority)
+    priority = writers;
+  if (rw->upgrader != NULL && rw->upgrader->priority > priority)
+    priority = rw->upgrader->priority;
+  return priority;
+}
+
+/** Changes the priority that holder T of some readers-writer
+   lock receives from it from OLD to PRIORITY.  If that raised T's
+   priority, passes the rise on to whatever T is waiting for. */
+static void
+rwlock_donate_to (struct thread *t, int old, int priority)
+{
+  thread_donation_change (t, old, priority);
+  if (priority > old && t->priority == priority)
+    {
+      if (t->wait_lock != NULL)
+        donate_priority (t->wait_lock, priority);
+      else if (t->wait_rwlock != NULL)
+        rwlock_donate (t->wait_rwlock, priority);
+    }
+}
+
+/** Changes the priority RW donates to each of its holders to
+   PRIORITY. */
+static void
+rwlock_set_donation (struct rwlock *rw, int priority)
+{
+  int old = rw->donation;
+  struct list_elem *e;
+
+  if (thread_mlfqs || priority == old)
+    return;
+  rw->donation = priority;
+
+  if (rw->writer != NULL)
+    rwlock_donate_to (rw->writer, old, priority);
+  for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+       e = list_next (e))
+    rwlock_donate_to (list_entry (e, struct rwlock_hold, elem)->thread,
+                      old, priority);
+}
+
+/** Makes RW donate at least PRIORITY to each of its holders. */
+static void
+rwlock_donate (struct rwlock *rw, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (rw->donation < priority)
+    rwlock_set_donation (rw, priority);
+}
+
+/** Makes T a holder of RW, shared if WRITE is false, and gives it
+   RW's current donation. */
+static void
+rwlock_add_holder (struct rwlock *rw, struct thread *t, bool write)
+{
+  if (write)
+    rw->writer = t;
+  else
+    {
+      struct rwlock_hold *hold = NULL;
+      int i;
+
+      for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+        if (t->read_holds[i].rwlock == NULL)
+          {
+            hold = &t->read_holds[i];
+            break;
+          }
+      if (hold == NULL)
+        PANIC ("thread %s holds too many readers-writer locks", t->name);
+      hold->rwlock = rw;
+      hold->thread = t;
+      list_push_back (&rw->readers, &hold->elem);
+      rw->reader_cnt++;
+    }
+  if (!thread_mlfqs)
+    thread_donation_change (t, -1, rw->donation);
+}
+
+/** Takes T off the holders of RW, and takes back RW's
+   donation. */
+static void
+rwlock_remove_holder (struct rwlock *rw, struct thread *t)
+{
+  if (rw->writer == t)
+    rw->writer = NULL;
+  else
+    {
+      struct rwlock_hold *hold = NULL;
+      int i;
+
+      for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+        if (t->read_holds[i].rwlock == rw)
+          hold = &t->read_holds[i];
+      ASSERT (hold != NULL);
+      list_remove (&hold->elem);
+      hold->rwlock = NULL;
+      rw->reader_cnt--;
+    }
+  if (!thread_mlfqs)
+    thread_donation_change (t, rw->donation, -1);
+}
+
+/** Hands RW to T, which has been waiting for it, and wakes T. */
+static void
+rwlock_grant (struct rwlock *rw, struct thread *t, bool write)
+{
+  t->wait_rwlock = NULL;
+  rwlock_add_holder (rw, t, write);
+  thread_unblock (t);
+}
+
+/** Lets in whichever waiters RW's state now allows: a waiting
+   upgrader once it is the only reader, otherwise the next writer
+   once RW is free.  If READERS_FIRST, a writer has just let go,
+   so every waiting reader goes first.  Then brings RW's donation
+   in line with the threads still waiting. */
+static void
+rwlock_wake (struct rwlock *rw, bool readers_first)
+{
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (rw->writer == NULL)
+    {
+      if (rw->upgrader != NULL)
+        {
+          if (rw->reader_cnt == 1)
+            {
+              t = rw->upgrader;
+              rw->upgrader = NULL;
+              rwlock_remove_holder (rw, t);
+              rwlock_grant (rw, t, true);
+            }
+        }
+      else if (readers_first && !rwlock_queue_empty (&rw->read_waiters))
+        while ((t = rwlock_queue_pop (&rw->read_waiters)) != NULL)
+          rwlock_grant (rw, t, false);
+      else if (rw->reader_cnt == 0
+               && (t = rwlock_queue_pop (&rw->write_waiters)) != NULL)
+        rwlock_grant (rw, t, true);
+    }
+  rwlock_set_donation (rw, rwlock_waiters_max (rw));
+}
+
+/** Blocks the current thread in Q, or as RW's upgrader if Q is
+   null, until another thread hands it RW, donating its priority
+   to RW's holders meanwhile.  Interrupts must be off and
+   donation_lock held; it is released while the thread sleeps. */
+static void
+rwlock_wait (struct rwlock *rw, struct waitq *q)
+{
+  struct thread *t = thread_current ();
+
+  t->wait_rwlock = rw;
+  if (q != NULL)
+    {
+      spin_acquire (&q->lock);
+      waitq_push (q, t);
+      spin_release (&q->lock);
+    }
+  else
+    rw->upgrader = t;
+  if (!thread_mlfqs)
+    rwlock_donate (rw, t->priority);
+  thread_block_unlock (&donation_lock);
+  spin_acquire (&donation_lock);
+  ASSERT (t->wait_rwlock == NULL);
+}
+
+/** Makes the current thread a shared holder of RW if no writer
+   holds it or is waiting for it.  Returns true if successful.
+   donation_lock must be held. */
+static bool
+rwlock_take_read (struct rwlock *rw)
+{
+  bool success = (rw->writer == NULL && rw->upgrader == NULL
+                  && rwlock_queue_empty (&rw->write_waiters));
+  if (success)
+    rwlock_add_holder (rw, thread_current (), false);
+  return success;
+}
+
+/** Makes the current thread the exclusive holder of RW if no
+   thread holds it or is waiting for it.  Returns true if
+   successful.  donation_lock must be held. */
+static bool
+rwlock_take_write (struct rwlock *rw)
+{
+  bool success = (rw->writer == NULL && rw->reader_cnt == 0
+                  && rwlock_queue_empty (&rw->read_waiters)
+                  && rwlock_queue_empty (&rw->write_waiters));
+  if (success)
+    rwlock_add_holder (rw, thread_current (), true);
+  return success;
+}
+
+/** Acquires RW shared, sleeping until no writer holds it or is
+   waiting for it if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_read (rw) && !rwlock_held_for_write (rw));
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  if (!rwlock_take_read (rw))
+    rwlock_wait (rw, &rw->read_waiters);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
+}
+
+/** Tries to acquire RW shared without sleeping.  Returns true if
+   successful, false if a writer holds RW or is waiting for it. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  success = rwlock_take_read (rw);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
+  return success;
+}
+
+/** Releases RW, which the current thread holds shared. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_read (rw));
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  rwlock_remove_holder (rw, thread_current ());
+  rwlock_wake (rw, false);
+  spin_release (&donation_lock);
+  yield_if_outranked ();
+  intr_set_level (old_level);
+}
+
+/** Acquires RW exclusively, sleeping until no other thread holds
+   it if necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_read (rw) && !rwlock_held_for_write (rw));
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  if (!rwlock_take_write (rw))
+    rwlock_wait (rw, &rw->write_waiters);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
+}
+
+/** Tries to acquire RW exclusively without sleeping.  Returns true
+   if successful, false if any thread holds RW or is waiting for
+   it. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  success = rwlock_take_write (rw);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
+  return success;
+}
+
+/** Releases RW, which the current thread holds exclusively. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  rwlock_remove_holder (rw, thread_current ());
+  rwlock_wake (rw, true);
+  spin_release (&donation_lock);
+  yield_if_outranked ();
+  intr_set_level (old_level);
+}
+
+/** Turns the current thread's shared hold on RW into an exclusive
+   one, sleeping until the other readers have released RW if
+   necessary.  Waits ahead of any thread waiting to write.
+
+   Two readers cannot both wait for the other to leave, so if
+   another thread is already upgrading, returns false at once,
+   still holding RW shared; the caller should then release RW and
+   acquire it for writing.  Otherwise returns true. */
+bool
+rwlock_upgrade (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success = true;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rwlock_held_for_read (rw));
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  if (rw->upgrader != NULL)
+    success = false;
+  else if (rw->reader_cnt == 1)
+    {
+      rwlock_remove_holder (rw, thread_current ());
+      rwlock_add_holder (rw, thread_current (), true);
+    }
+  else
+    rwlock_wait (rw, NULL);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
+  return success;
+}
+
+/** Turns the current thread's exclusive hold on RW into a shared
+   one, and lets in every thread waiting to read. */
+void
+rwlock_downgrade (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  old_level = intr_disable ();
+  spin_acquire (&donation_lock);
+  rwlock_remove_holder (rw, thread_current ());
+  rwlock_add_holder (rw, thread_current (), false);
+  rwlock_wake (rw, true);
+  spin_release (&donation_lock);
+  yield_if_outranked ();
+  intr_set_level (old_level);
+}
+
+/** Returns true if the current thread holds RW shared. */
+bool
+rwlock_held_for_read (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return find_read_hold (rw) != NULL;
+}
+
+/** Returns true if the current thread holds RW exclusively. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
@@ -3,12 +3,34 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include "threads/spinlock.h"
+
+struct thread;
+
+/** Queue of threads waiting on a semaphore or condition variable,
+   highest priority first and first-come first-served within a
+   priority.  Stays ordered when a waiter's priority changes. */
+struct waitq
+  {
+    struct list threads;        /**< All waiting threads, in wake-up order. */
+    struct list heads;          /**< First thread of each priority present. */
+    struct spinlock lock;       /**< Guards the queue. */
+  };
+
+void waitq_init (struct waitq *);
+bool waitq_empty (struct waitq *);
+void waitq_push (struct waitq *, struct thread *);
+struct thread *waitq_pop (struct waitq *);
+int waitq_max_priority (struct waitq *);
+void waitq_requeue (struct thread *);
+
+extern struct spinlock donation_lock;
 
 /** A counting semaphore. */
 struct semaphore 
   {
-    unsigned value;             /**< Current value. */
-    struct list waiters;        /**< List of waiting threads. */
+    unsigned value;             /**< Current value, guarded by waiters.lock. */
+    struct waitq waiters;       /**< Waiting threads. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -22,6 +44,7 @@ struct lock
   {
     struct thread *holder;      /**< Thread holding lock (for debugging). */
     struct semaphore semaphore; /**< Binary semaphore controlling access. */
+    int donation;               /**< Priority donated to holder, or -1. */
   };
 
 void lock_init (struct lock *);
@@ -33,7 +56,7 @@ bool lock_held_by_current_thread (const struct lock *);
 /** Condition variable. */
 struct condition 
   {
-    struct list waiters;        /**< List of waiting threads. */
+    struct waitq waiters;       /**< Waiting threads. */
   };
 
 void cond_init (struct condition *);
@@ -41,6 +64,42 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/** Maximum number of readers-writer locks a thread may hold
+   shared at once. */
+#define RWLOCK_HOLD_MAX 4
+
+/** Readers-writer lock. */
+struct rwlock
+  {
+    struct thread *writer;      /**< Thread holding it exclusively, or NULL. */
+    struct list readers;        /**< Holds of threads holding it shared. */
+    int reader_cnt;             /**< Number of threads holding it shared. */
+    struct thread *upgrader;    /**< Reader waiting to upgrade, or NULL. */
+    struct waitq read_waiters;  /**< Threads waiting to hold it shared. */
+    struct waitq write_waiters; /**< Threads waiting to hold it exclusively. */
+    int donation;               /**< Priority donated to each holder, or -1. */
+  };
+
+/** A thread's shared hold on a readers-writer lock. */
+struct rwlock_hold
+  {
+    struct rwlock *rwlock;      /**< Lock held shared, or NULL if unused. */
+    struct thread *thread;      /**< Thread holding it. */
+    struct list_elem elem;      /**< Element in the lock's `readers'. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_upgrade (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_for_read (const struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /** Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -7,7 +7,10 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/kstack.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -25,20 +28,47 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/** List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-static struct list mlps_ready_list[PRI_MAX + 1];
+/** Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   Shared by the priority scheduler and the 4.4BSD scheduler.
+   There is one FIFO list per priority level, and bit P of
+   `nonempty' is set exactly when levels[P] holds a thread, so
+   the highest ready priority is found with one bit scan instead
+   of walking the levels or keeping a sorted list.
+
+   Each CPU has its own run queue.  A thread is queued on the CPU
+   it last ran on, and a CPU that finds a higher priority or a
+   clearly longer queue elsewhere steals from it, so the highest
+   priority ready thread is always picked first.
+
+   Each queue has its own lock, which also guards its CPU's `cur'
+   against the thread switches of that CPU.  A CPU that steals
+   takes its own queue's lock and the other queue's, the lower
+   CPU's first.  A queued thread whose `on_cpu' is still set is
+   being switched away from by the CPU it is queued on, which is
+   the only one that may pick it until it is done.
+
+   The completely fair scheduler ignores the levels and instead
+   keeps the queue's threads in `timeline', ordered by virtual
+   runtime, and always runs the leftmost one. */
+struct ready_queue
+  {
+    struct list levels[PRI_MAX + 1];    /**< FIFO of threads per priority. */
+    uint64_t nonempty;                  /**< Bit P set iff levels[P] is non-empty. */
+    int cnt;                            /**< Number of threads queued. */
+    struct rb_tree timeline;            /**< CFS: threads by vruntime. */
+    int64_t min_vruntime;               /**< CFS: never decreasing vruntime floor. */
+    int64_t load;                       /**< CFS: sum of queued threads' weights. */
+    struct spinlock lock;               /**< Guards all of the above. */
+  };
 
-static int ready_thread_num;
+static struct ready_queue ready_queues[CPU_MAX];
 
 /** List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
-
-/** Idle thread. */
-static struct thread *idle_thread;
+static struct spinlock all_lock;        /**< Guards all_list. */
 
 /** Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -48,6 +78,18 @@ static struct lock tid_lock;
 
 static fp load_avg;
 
+/** Recent per-second recent_cpu decay coefficients,
+   (2*load_avg)/(2*load_avg + 1), indexed by second modulo
+   DECAY_HISTORY.  Only used with BSD4.4.
+
+   Each second only the running thread and the threads on the
+   ready queue are decayed.  A blocked thread is brought up to
+   date by thread_unblock(), which replays the coefficients
+   recorded since it blocked. */
+#define DECAY_HISTORY 64                /**< Must be a power of two. */
+static fp decay_history[DECAY_HISTORY];
+static int64_t decay_seconds;           /**< # of per-second decays so far. */
+
 /** Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -63,13 +105,72 @@ static long long user_ticks;    /**< # of timer ticks in user programs. */
 
 /** Scheduling. */
 #define TIME_SLICE 4            /**< # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /**< # of timer ticks since last yield. */
+
+/** Completely fair scheduling.
+
+   Each thread is charged virtual runtime for every tick it runs,
+   scaled by NICE_0_WEIGHT over its weight, so that over time
+   every thread gets CPU in proportion to its weight.  A thread's
+   slice is its share of CFS_LATENCY, the period in which every
+   ready thread should get to run once, stretched so that no
+   slice is shorter than CFS_MIN_GRANULARITY. */
+#define NSEC_PER_TICK (1000000000 / TIMER_FREQ)
+#define NICE_0_WEIGHT 1024              /**< Weight of a thread at nice 0. */
+#define CFS_LATENCY 8                   /**< Target scheduling period, in ticks. */
+#define CFS_MIN_GRANULARITY 1           /**< Shortest slice, in ticks. */
+#define CFS_WAKEUP_GRANULARITY \
+  ((int64_t) NSEC_PER_TICK)             /**< vruntime lead a waker needs to preempt. */
+#define CFS_SLEEPER_CREDIT \
+  ((int64_t) CFS_LATENCY * NSEC_PER_TICK / 2) /**< Most vruntime a sleeper keeps. */
+
+/** Weight of each nice value from NICE_MIN to NICE_MAX.  Each
+   step is about 1.25 times the next, so that one thread that is
+   one nice level nicer than another gets about 10% less CPU. */
+static const int nice_weights[NICE_MAX - NICE_MIN + 1] =
+  {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548, 7620, 6100, 4904, 3906,
+    /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+    /*   0 */ 1024, 820, 655, 526, 423,
+    /*   5 */ 335, 272, 215, 172, 137,
+    /*  10 */ 110, 87, 70, 56, 45,
+    /*  15 */ 36, 29, 23, 18, 15,
+    /*  20 */ 12,
+  };
+
+/** Deadline scheduling.
+
+   A thread in the deadline class asks for RUNTIME ticks of CPU
+   in every PERIOD ticks, to be had within DEADLINE ticks of the
+   start of the period.  Ready deadline threads run before all
+   other threads, earliest absolute deadline first, from one
+   timeline shared by all CPUs.  A thread that uses up its
+   runtime is throttled, that is, kept off the CPU until its next
+   period, so that one that overruns cannot make the others miss
+   their deadlines.  Threads are admitted only while the sum of
+   their utilisations, RUNTIME / PERIOD, is at most one CPU's
+   worth, which is what EDF needs to meet every deadline. */
+#define DL_BW_SHIFT 20
+#define DL_BW_ONE ((int64_t) 1 << DL_BW_SHIFT) /**< Utilisation of one CPU. */
+
+static struct rb_tree dl_timeline;      /**< Ready deadline threads. */
+static int dl_cnt;                      /**< Number of threads on dl_timeline. */
+static int64_t dl_total_bw;             /**< Sum of admitted dl_bw. */
+
+/** Guards the deadline state above and the dl_* members of every
+   thread.  Taken before any ready queue's lock. */
+static struct spinlock dl_lock;
 
 /** If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/** If true, use the completely fair scheduler.
+   Controlled by kernel command-line option "-cfs". */
+bool thread_cfs;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -82,8 +183,43 @@ static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
-static int curr_maximum_pri();
+static int curr_maximum_pri (void);
+static int mask_max (uint64_t mask);
+static int ready_queue_max (const struct ready_queue *q);
+static bool is_idle (const struct thread *t);
+static void idle_loop (void) NO_RETURN;
+static void kick_cpu_for (struct thread *t);
+static struct spinlock *queue_lock_of (const struct thread *t);
+static struct spinlock *thread_queue_lock (const struct thread *t);
+static void lock_queue_pair (struct ready_queue *a, struct ready_queue *b);
+static void unlock_queue_pair (struct ready_queue *a, struct ready_queue *b);
+static struct thread *queue_front (struct ready_queue *q);
+static bool should_steal (struct ready_queue *own, struct ready_queue *q);
+static int ready_thread_count (void);
+static void change_priority (struct thread *t, int new_priority);
 static void insert_thread_to_ready_queue(struct thread *cur);
+static void remove_thread_from_ready_queue (struct thread *t);
+static void thread_catch_up_decay (struct thread *t);
+static int cacl_priority (int nice, fp recent_cpu);
+static int cfs_weight (const struct thread *t);
+static rb_less_func vruntime_less;
+static struct thread *timeline_first (const struct ready_queue *q);
+static int64_t cfs_charge (const struct thread *t, int ticks);
+static unsigned cfs_slice (const struct thread *t, const struct ready_queue *q);
+static void cfs_tick (struct thread *t);
+static bool cfs_should_preempt (const struct ready_queue *q,
+                                const struct thread *cur);
+static void cfs_place (struct thread *t, bool initial);
+static void update_min_vruntime (struct ready_queue *q, const struct thread *cur);
+static bool is_deadline (const struct thread *t);
+static rb_less_func deadline_less;
+static struct thread *dl_first (void);
+static bool dl_runs_before (const struct thread *a, const struct thread *b);
+static bool dl_should_preempt (const struct thread *cur);
+static void dl_tick (struct thread *t);
+static void dl_throttle (struct thread *t);
+static timeout_func dl_replenish;
+static void dl_wakeup (struct thread *t);
 
 /** Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -104,20 +240,33 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
 
-  for (int i = PRI_MIN; i <= PRI_MAX; i++) {
-    list_init(&mlps_ready_list[i]);
+  for (int c = 0; c < CPU_MAX; c++) {
+    for (int i = PRI_MIN; i <= PRI_MAX; i++) {
+      list_init(&ready_queues[c].levels[i]);
+    }
+    ready_queues[c].nonempty = 0;
+    ready_queues[c].cnt = 0;
+    rb_init (&ready_queues[c].timeline, vruntime_less, NULL);
+    ready_queues[c].min_vruntime = 0;
+    ready_queues[c].load = 0;
+    spin_init (&ready_queues[c].lock);
   }
+  rb_init (&dl_timeline, deadline_less, NULL);
+  dl_cnt = 0;
+  dl_total_bw = 0;
+  spin_init (&dl_lock);
 
   list_init (&all_list);
+  spin_init (&all_lock);
 
-  ready_thread_num = 0;
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT, 0, 0);
   initial_thread->status = THREAD_RUNNING;
-  // ready_thread_num++;
+  initial_thread->cpu = &cpus[0];
+  initial_thread->on_cpu = true;
+  cpus[0].cur = initial_thread;
   initial_thread->tid = allocate_tid ();
 }
 
@@ -144,9 +293,10 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *c = t->cpu;
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (is_idle (t))
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -156,8 +306,29 @@ thread_tick (void)
     kernel_ticks++;
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  c->thread_ticks++;
+  if (is_deadline (t))
+    dl_tick (t);
+  else if (thread_cfs)
+    cfs_tick (t);
+  else if (c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
+
+  /* The boot CPU's 4.4BSD bookkeeping is done by the timer
+     interrupt handler.  Other CPUs charge their own running
+     thread, and recompute its priority as often. */
+  if (thread_mlfqs && c != &cpus[0] && !is_idle (t)) {
+    struct ready_queue *q = &ready_queues[c->id];
+
+    /* The boot CPU decays this thread, too, once a second. */
+    spin_acquire (&q->lock);
+    t->recent_cpu = add_int(t->recent_cpu, 1);
+    if (c->thread_ticks % PRIORITY_UPDATE_FRE == 0)
+      t->priority = cacl_priority(t->nice, t->recent_cpu);
+    spin_release (&q->lock);
+    if (c->thread_ticks % PRIORITY_UPDATE_FRE == 0)
+      thread_try_yiled_mlps();
+  }
 }
 
 /** Prints thread statistics. */
@@ -168,32 +339,30 @@ thread_print_stats (void)
           idle_ticks, kernel_ticks, user_ticks);
 }
 
-bool
-thread_priority_bigger (const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED) 
-{
-  const struct thread *a = list_entry (a_, struct thread, elem);
-  const struct thread *b = list_entry (b_, struct thread, elem);
-  
-  return a->priority > b->priority;
-}
-
 /** Yiled when thread priority is not the highest */
 void
 thread_try_yiled(void)
 {
   ASSERT(!thread_mlfqs);
   const struct thread *t = thread_current();
-  if ( !list_empty (&ready_list) ) {
-    enum intr_level old_level = intr_disable();
-    bool need_yiled = list_entry (list_front (&ready_list), struct thread, elem)->priority >= t->priority;
-    intr_set_level(old_level);
-    if (need_yiled) {
-      if (!intr_context()) {
-        thread_yield();
-      } else {
-        intr_yield_on_return();
-      }
+  enum intr_level old_level = intr_disable();
+  bool need_yiled;
+  if (is_deadline (t) || !rb_empty (&dl_timeline))
+    need_yiled = dl_should_preempt (t);
+  else if (thread_cfs) {
+    struct ready_queue *q = &ready_queues[t->cpu->id];
+    spin_acquire (&q->lock);
+    need_yiled = cfs_should_preempt (q, t);
+    spin_release (&q->lock);
+  }
+  else
+    need_yiled = curr_maximum_pri() >= t->priority;
+  intr_set_level(old_level);
+  if (need_yiled) {
+    if (!intr_context()) {
+      thread_yield();
+    } else {
+      intr_yield_on_return();
     }
   }
 }
@@ -204,8 +373,14 @@ thread_try_yiled_mlps(void)
   /** wait for impl*/
   ASSERT(thread_mlfqs);
   const struct thread *t = thread_current();
-  int pri = curr_maximum_pri();
-  if (pri > t->priority) {
+  enum intr_level old_level = intr_disable();
+  bool need_yiled;
+  if (is_deadline (t) || !rb_empty (&dl_timeline))
+    need_yiled = dl_should_preempt (t);
+  else
+    need_yiled = curr_maximum_pri() > t->priority;
+  intr_set_level(old_level);
+  if (need_yiled) {
     // enum intr_level old_level = intr_disable();
     if (!intr_context()) {
         thread_yield();
@@ -238,12 +413,13 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = kstack_alloc ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -251,12 +427,13 @@ thread_create (const char *name, int priority,
   /* Initialize thread. */
   init_thread (t, name, priority, thread_current()->nice, thread_current()->recent_cpu);
   tid = t->tid =  allocate_tid ();
+  t->cpu = thread_current ()->cpu;
 
 #ifdef USERPROG
   /** TODO: Free the child_self in exit func When father thread end before the child thread*/
   t->child_self = malloc(sizeof(struct child_thread));
   if (t->child_self == NULL) {
-    palloc_free_page(t);
+    kstack_free (t);
     return TID_ERROR;
   }
   sema_init(&t->child_self->exit_sema, 0);
@@ -293,6 +470,15 @@ supplemental_page_table_init(&t->spt, t);
 // #endif
 
   /* Add to run queue. */
+  if (thread_cfs) {
+    struct spinlock *l;
+
+    old_level = intr_disable ();
+    l = thread_queue_lock (t);
+    cfs_place (t, true);
+    spin_release (l);
+    intr_set_level (old_level);
+  }
   thread_unblock (t);
   if (thread_mlfqs) {
     thread_try_yiled_mlps();
@@ -313,14 +499,26 @@ supplemental_page_table_init(&t->spt, t);
 void
 thread_block (void) 
 {
+  thread_block_unlock (NULL);
+}
+
+/** Like thread_block(), but first releases spinlock L, if it is
+   non-null, which the caller holds.  The thread is marked blocked
+   before L is released, so whoever takes L next and finds the
+   thread waiting may unblock it at once, even before it has
+   finished switching away. */
+void
+thread_block_unlock (struct spinlock *l)
+{
+  struct thread *cur = thread_current ();
+
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
-  if (thread_current() != idle_thread) {
-    ready_thread_num--;
-  }
-  thread_current ()->status = THREAD_BLOCKED;
-  
-  
+
+  cur->status = THREAD_BLOCKED;
+  cur->decay_stamp = decay_seconds;
+  if (l != NULL)
+    spin_release (l);
   schedule ();
 }
 
@@ -336,22 +534,27 @@ void
 thread_unblock (struct thread *t) 
 {
   enum intr_level old_level;
+  struct spinlock *l;
 
   ASSERT (is_thread (t));
 
   old_level = intr_disable ();
+  l = thread_queue_lock (t);
   ASSERT (t->status == THREAD_BLOCKED);
-  // list_push_back (&ready_list, &t->elem);
-  // list_insert_ordered(&ready_list, &t->elem, thread_priority_bigger, NULL);
+  if (thread_mlfqs) {
+    thread_catch_up_decay(t);
+    t->priority = cacl_priority(t->nice, t->recent_cpu);
+  }
+  if (is_deadline (t))
+    dl_wakeup (t);
+  else if (thread_cfs)
+    cfs_place (t, false);
   insert_thread_to_ready_queue(t);
   t->status = THREAD_READY;
-  if (t != idle_thread) {
-    ready_thread_num++;
-  }
-  
+  if (cpu_cnt > 1)
+    kick_cpu_for (t);
+  spin_release (l);
   intr_set_level (old_level);
-
-  
 }
 
 /** Returns the name of the running thread. */
@@ -397,18 +600,22 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  if (is_deadline (thread_current ()))
+    thread_set_deadline (0, 0, 0);
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  spin_acquire (&all_lock);
   list_remove (&thread_current()->allelem);
+  spin_release (&all_lock);
   thread_current ()->status = THREAD_DYING;
-  ready_thread_num--;
   schedule ();
   NOT_REACHED ();
 }
 
+#ifdef USERPROG
 void
 thread_exit_with_status(int status) 
 {
@@ -416,24 +623,154 @@ thread_exit_with_status(int status)
   t->child_self->exit_status = status;
   thread_exit();
 }
+#endif
 
+/** Appends CUR to the back of the level for its current
+   priority in the ready queue of the CPU it last ran on.
+   Threads of equal priority are therefore run in FIFO order.
+   Under CFS, inserts CUR into the queue's timeline instead, after
+   any threads with the same vruntime.  A deadline thread goes on
+   the shared deadline timeline whatever the scheduler.  The
+   queue's lock must be held, see thread_queue_lock(). */
 static void 
 insert_thread_to_ready_queue(struct thread *cur) {
   ASSERT(intr_get_level() == INTR_OFF);
-  if (cur == idle) {
+  ASSERT(PRI_MIN <= cur->priority && cur->priority <= PRI_MAX);
+  if (is_idle (cur)) {
+    return ;
+  }
+  ASSERT (spin_is_locked (queue_lock_of (cur)));
+  if (is_deadline (cur)) {
+    rb_insert (&dl_timeline, &cur->dl_node);
+    dl_cnt++;
+    return ;
+  }
+  struct ready_queue *q = &ready_queues[cur->cpu->id];
+  if (thread_cfs) {
+    rb_insert (&q->timeline, &cur->cfs_node);
+    q->load += cfs_weight (cur);
+    q->cnt++;
+    return ;
+  }
+  list_push_back(&q->levels[cur->priority], &cur->elem);
+  q->nonempty |= (uint64_t) 1 << cur->priority;
+  q->cnt++;
+}
+
+/** Removes ready thread T from the ready queue.  Must be called
+   before T's priority is changed, because T's level is found
+   from its priority.  The queue's lock must be held. */
+static void
+remove_thread_from_ready_queue (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (spin_is_locked (queue_lock_of (t)));
+
+  if (is_deadline (t)) {
+    rb_remove (&dl_timeline, &t->dl_node);
+    dl_cnt--;
     return ;
   }
-  if (!thread_mlfqs) {
-    list_insert_ordered(&ready_list, &cur->elem, thread_priority_bigger, NULL);
+  struct ready_queue *q = &ready_queues[t->cpu->id];
+  if (thread_cfs) {
+    rb_remove (&q->timeline, &t->cfs_node);
+    q->load -= cfs_weight (t);
+    q->cnt--;
     return ;
   }
-  // struct list *elem_ = list_end (&mlps_ready_list[cur->priority]);
-  // if ( !(is_interior (elem_) || is_tail (elem_))) {
-  //   // printf("bad!\n");
-  //   int a = 1;
-  //   thread_tid();
-  // }
-  list_push_back(&mlps_ready_list[cur->priority], &cur->elem);
+  list_remove (&t->elem);
+  if (list_empty (&q->levels[t->priority]))
+    q->nonempty &= ~((uint64_t) 1 << t->priority);
+  q->cnt--;
+}
+
+/** On a multiprocessor, makes sure that some CPU notices that T
+   has become ready: an idle CPU is woken to steal it, or else
+   the CPU whose queue T is on is told to reschedule if it is
+   running something of lower priority.  The lock of T's queue
+   must be held, which keeps the thread that CPU is running from
+   going away while we look at it. */
+static void
+kick_cpu_for (struct thread *t)
+{
+  struct cpu *self = running_thread ()->cpu;
+  struct ready_queue *q = &ready_queues[t->cpu->id];
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++) {
+    struct cpu *c = &cpus[i];
+    if (c != self && c->cur == c->idle_thread) {
+      smp_send_reschedule (c);
+      return ;
+    }
+  }
+  if (t->cpu == self)
+    return ;
+  if (is_deadline (t))
+    {
+      bool preempt;
+
+      spin_acquire (&q->lock);
+      preempt = dl_runs_before (t, t->cpu->cur);
+      spin_release (&q->lock);
+      if (preempt)
+        smp_send_reschedule (t->cpu);
+    }
+  else if (thread_cfs
+           ? cfs_should_preempt (q, t->cpu->cur)
+           : t->cpu->cur->priority < t->priority)
+    smp_send_reschedule (t->cpu);
+}
+
+/** Returns the lock that guards the queue T is on, or would be
+   put on if it became ready. */
+static struct spinlock *
+queue_lock_of (const struct thread *t)
+{
+  return is_deadline (t) ? &dl_lock : &ready_queues[t->cpu->id].lock;
+}
+
+/** Acquires and returns the lock of the queue that T is on, or
+   would be put on if it became ready.  T may move to another CPU
+   until the lock is held, so the choice is checked again once it
+   is.  Interrupts must be off. */
+static struct spinlock *
+thread_queue_lock (const struct thread *t)
+{
+  for (;;) {
+    struct spinlock *l = queue_lock_of (t);
+    spin_acquire (l);
+    if (l == queue_lock_of (t))
+      return l;
+    spin_release (l);
+  }
+}
+
+/** Acquires the locks of queues A and B, which may be the same,
+   that of the lower CPU first, so that two CPUs stealing from
+   each other cannot deadlock. */
+static void
+lock_queue_pair (struct ready_queue *a, struct ready_queue *b)
+{
+  if (a == b) {
+    spin_acquire (&a->lock);
+  } else if (a < b) {
+    spin_acquire (&a->lock);
+    spin_acquire (&b->lock);
+  } else {
+    spin_acquire (&b->lock);
+    spin_acquire (&a->lock);
+  }
+}
+
+/** Releases the locks taken by lock_queue_pair(A, B). */
+static void
+unlock_queue_pair (struct ready_queue *a, struct ready_queue *b)
+{
+  if (a != b)
+    spin_release (&b->lock);
+  spin_release (&a->lock);
 }
 
 
@@ -448,15 +785,35 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    insert_thread_to_ready_queue(cur);
-  cur->status = THREAD_READY;
+  if (is_deadline (cur))
+    {
+      spin_acquire (&dl_lock);
+      if (cur->dl_throttled)
+        {
+          /* Out of budget.  dl_replenish() wakes us up. */
+          cur->dl_parked = true;
+          thread_block_unlock (&dl_lock);
+          intr_set_level (old_level);
+          return ;
+        }
+      spin_release (&dl_lock);
+    }
+  if (!is_idle (cur)) 
+    {
+      struct spinlock *l = thread_queue_lock (cur);
+      insert_thread_to_ready_queue(cur);
+      cur->status = THREAD_READY;
+      spin_release (l);
+    }
+  else
+    cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
 }
 
 /** Invoke function 'func' on all threads, passing along 'aux'.
-   This function must be called with interrupts off. */
+   This function must be called with interrupts off.  FUNC runs
+   with all_lock held, so it must not sleep. */
 void
 thread_foreach (thread_action_func *func, void *aux)
 {
@@ -464,16 +821,24 @@ thread_foreach (thread_action_func *func, void *aux)
 
   ASSERT (intr_get_level () == INTR_OFF);
 
+  spin_acquire (&all_lock);
   for (e = list_begin (&all_list); e != list_end (&all_list);
        e = list_next (e))
     {
       struct thread *t = list_entry (e, struct thread, allelem);
       func (t, aux);
     }
+  spin_release (&all_lock);
 }
 
-static int max(int a, int b) {
-  return a > b ? a : b;
+/** Returns T's priority including donations: the larger of the
+   priority it set itself and the highest priority donated to it
+   through the locks it holds. */
+static int
+effective_priority (const struct thread *t)
+{
+  int donated = mask_max (t->donor_mask);
+  return donated > t->origin_priority ? donated : t->origin_priority;
 }
 
 /** Sets the current thread's priority to NEW_PRIORITY. */
@@ -482,19 +847,13 @@ thread_set_priority (int new_priority)
 {
   ASSERT(!thread_mlfqs);
   struct thread *t = thread_current();
+  enum intr_level old_level = intr_disable ();
+
+  spin_acquire (&donation_lock);
   t->origin_priority = new_priority;
-  t->priority = new_priority;
-
-  if (!list_empty(&t->donated_list)) {
-    int max_priority = new_priority;
-    struct list_elem *e;
-    struct donated_priority *d;
-    for (e = list_begin (&t->donated_list); e != list_end (&t->donated_list); e = list_next(e)) {
-      d = list_entry (e, struct donated_priority, elem);
-      max_priority = max(d->priority, max_priority);
-    }
-    t->priority = max_priority;
-  }
+  t->priority = effective_priority (t);
+  spin_release (&donation_lock);
+  intr_set_level (old_level);
 
   thread_try_yiled();
 }
@@ -514,15 +873,145 @@ thread_priority_change (struct thread *t, int new_priority)
 {
   ASSERT(!thread_mlfqs);
   ASSERT (intr_get_level () == INTR_OFF);
-  t->priority = new_priority;
+  change_priority (t, new_priority);
+}
+
+/** Sets T's priority to NEW_PRIORITY and moves it to its new
+   place in the ready queue or wait queue it is on, if any. */
+static void
+change_priority (struct thread *t, int new_priority)
+{
+  struct spinlock *l = thread_queue_lock (t);
+
   if (t->status == THREAD_READY) {
-    // list_sort(&ready_list, thread_priority_bigger, NULL);
-    list_remove(&t->elem);
-    list_insert_ordered(&ready_list, &t->elem, thread_priority_bigger, NULL);
+    remove_thread_from_ready_queue(t);
+    t->priority = new_priority;
+    insert_thread_to_ready_queue(t);
+  } else {
+    t->priority = new_priority;
   }
+  spin_release (l);
+  waitq_requeue (t);
+}
+
+/** Records that a lock T holds now donates NEW_PRIORITY instead
+   of OLD_PRIORITY, either of which may be -1 for no donation,
+   and updates T's priority to match.
+
+   T keeps a count of the locks it holds for each donated
+   priority, with a mask of the non-zero counts like a run
+   queue's, so this is O(1) however many locks T holds. */
+void
+thread_donation_change (struct thread *t, int old_priority, int new_priority)
+{
+  int priority;
+
+  ASSERT(!thread_mlfqs);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&donation_lock));
+
+  if (old_priority >= 0 && --t->donor_cnt[old_priority] == 0)
+    t->donor_mask &= ~((uint64_t) 1 << old_priority);
+  if (new_priority >= 0 && t->donor_cnt[new_priority]++ == 0)
+    t->donor_mask |= (uint64_t) 1 << new_priority;
+
+  priority = effective_priority (t);
+  if (priority != t->priority)
+    thread_priority_change (t, priority);
+}
+
+/** Puts the current thread in the deadline class, to get RUNTIME
+   ticks of CPU within DEADLINE ticks of the start of each period
+   of PERIOD ticks, starting now.  Returns false, leaving the
+   thread as it was, if the parameters are not 0 < RUNTIME <=
+   DEADLINE <= PERIOD or if admitting it would raise the total
+   utilisation of deadline threads above 100%.
+
+   A RUNTIME of 0 takes the thread out of the deadline class and
+   always succeeds. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  int64_t bw = 0;
+
+  if (runtime != 0)
+    {
+      if (runtime < 0 || runtime > deadline || deadline > period)
+        return false;
+      bw = (runtime << DL_BW_SHIFT) / period;
+    }
+
+  old_level = intr_disable ();
+  spin_acquire (&dl_lock);
+  if (dl_total_bw - t->dl_bw + bw > DL_BW_ONE)
+    {
+      spin_release (&dl_lock);
+      intr_set_level (old_level);
+      return false;
+    }
+  dl_total_bw += bw - t->dl_bw;
+  t->dl_bw = bw;
+  spin_release (&dl_lock);
+
+  /* Cancel without dl_lock, which dl_replenish() takes. */
+  if (t->dl_timer.func != NULL)
+    timeout_cancel (&t->dl_timer);
+  else
+    timeout_init (&t->dl_timer, dl_replenish, t);
+
+  spin_acquire (&dl_lock);
+  t->dl_runtime = runtime;
+  t->dl_deadline = deadline;
+  t->dl_period = period;
+  t->dl_throttled = false;
+  t->dl_release = timer_ticks ();
+  t->dl_abs_deadline = t->dl_release + deadline;
+  t->dl_budget = runtime;
+  spin_release (&dl_lock);
+  intr_set_level (old_level);
+
+  if (runtime == 0)
+    {
+      if (thread_mlfqs)
+        thread_try_yiled_mlps ();
+      else
+        thread_try_yiled ();
+    }
+  return true;
+}
+
+/** Returns the tick by which the current deadline thread's
+   runtime for this period is due. */
+int64_t
+thread_get_deadline (void)
+{
+  ASSERT (is_deadline (thread_current ()));
+  return thread_current ()->dl_abs_deadline;
+}
+
+/** Gives up the rest of the current deadline thread's runtime
+   for this period and sleeps until the next one starts.  A
+   periodic thread calls this when it finishes each job. */
+void
+thread_deadline_yield (void)
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (is_deadline (t));
+
+  old_level = intr_disable ();
+  spin_acquire (&dl_lock);
+  dl_throttle (t);
+  spin_release (&dl_lock);
+  intr_set_level (old_level);
+  thread_yield ();
 }
 
-int cacl_priority(int nice, fp recent_cpu) {
+static int
+cacl_priority (int nice, fp recent_cpu) {
   const fp rcpu = div_int(recent_cpu, 4);
   const int new_pri =  to_int(sub_int(sub_fp(to_fp(PRI_MAX), rcpu), 2 * nice));
   if (new_pri < PRI_MIN) {
@@ -542,22 +1031,22 @@ thread_recaculate_priority (struct thread *t, void *aux UNUSED)
   if (new_priority == t->priority) {
     return ;
   }
-  t->priority = new_priority;
-  if (t->status != THREAD_READY) {
-    return ;
-  }
-  list_remove(&t->elem);
-  insert_thread_to_ready_queue(t);
+  change_priority (t, new_priority);
 }
 
 /** Sets the current thread's nice value to NICE. */
 void
 thread_set_nice (int nice) 
 {
-  ASSERT(thread_mlfqs);
+  ASSERT(thread_mlfqs || thread_cfs);
   struct thread *t = thread_current();
   t->nice = nice;
 
+  /* The running thread is not on a timeline, so its new weight
+     takes effect from the next tick it is charged for. */
+  if (thread_cfs)
+    return ;
+
   enum intr_level old_level = intr_disable();
 
   thread_recaculate_priority(t, NULL);
@@ -565,15 +1054,88 @@ thread_set_nice (int nice)
   intr_set_level(old_level);
 }
 
-static void 
-thread_recaculate_cpu (struct thread *t, void *aux UNUSED) 
+/** Returns this second's recent_cpu decay coefficient. */
+static fp
+decay_coefficient (void)
 {
   const fp a = mul_int(load_avg, 2); // 2 * load_avg
-  const fp b = div_fp(a, add_int(a, 1)); // (2 * load_avg) / (2 * load_avg + 1)
-  const fp c = mul_fp(b, t->recent_cpu);
+  return div_fp(a, add_int(a, 1)); // (2 * load_avg) / (2 * load_avg + 1)
+}
+
+static void 
+thread_decay_cpu (struct thread *t, fp coef) 
+{
+  const fp c = mul_fp(coef, t->recent_cpu);
   t->recent_cpu = add_int(c, t->nice);
 }
 
+/** Applies to blocked thread T the per-second decays it missed
+   since it blocked, so that its recent_cpu is what it would be
+   had it been decayed every second like a ready thread.
+
+   Decays older than the history are applied in closed form,
+   assuming the oldest recorded coefficient held all along:
+   x -> c*x + nice is raised to the missed power by repeated
+   squaring, so the cost stays O(log n) however long T slept. */
+static void
+thread_catch_up_decay (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  int64_t missed = decay_seconds - t->decay_stamp;
+  int64_t s;
+
+  if (missed > DECAY_HISTORY) {
+    int64_t k = missed - DECAY_HISTORY;
+    fp pa = decay_history[(decay_seconds - DECAY_HISTORY) & (DECAY_HISTORY - 1)];
+    fp pb = to_fp(t->nice);             /* p(x) = pa * x + pb. */
+    fp a = to_fp(1), b = 0;             /* Accumulated map, identity. */
+    for (; k > 0; k >>= 1) {
+      if (k & 1) {
+        b = add_fp(mul_fp(pa, b), pb);
+        a = mul_fp(pa, a);
+      }
+      pb = add_fp(mul_fp(pa, pb), pb);
+      pa = mul_fp(pa, pa);
+    }
+    t->recent_cpu = add_fp(mul_fp(a, t->recent_cpu), b);
+    missed = DECAY_HISTORY;
+  }
+  for (s = decay_seconds - missed; s < decay_seconds; s++)
+    thread_decay_cpu(t, decay_history[s & (DECAY_HISTORY - 1)]);
+  t->decay_stamp = decay_seconds;
+}
+
+/** Decays the recent_cpu of every thread on the ready queues by
+   COEF and moves it to the level of its new priority.  Each
+   queue is done under its own lock, and its threads go back on
+   it. */
+static void
+decay_ready_threads (fp coef)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  struct list pending;
+  int pri;
+
+  list_init(&pending);
+  for (int c = 0; c < cpu_cnt; c++) {
+    struct ready_queue *q = &ready_queues[c];
+    spin_acquire (&q->lock);
+    while ((pri = ready_queue_max(q)) != -1) {
+      struct list *level = &q->levels[pri];
+      list_splice(list_end(&pending), list_begin(level), list_end(level));
+      q->nonempty &= ~((uint64_t) 1 << pri);
+    }
+    q->cnt = 0;
+    while (!list_empty(&pending)) {
+      struct thread *t = list_entry (list_pop_front(&pending), struct thread, elem);
+      thread_decay_cpu(t, coef);
+      t->priority = cacl_priority(t->nice, t->recent_cpu);
+      insert_thread_to_ready_queue(t);
+    }
+    spin_release (&q->lock);
+  }
+}
+
 
 
 
@@ -598,17 +1160,35 @@ thread_get_recent_cpu (void)
   return to_int(mul_int(thread_current()->recent_cpu, 100));
 }
 
+/** Charges the running thread for this tick and, once per
+   second, decays recent_cpu.  Blocked threads are skipped here
+   and caught up by thread_unblock(), so the work done with
+   interrupts off is bounded by the number of ready threads. */
 void
 update_recent_cpu(int64_t ticks) 
 {
   struct thread *t = thread_current();
-  if (t != idle_thread) {
+  if (!is_idle (t)) {
     t->recent_cpu = add_int(t->recent_cpu, 1);
   }
   if (ticks % TIMER_FREQ != 0) {
     return ;
   }
-  thread_foreach(thread_recaculate_cpu, NULL);
+  const fp coef = decay_coefficient();
+  decay_history[decay_seconds & (DECAY_HISTORY - 1)] = coef;
+  decay_seconds++;
+  for (int c = 0; c < cpu_cnt; c++) {
+    struct ready_queue *q = &ready_queues[c];
+    struct thread *r;
+
+    spin_acquire (&q->lock);
+    r = cpus[c].cur;
+    if (!is_idle (r)) {
+      thread_decay_cpu(r, coef);
+    }
+    spin_release (&q->lock);
+  }
+  decay_ready_threads(coef);
 }
 
 void
@@ -621,11 +1201,31 @@ update_load_avg(int64_t ticks)
   }
   const fp a = div_int(to_fp(1), 60);
   const fp b = sub_fp(to_fp(1), a);
-  load_avg = add_fp(mul_fp(b, load_avg), mul_int(a, ready_thread_num));
+  load_avg = add_fp(mul_fp(b, load_avg), mul_int(a, ready_thread_count ()));
 }
 
-static int before_tick = 0;
+/** Returns the number of threads that are running or ready to
+   run, not counting idle threads.  The counts are read without
+   their locks, which is close enough for the load average. */
+static int
+ready_thread_count (void)
+{
+  int cnt = dl_cnt;
 
+  for (int c = 0; c < cpu_cnt; c++) {
+    cnt += ready_queues[c].cnt;
+    if (cpus[c].cur != cpus[c].idle_thread)
+      cnt++;
+  }
+  return cnt;
+}
+
+static int64_t before_tick = 0;
+
+/** Recomputes the running thread's priority.  It is the only
+   thread whose recent_cpu changes between the once-a-second
+   decays, and ready threads are recomputed by the decay itself,
+   so no other thread needs to be visited. */
 void
 update_priority(int64_t ticks) 
 {
@@ -633,10 +1233,12 @@ update_priority(int64_t ticks)
     return ;
   }
   before_tick = ticks;
-  enum intr_level old_level = intr_disable ();
-  thread_foreach(thread_recaculate_priority, NULL);
-  intr_set_level(old_level);
-  // thread_try_yiled_mlps();
+  struct thread *t = thread_current();
+  if (is_idle (t)) {
+    return ;
+  }
+  t->priority = cacl_priority(t->nice, t->recent_cpu);
+  thread_try_yiled_mlps();
 }
 
 
@@ -649,20 +1251,38 @@ update_priority(int64_t ticks)
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   special case when the ready list is empty.
+
+   This is the boot CPU's idle thread.  Those of the other CPUs
+   are set up by thread_create_ap_idle(). */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  thread_current ()->cpu->idle_thread = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/** Body of every CPU's idle thread. */
+static void
+idle_loop (void)
+{
   for (;;) 
     {
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
+      /* Nothing to run.  Zero a free user page for later, if one
+         is wanted, and look again. */
+      if (palloc_zero_idle ())
+        continue;
+
+      /* Still nothing to run.  Skip timer ticks until there is. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -679,6 +1299,45 @@ idle (void *idle_started_ UNUSED)
     }
 }
 
+/** Creates the idle thread of application processor C.  Instead
+   of being scheduled, it starts out as the code running on C,
+   on the stack whose top is returned, and takes over C by
+   calling thread_start_ap().  Called by smp_init(). */
+void *
+thread_create_ap_idle (struct cpu *c)
+{
+  struct thread *t = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  char name[16];
+
+  snprintf (name, sizeof name, "idle%d", c->id);
+  init_thread (t, name, PRI_MIN, 0, 0);
+  t->tid = allocate_tid ();
+  t->cpu = c;
+  return (uint8_t *) t + PGSIZE;
+}
+
+/** Makes the code running on a freshly started application
+   processor into its idle thread and starts scheduling threads
+   on it.  Must be called with interrupts off. */
+void
+thread_start_ap (void)
+{
+  struct thread *t = running_thread ();
+  struct ready_queue *q;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  q = &ready_queues[t->cpu->id];
+  t->status = THREAD_RUNNING;
+  t->on_cpu = true;
+  spin_acquire (&q->lock);
+  t->cpu->idle_thread = t;
+  t->cpu->cur = t;
+  spin_release (&q->lock);
+  idle_loop ();
+}
+
 /** Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) 
@@ -697,11 +1356,12 @@ running_thread (void)
   uint32_t *esp;
 
   /* Copy the CPU's stack pointer into `esp', and then round that
-     down to the start of a page.  Because `struct thread' is
-     always at the beginning of a page and the stack pointer is
-     somewhere in the middle, this locates the curent thread. */
+     down to the start of a page, or of a guarded slot.  Because
+     `struct thread' is always at the beginning of one and the
+     stack pointer is somewhere in the middle, this locates the
+     curent thread. */
   asm ("mov %%esp, %0" : "=g" (esp));
-  return pg_round_down (esp);
+  return kstack_owner (esp);
 }
 
 /** Returns true if T appears to point to a valid thread. */
@@ -725,10 +1385,9 @@ init_thread (struct thread *t, const char *name, int priority, int nice, fp rece
   memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
-  t->stack = (uint8_t *) t + PGSIZE;
+  t->stack = kstack_top (t);
   t->wait_lock = NULL;
   t->nice = nice;
-  list_init(&t->donated_list);
 #ifdef USERPROG
 list_init(&t->child_list);
 list_init(&t->file_list);
@@ -748,7 +1407,10 @@ t->exec_file = NULL;
 
 
   old_level = intr_disable ();
+  t->decay_stamp = decay_seconds;
+  spin_acquire (&all_lock);
   list_push_back (&all_list, &t->allelem);
+  spin_release (&all_lock);
   intr_set_level (old_level);
 }
 
@@ -765,36 +1427,437 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-static int curr_maximum_pri() 
+/** Returns the index of the most significant bit set in MASK, or
+   -1 if MASK is 0.  Scans the 64-bit mask as two 32-bit halves,
+   which GCC turns into `bsr' without needing libgcc. */
+static int
+mask_max (uint64_t mask)
 {
-  for (int i = PRI_MAX; i >= PRI_MIN; i--) {
-    if (!list_empty(&mlps_ready_list[i])) {
-      return i;
-    }
-  }
+  uint32_t hi = mask >> 32;
+  uint32_t lo = mask;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  if (lo != 0)
+    return 31 - __builtin_clz (lo);
   return -1;
 }
 
+/** Returns the highest priority that has a ready thread in Q, or
+   -1 if Q is empty. */
+static int
+ready_queue_max (const struct ready_queue *q)
+{
+  return mask_max (q->nonempty);
+}
+
+/** Returns the highest priority that has a ready thread on any
+   CPU, or -1 if every ready queue is empty. */
+static int
+curr_maximum_pri (void)
+{
+  int pri = -1;
+
+  for (int c = 0; c < cpu_cnt; c++) {
+    struct ready_queue *q = &ready_queues[c];
+    int p;
+
+    spin_acquire (&q->lock);
+    p = ready_queue_max (q);
+    spin_release (&q->lock);
+    if (p > pri)
+      pri = p;
+  }
+  return pri;
+}
+
+/** Returns the thread that Q, whose lock must be held, would run
+   next, or a null pointer if Q is empty. */
+static struct thread *
+queue_front (struct ready_queue *q)
+{
+  int pri;
+
+  if (thread_cfs)
+    return timeline_first (q);
+  pri = ready_queue_max (q);
+  if (pri == -1)
+    return NULL;
+  return list_entry (list_front (&q->levels[pri]), struct thread, elem);
+}
+
+/** Returns true if the CPU whose queue is OWN should take its next
+   thread from Q instead.  Under the priority schedulers, that is
+   if Q has a higher priority thread, or more than one thread more
+   at the same priority.  Under CFS, it is if OWN is empty or Q is
+   longer by more than one.  Either way, the thread must not be
+   one that Q's CPU is still switching away from.  Both queues'
+   locks must be held. */
+static bool
+should_steal (struct ready_queue *own, struct ready_queue *q)
+{
+  const struct thread *t = queue_front (q);
+  int pri;
+
+  if (q == own || t == NULL || t->on_cpu)
+    return false;
+  if (thread_cfs)
+    return own->cnt == 0 || q->cnt > own->cnt + 1;
+  pri = ready_queue_max (own);
+  return t->priority > pri || (t->priority == pri && q->cnt > own->cnt + 1);
+}
+
+/** Returns true if T is the idle thread of the CPU it runs on. */
+static bool
+is_idle (const struct thread *t)
+{
+  return t == t->cpu->idle_thread;
+}
+
+/** Returns T's CFS weight, from its nice value. */
+static int
+cfs_weight (const struct thread *t)
+{
+  int nice = t->nice;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+  return nice_weights[nice - NICE_MIN];
+}
+
+/** Returns true if thread A, an element of a timeline, has less
+   vruntime than thread B. */
+static bool
+vruntime_less (const struct rb_node *a_, const struct rb_node *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = rb_entry (a_, struct thread, cfs_node);
+  const struct thread *b = rb_entry (b_, struct thread, cfs_node);
+
+  return a->vruntime < b->vruntime;
+}
+
+/** Returns the thread with the least vruntime on Q's timeline, or
+   a null pointer if it is empty. */
+static struct thread *
+timeline_first (const struct ready_queue *q)
+{
+  struct rb_node *n = rb_first (&q->timeline);
+
+  return n != NULL ? rb_entry (n, struct thread, cfs_node) : NULL;
+}
+
+/** Returns the vruntime T earns by running for TICKS ticks. */
+static int64_t
+cfs_charge (const struct thread *t, int ticks)
+{
+  return (int64_t) ticks * NSEC_PER_TICK * NICE_0_WEIGHT / cfs_weight (t);
+}
+
+/** Returns the number of ticks T may run for before yielding to
+   the threads on Q, its CPU's queue: T's share, by weight, of a
+   period of CFS_LATENCY ticks, or of CFS_MIN_GRANULARITY ticks
+   per ready thread if that is longer. */
+static unsigned
+cfs_slice (const struct thread *t, const struct ready_queue *q)
+{
+  int64_t weight = cfs_weight (t);
+  int64_t period = CFS_LATENCY;
+  unsigned slice;
+
+  if ((q->cnt + 1) * CFS_MIN_GRANULARITY > period)
+    period = (q->cnt + 1) * CFS_MIN_GRANULARITY;
+  slice = period * weight / (q->load + weight);
+  return slice > CFS_MIN_GRANULARITY ? slice : CFS_MIN_GRANULARITY;
+}
+
+/** Raises Q's min_vruntime to the least vruntime of CUR, the
+   thread running on Q's CPU, and the threads on Q, if that is
+   higher.  The floor never goes down, so that threads that are
+   placed relative to it cannot go back in time. */
+static void
+update_min_vruntime (struct ready_queue *q, const struct thread *cur)
+{
+  struct thread *first = timeline_first (q);
+  int64_t v;
+
+  if (!is_idle (cur))
+    v = first != NULL && first->vruntime < cur->vruntime
+        ? first->vruntime : cur->vruntime;
+  else if (first != NULL)
+    v = first->vruntime;
+  else
+    return ;
+  if (v > q->min_vruntime)
+    q->min_vruntime = v;
+}
+
+/** Charges T, which is running, for a timer tick under CFS, and
+   ends its slice once it has used it up. */
+static void
+cfs_tick (struct thread *t)
+{
+  struct cpu *c = t->cpu;
+  struct ready_queue *q = &ready_queues[c->id];
+  unsigned slice;
+
+  if (is_idle (t)) {
+    if (c->thread_ticks >= TIME_SLICE)
+      intr_yield_on_return ();
+    return ;
+  }
+  spin_acquire (&q->lock);
+  t->vruntime += cfs_charge (t, 1);
+  update_min_vruntime (q, t);
+  slice = cfs_slice (t, q);
+  spin_release (&q->lock);
+  if (c->thread_ticks >= slice)
+    intr_yield_on_return ();
+}
+
+/** Returns true if CUR, the thread running on the CPU whose queue
+   is Q, should give way to the first thread on Q's timeline,
+   because CUR is idle or has run for CFS_WAKEUP_GRANULARITY more
+   vruntime.  The margin keeps a thread that wakes up from
+   preempting one that is about as far along.  Q's lock must be
+   held. */
+static bool
+cfs_should_preempt (const struct ready_queue *q, const struct thread *cur)
+{
+  const struct thread *first = timeline_first (q);
+
+  if (first == NULL)
+    return false;
+  return is_idle (cur)
+         || cur->vruntime - first->vruntime > CFS_WAKEUP_GRANULARITY;
+}
+
+/** Sets the vruntime of T, which is about to be queued on the CPU
+   it last ran on.  A new thread (if INITIAL) starts one slice
+   past the queue's min_vruntime, so that creating threads does
+   not get anyone more than their share.  A thread that woke up
+   keeps its vruntime, but no more than CFS_SLEEPER_CREDIT below
+   min_vruntime, so that it gets to run soon but cannot save up
+   CPU time by sleeping.  The queue's lock must be held. */
+static void
+cfs_place (struct thread *t, bool initial)
+{
+  struct ready_queue *q = &ready_queues[t->cpu->id];
+
+  ASSERT (spin_is_locked (&q->lock));
+
+  if (initial)
+    t->vruntime = q->min_vruntime + cfs_charge (t, cfs_slice (t, q));
+  else if (t->vruntime < q->min_vruntime - CFS_SLEEPER_CREDIT)
+    t->vruntime = q->min_vruntime - CFS_SLEEPER_CREDIT;
+}
+
+/** Returns true if T is in the deadline class. */
+static bool
+is_deadline (const struct thread *t)
+{
+  return t->dl_runtime != 0;
+}
+
+/** Returns true if deadline thread A, an element of the deadline
+   timeline, is due before B. */
+static bool
+deadline_less (const struct rb_node *a_, const struct rb_node *b_,
+               void *aux UNUSED)
+{
+  const struct thread *a = rb_entry (a_, struct thread, dl_node);
+  const struct thread *b = rb_entry (b_, struct thread, dl_node);
+
+  return a->dl_abs_deadline < b->dl_abs_deadline;
+}
+
+/** Returns the ready deadline thread that is due first, or a null
+   pointer if there is none.  dl_lock must be held. */
+static struct thread *
+dl_first (void)
+{
+  struct rb_node *n = rb_first (&dl_timeline);
+
+  return n != NULL ? rb_entry (n, struct thread, dl_node) : NULL;
+}
+
+/** Returns true if deadline thread A should run instead of B:
+   either B is not a deadline thread or it is due later. */
+static bool
+dl_runs_before (const struct thread *a, const struct thread *b)
+{
+  return !is_deadline (b) || a->dl_abs_deadline < b->dl_abs_deadline;
+}
+
+/** Returns true if CUR, the running thread, should give way to a
+   ready deadline thread. */
+static bool
+dl_should_preempt (const struct thread *cur)
+{
+  const struct thread *first;
+  bool preempt;
+
+  spin_acquire (&dl_lock);
+  first = dl_first ();
+  preempt = first != NULL && dl_runs_before (first, cur);
+  spin_release (&dl_lock);
+  return preempt;
+}
+
+/** Charges deadline thread T, which is running, for a timer tick,
+   and throttles it once it has used up its runtime. */
+static void
+dl_tick (struct thread *t)
+{
+  bool throttled = false;
+
+  spin_acquire (&dl_lock);
+  if (--t->dl_budget <= 0) {
+    dl_throttle (t);
+    throttled = true;
+  }
+  spin_release (&dl_lock);
+  if (throttled)
+    intr_yield_on_return ();
+}
+
+/** Keeps deadline thread T, which is running, off the CPU until
+   its next period starts.  It stops running the next time it
+   yields.  dl_lock must be held. */
+static void
+dl_throttle (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spin_is_locked (&dl_lock));
+
+  t->dl_budget = 0;
+  t->dl_throttled = true;
+  timeout_add (&t->dl_timer, t->dl_release + t->dl_period);
+}
+
+/** Starts the next period of throttled deadline thread T_, and
+   makes it ready if it has stopped running.  Called by its
+   `dl_timer'. */
+static void
+dl_replenish (void *t_)
+{
+  struct thread *t = t_;
+  int64_t now = timer_ticks ();
+  bool parked;
+
+  spin_acquire (&dl_lock);
+  t->dl_release += t->dl_period;
+  if (t->dl_release < now)
+    t->dl_release = now;
+  t->dl_abs_deadline = t->dl_release + t->dl_deadline;
+  t->dl_budget = t->dl_runtime;
+  t->dl_throttled = false;
+  parked = t->dl_parked;
+  t->dl_parked = false;
+  spin_release (&dl_lock);
+  if (parked)
+    {
+      thread_unblock (t);
+      if (thread_mlfqs)
+        thread_try_yiled_mlps ();
+      else
+        thread_try_yiled ();
+    }
+}
+
+/** Updates deadline thread T, which is waking up, for the time it
+   slept.  If its deadline has passed, or what is left of its
+   runtime could not be used up by then without running faster
+   than RUNTIME / DEADLINE allows, a new period starts now.
+   Otherwise T carries on with its current deadline and budget,
+   so that blocking briefly does not gain it anything.  dl_lock
+   must be held. */
+static void
+dl_wakeup (struct thread *t)
+{
+  int64_t now = timer_ticks ();
+
+  if (t->dl_throttled)
+    return ;
+  if (t->dl_abs_deadline <= now
+      || t->dl_budget * t->dl_deadline
+         > (t->dl_abs_deadline - now) * t->dl_runtime)
+    {
+      t->dl_release = now;
+      t->dl_abs_deadline = now + t->dl_deadline;
+      t->dl_budget = t->dl_runtime;
+    }
+}
+
 /** Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   the CPU's idle thread.
+
+   The running CPU's own queue is preferred.  Another CPU's queue
+   is used if should_steal() says so, which spreads work to CPUs
+   that run out of it.  The queue to steal from is picked without
+   locks and checked again with both queues' locks held.  Under
+   CFS, a stolen thread's vruntime is shifted by the difference
+   between the queues' min_vruntime, so that it keeps its
+   standing. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (!thread_mlfqs) {
-    if (list_empty (&ready_list))
-      return idle_thread;
-    else
-      return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct thread *cur = running_thread ();
+  struct cpu *self = cur->cpu;
+  struct ready_queue *own = &ready_queues[self->id];
+  struct ready_queue *q = own;
+  struct thread *t;
+
+  if (!rb_empty (&dl_timeline)) {
+    spin_acquire (&dl_lock);
+    t = dl_first ();
+    if (t != NULL && (!t->on_cpu || t == cur)) {
+      remove_thread_from_ready_queue (t);
+      t->status = THREAD_RUNNING;
+      t->on_cpu = true;
+      spin_release (&dl_lock);
+      return t;
+    }
+    spin_release (&dl_lock);
   }
-  // WIP
-  int pri = curr_maximum_pri();
-  if (pri == -1) {
-    return idle_thread;
+
+  for (int c = 0; c < cpu_cnt; c++) {
+    struct ready_queue *other = &ready_queues[c];
+    if (other == q || other->cnt == 0)
+      continue;
+    if (thread_cfs
+        ? q->cnt == 0 || other->cnt > q->cnt + 1
+        : (ready_queue_max (other) > ready_queue_max (q)
+           || (ready_queue_max (other) == ready_queue_max (q)
+               && other->cnt > q->cnt + 1)))
+      q = other;
   }
-  return list_entry (list_pop_front (&mlps_ready_list[pri]), struct thread, elem);
+
+  lock_queue_pair (own, q);
+  if (q != own && !should_steal (own, q)) {
+    spin_release (&q->lock);
+    q = own;
+  }
+  t = queue_front (q);
+  if (t != NULL) {
+    remove_thread_from_ready_queue (t);
+    if (thread_cfs) {
+      if (q != own)
+        t->vruntime += own->min_vruntime - q->min_vruntime;
+      update_min_vruntime (own, t);
+    }
+    t->status = THREAD_RUNNING;
+    t->on_cpu = true;
+  } else {
+    t = self->idle_thread;
+  }
+  unlock_queue_pair (own, q);
+  return t;
 }
 
 /** Completes a thread switch by activating the new thread's page
@@ -817,14 +1880,22 @@ void
 thread_schedule_tail (struct thread *prev)
 {
   struct thread *cur = running_thread ();
+  struct ready_queue *q = &ready_queues[cur->cpu->id];
   
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  spin_acquire (&q->lock);
+  cur->cpu->cur = cur;
+  spin_release (&q->lock);
+
+  /* PREV's registers are saved, so another CPU may run it now. */
+  if (prev != NULL)
+    prev->on_cpu = false;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -839,7 +1910,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      kstack_free (prev);
     }
 }
 
@@ -854,15 +1925,23 @@ static void
 schedule (void) 
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
+
+  next = next_thread_to_run ();
   ASSERT (is_thread (next));
 
+  if (is_idle (cur))
+    timer_idle_exit ();
+
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      next->cpu = cur->cpu;
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -3,9 +3,11 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
 #include "lib/kernel/fixpoint.h"
 #include "threads/synch.h"
+#include "devices/timeout.h"
 #include "vm/vm.h"
 
 /** States in a thread's life cycle. */
@@ -26,19 +28,18 @@ typedef int tid_t;
 #define PRI_MIN 0                       /**< Lowest priority. */
 #define PRI_DEFAULT 31                  /**< Default priority. */
 #define PRI_MAX 63                      /**< Highest priority. */
-#define DONATE_MAX 8
+
+/** Thread niceness. */
+#define NICE_MIN -20                    /**< Highest claim on the CPU. */
+#define NICE_DEFAULT 0                  /**< Default niceness. */
+#define NICE_MAX 20                     /**< Lowest claim on the CPU. */
 
 #define PRIORITY_UPDATE_FRE 4           /**< Interval ticks when recaculate priority. Used in 4.4BSD*/
 
 #define USR_STACK_MAX (1 << 23)         /**< Max size of user stack. 8mb */
 
 struct supplemental_page_table;
-struct donated_priority {
-   int priority;
-   struct lock *lock;
-   struct list_elem elem;
-};
-
+struct cpu;
 struct child_thread {
    tid_t tid;
    int exit_status;                     /**< Exit status of the thread. */
@@ -98,28 +99,52 @@ struct child_thread {
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
 /** The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   the run queue (thread.c), or it can be an element in the wait
+   queue of a semaphore or condition variable (synch.c).  It can
+   be used these two ways only because they are mutually
+   exclusive: only a thread in the ready state is on the run
+   queue, whereas only a thread in the blocked state is on a wait
+   queue. */
 struct thread
   {
     /* Owned by thread.c. */
     tid_t tid;                          /**< Thread identifier. */
     enum thread_status status;          /**< Thread state. */
-    struct lock *wait_lock;             /**< Blocking for wait this block*/
+    struct lock *wait_lock;             /**< Lock this thread is waiting for, if any. */
+    struct rwlock *wait_rwlock;         /**< Readers-writer lock waited for, if any. */
     char name[16];                      /**< Name (for debugging purposes). */
     uint8_t *stack;                     /**< Saved stack pointer. */
-    int priority;                       /**< Priority. */
-    struct list donated_list;           /**< Donated priority list*/
-    int origin_priority;                /**< Store origin priority in donated scene*/
+    int priority;                       /**< Priority, including donations. */
+    int origin_priority;                /**< Priority without donations. */
+    uint64_t donor_mask;                /**< Bit P set iff donor_cnt[P] != 0. */
+    uint16_t donor_cnt[PRI_MAX + 1];    /**< Held locks donating each priority. */
+    struct rwlock_hold read_holds[RWLOCK_HOLD_MAX]; /**< Shared holds. */
     fp recent_cpu;                      /**< CPU time the thread has used recently. Only used with BSD4.4 */
     int nice;                           /**< Nice value for caclulate priority . Only used with BSD4.4 */
+    int64_t decay_stamp;                /**< Per-second recent_cpu decays applied when last blocked. Only used with BSD4.4 */
+    int64_t vruntime;                   /**< Weighted run time, in ns. Only used with CFS */
+    struct rb_node cfs_node;            /**< Element in a CFS timeline. */
+    int64_t dl_runtime;                 /**< Deadline class: budget per period, or 0. */
+    int64_t dl_deadline;                /**< Deadline class: relative deadline. */
+    int64_t dl_period;                  /**< Deadline class: period. */
+    int64_t dl_bw;                      /**< Deadline class: admitted utilisation. */
+    int64_t dl_release;                 /**< Start of current period. */
+    int64_t dl_abs_deadline;            /**< End of current deadline. */
+    int64_t dl_budget;                  /**< Runtime left this period. */
+    bool dl_throttled;                  /**< Out of budget until next period? */
+    bool dl_parked;                     /**< Blocked for being throttled? */
+    struct timeout dl_timer;            /**< Replenishes budget when throttled. */
+    struct rb_node dl_node;             /**< Element in the deadline timeline. */
+    struct cpu *cpu;                    /**< CPU running, or that last ran, this thread. */
+    volatile bool on_cpu;               /**< Still running, or being switched away from? */
     struct list_elem allelem;           /**< List element for all threads list. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /**< List element. */
+    struct waitq *waitq;                /**< Wait queue we are in, if any. */
+    struct spinlock waitq_lock;         /**< Guards `waitq'. */
+    struct list_elem head_elem;         /**< Element in waitq's `heads'. */
+    int wait_priority;                  /**< Priority we were queued at. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -146,13 +171,16 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/** If true, use the completely fair scheduler, which shares the
+   CPU among threads in proportion to weights derived from their
+   nice values.  Controlled by kernel command-line option
+   "-cfs". */
+extern bool thread_cfs;
+
 void thread_init (void);
 void thread_start (void);
-
-bool
-thread_priority_bigger (const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED);
-
+void *thread_create_ap_idle (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void
 thread_try_yiled(void);
@@ -160,6 +188,8 @@ void
 thread_try_yiled_mlps(void);
 void
 thread_priority_change (struct thread *t, int new_priority);
+void thread_donation_change (struct thread *t, int old_priority,
+                             int new_priority);
 
 void thread_tick (void);
 void thread_print_stats (void);
@@ -168,6 +198,7 @@ typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
 void thread_block (void);
+void thread_block_unlock (struct spinlock *);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
@@ -185,6 +216,10 @@ void thread_foreach (thread_action_func *, void *);
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+int64_t thread_get_deadline (void);
+void thread_deadline_yield (void);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
@@ -0,0 +1,150 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+static thread_func worker;
+
+/** Initializes work item W to call FUNC with AUX.  W is not
+   queued. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/** Returns true if W is queued and has not started running. */
+bool
+work_pending (const struct work *w)
+{
+  return w->pending;
+}
+
+/** Creates a work queue served by a new kernel thread named NAME
+   at PRIORITY.  Returns the new queue, or a null pointer if
+   memory or the thread could not be allocated.  Work queues are
+   never destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int priority)
+{
+  struct workqueue *wq = malloc (sizeof *wq);
+
+  if (wq == NULL)
+    return NULL;
+  list_init (&wq->works);
+  spin_init (&wq->lock);
+  sema_init (&wq->ready, 0);
+  if (thread_create (name, priority, worker, wq) == TID_ERROR)
+    {
+      free (wq);
+      return NULL;
+    }
+  return wq;
+}
+
+/** Queues W on WQ, to run after the work already there.  Returns
+   true if successful, false if W was already pending, in which
+   case it keeps its place. */
+bool
+workqueue_add (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool queued;
+
+  old_level = intr_disable ();
+  spin_acquire (&wq->lock);
+  queued = !w->pending;
+  if (queued)
+    {
+      w->pending = true;
+      list_push_back (&wq->works, &w->elem);
+    }
+  spin_release (&wq->lock);
+  if (queued)
+    sema_up (&wq->ready);
+  intr_set_level (old_level);
+  return queued;
+}
+
+/** Takes W off WQ if it has not started running.  Returns true
+   if it was pending, false otherwise.  If W is already running,
+   it runs to completion; use workqueue_flush() to wait for
+   it. */
+bool
+workqueue_cancel (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  old_level = intr_disable ();
+  spin_acquire (&wq->lock);
+  was_pending = w->pending;
+  if (was_pending)
+    {
+      list_remove (&w->elem);
+      w->pending = false;
+    }
+  spin_release (&wq->lock);
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/** Wakes up the thread flushing a work queue. */
+static void
+flush_done (void *done)
+{
+  sema_up (done);
+}
+
+/** Waits until all the work queued on WQ before the call has
+   run.  Must not be called from WQ's own work functions, which
+   would wait for themselves. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  struct semaphore done;
+  struct work barrier;
+
+  ASSERT (!intr_context ());
+
+  sema_init (&done, 0);
+  work_init (&barrier, flush_done, &done);
+  workqueue_add (wq, &barrier);
+  sema_down (&done);
+}
+
+/** Thread function of a work queue's kernel thread.  Runs the
+   queue's work items in order, forever. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w = NULL;
+
+      /* A cancelled item leaves an extra up behind, which finds
+         the queue empty. */
+      sema_down (&wq->ready);
+      old_level = intr_disable ();
+      spin_acquire (&wq->lock);
+      if (!list_empty (&wq->works))
+        {
+          w = list_entry (list_pop_front (&wq->works), struct work, elem);
+          w->pending = false;
+        }
+      spin_release (&wq->lock);
+      intr_set_level (old_level);
+
+      if (w != NULL)
+        w->func (w->aux);
+    }
+}
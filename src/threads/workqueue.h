@@ -0,0 +1,50 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+
+/** Work queues, for jobs too long or too slow for a softirq.
+
+   Each work queue has a kernel thread of its own, running at the
+   priority given to workqueue_create(), that takes work items
+   off the queue in the order they were queued and calls their
+   functions with interrupts on.  Unlike a softirq handler, a
+   work function runs in an ordinary thread, so it may sleep,
+   take locks, and do I/O.
+
+   Work can be queued from anywhere, including interrupt handlers
+   and softirqs. */
+
+/** Function run by a work item. */
+typedef void work_func (void *aux);
+
+/** A work item.  It belongs to its user, who usually embeds it
+   in a larger structure, and must not be freed while queued. */
+struct work
+  {
+    struct list_elem elem;      /**< Element in a queue's `works'. */
+    work_func *func;            /**< Function to run. */
+    void *aux;                  /**< Argument for FUNC. */
+    bool pending;               /**< Queued and not yet started? */
+  };
+
+/** A work queue. */
+struct workqueue
+  {
+    struct list works;          /**< Queued work items. */
+    struct spinlock lock;       /**< Guards WORKS and their PENDING. */
+    struct semaphore ready;     /**< Up'd once for each queued item. */
+  };
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_pending (const struct work *);
+
+struct workqueue *workqueue_create (const char *name, int priority);
+bool workqueue_add (struct workqueue *, struct work *);
+bool workqueue_cancel (struct workqueue *, struct work *);
+void workqueue_flush (struct workqueue *);
+
+#endif /**< threads/workqueue.h */
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
+#include "threads/kstack.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 
@@ -59,6 +60,11 @@ exception_init (void)
      We need to disable interrupts for page faults because the
      fault address is stored in CR2 and needs to be preserved. */
   intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+  /* A double fault gets a task, and so a stack, of its own, so
+     that it can be reported even if the kernel stack overflowed
+     into its guard page. */
+  intr_register_task (8, SEL_DF_TSS, "#DF Double Fault Exception");
 }
 
 /** Prints exception statistics. */
@@ -148,6 +154,15 @@ page_fault (struct intr_frame *f)
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
+
+  /* A large stack frame can skip past the bottom of the stack
+     without the frame of this fault landing in the guard page. */
+  if (!user && kstack_is_guard (fault_addr))
+    {
+      struct thread *t = kstack_owner (fault_addr);
+      PANIC ("Kernel stack overflow in thread %s (tid %d), address %p",
+             t->name, t->tid, fault_addr);
+    }
 #ifdef VM
    if (vm_try_handle_fault(f, fault_addr, user, write, not_present)) {
       return;
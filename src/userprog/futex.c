@@ -0,0 +1,291 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <syscall-nr.h>
+#include "devices/timeout.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+/** Kernel side of the futex system calls.
+
+   A thread that waits on a user word sleeps in a hash table keyed
+   on the physical address of the word, that is, the frame that
+   holds it plus the offset within the page, so that any two
+   mappings of the same memory meet in the same place.  The page
+   stays pinned while anyone sleeps on it, so the frame, and with
+   it the key, cannot change under a sleeper.
+
+   Each bucket has its own spinlock, taken with interrupts off,
+   since timeouts take sleepers out of the table from the timer
+   softirq. */
+
+#define FUTEX_BUCKETS 64        /**< Number of hash buckets. */
+
+/** A hash bucket. */
+struct futex_bucket
+  {
+    struct list waiters;        /**< Sleepers, highest priority first. */
+    struct spinlock lock;       /**< Guards WAITERS and their QUEUED. */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/** A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /**< Element in a bucket. */
+    uintptr_t key;              /**< Physical address waited on. */
+    struct thread *thread;      /**< The sleeping thread. */
+    struct timeout timeout;     /**< Ends the wait early, if armed. */
+    bool queued;                /**< Still in its bucket? */
+    int result;                 /**< What ended the wait. */
+  };
+
+/** Initializes the futex hash table. */
+void
+futex_init (void)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      list_init (&buckets[i].waiters);
+      spin_init (&buckets[i].lock);
+    }
+}
+
+/** Returns the key for user address UADDR in the running process,
+   or 0 if the page holding it is not in memory. */
+static uintptr_t
+futex_key (const int *uaddr)
+{
+  void *kaddr = pagedir_get_page (thread_current ()->pagedir, uaddr);
+
+  return kaddr != NULL ? vtop (kaddr) : 0;
+}
+
+/** Returns the bucket for KEY. */
+static struct futex_bucket *
+futex_bucket (uintptr_t key)
+{
+  return &buckets[hash_int (key >> 2) % FUTEX_BUCKETS];
+}
+
+/** Returns true if waiter A has a higher priority than B. */
+static bool
+waiter_higher_priority (const struct list_elem *a_,
+                        const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct futex_waiter *a = list_entry (a_, struct futex_waiter, elem);
+  const struct futex_waiter *b = list_entry (b_, struct futex_waiter, elem);
+
+  return a->thread->priority > b->thread->priority;
+}
+
+/** Takes W out of the table and wakes it with RESULT.  W's
+   bucket must be locked.  W's thread may not run until after its
+   timeout would have expired, so whichever of futex_wake() and
+   the timeout gets here first clears QUEUED, and the other leaves
+   W alone.  W's thread disarms the timeout itself once it runs. */
+static void
+waiter_wake (struct futex_waiter *w, int result)
+{
+  ASSERT (spin_is_locked (&futex_bucket (w->key)->lock));
+  ASSERT (w->queued);
+
+  list_remove (&w->elem);
+  w->queued = false;
+  w->result = result;
+  thread_unblock (w->thread);
+}
+
+/** Timeout function for a bounded futex_wait(). */
+static void
+waiter_timed_out (void *w_)
+{
+  struct futex_waiter *w = w_;
+  struct futex_bucket *b = futex_bucket (w->key);
+
+  spin_acquire (&b->lock);
+  if (w->queued)
+    waiter_wake (w, FUTEX_TIMED_OUT);
+  spin_release (&b->lock);
+}
+
+/** Sleeps on the word at kernel address KADDR, which must stay
+   put meanwhile, as futex_wait() describes. */
+static int
+wait_on (const int *kaddr, int expected, int timeout_ms)
+{
+  struct futex_waiter w;
+  struct futex_bucket *b;
+  enum intr_level old_level;
+
+  w.key = vtop (kaddr);
+  w.thread = thread_current ();
+  w.queued = false;
+  w.result = FUTEX_WOKEN;
+  timeout_init (&w.timeout, waiter_timed_out, &w);
+  b = futex_bucket (w.key);
+
+  old_level = intr_disable ();
+  spin_acquire (&b->lock);
+  if (*kaddr != expected)
+    w.result = FUTEX_CHANGED;
+  else if (timeout_ms == 0)
+    w.result = FUTEX_TIMED_OUT;
+  else
+    {
+      list_insert_ordered (&b->waiters, &w.elem,
+                           waiter_higher_priority, NULL);
+      w.queued = true;
+      if (timeout_ms > 0)
+        timeout_add (&w.timeout, timer_ticks ()
+                     + ((int64_t) timeout_ms * TIMER_FREQ + 999) / 1000);
+      thread_block_unlock (&b->lock);
+
+      /* The timeout may still be armed, or its function may be
+         running on another CPU; either way W must outlive it. */
+      if (timeout_ms > 0)
+        timeout_cancel (&w.timeout);
+      intr_set_level (old_level);
+      return w.result;
+    }
+  spin_release (&b->lock);
+  intr_set_level (old_level);
+
+  return w.result;
+}
+
+/** Wakes up to N threads sleeping on KEY, highest priority first,
+   and returns the number woken.  Interrupts must be off. */
+static int
+wake_key (uintptr_t key, int n)
+{
+  struct futex_bucket *b = futex_bucket (key);
+  struct list_elem *e;
+  int woken = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spin_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && woken < n; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      e = list_next (e);
+      if (w->key == key)
+        {
+          waiter_wake (w, FUTEX_WOKEN);
+          woken++;
+        }
+    }
+  spin_release (&b->lock);
+  return woken;
+}
+
+/** Gives up the CPU if WOKEN threads were just woken, in case one
+   of them should run ahead of the running thread. */
+static void
+yield_to_woken (int woken)
+{
+  if (woken > 0)
+    {
+      if (thread_mlfqs)
+        thread_try_yiled_mlps ();
+      else
+        thread_try_yiled ();
+    }
+}
+
+/** If the word at user address UADDR, which must be a valid,
+   aligned address in the running process, still holds EXPECTED,
+   sleeps until a futex_wake() on the same word wakes it or, if
+   TIMEOUT_MS is not negative, until that many milliseconds pass.
+
+   Returns FUTEX_WOKEN or FUTEX_TIMED_OUT, or FUTEX_CHANGED without
+   sleeping if the word did not hold EXPECTED.  Checking the word
+   and going to sleep are atomic with respect to futex_wake(), so
+   a thread that changes the word and then wakes its sleepers
+   cannot slip in between. */
+int
+futex_wait (const int *uaddr, int expected, int timeout_ms)
+{
+  const int *kaddr;
+  int result;
+
+  ASSERT (!intr_context ());
+  ASSERT ((uintptr_t) uaddr % sizeof *uaddr == 0);
+
+  pin_user_pointer (uaddr, sizeof *uaddr);
+  kaddr = pagedir_get_page (thread_current ()->pagedir, uaddr);
+  ASSERT (kaddr != NULL);
+
+  result = wait_on (kaddr, expected, timeout_ms);
+
+  unpin_user_pointer (uaddr, sizeof *uaddr);
+  return result;
+}
+
+/** Wakes up to N threads sleeping in futex_wait() on the word at
+   user address UADDR, which must be a valid, aligned address in
+   the running process, highest priority first.  Returns the
+   number of threads woken. */
+int
+futex_wake (const int *uaddr, int n)
+{
+  enum intr_level old_level;
+  uintptr_t key;
+  int woken = 0;
+
+  ASSERT ((uintptr_t) uaddr % sizeof *uaddr == 0);
+
+  /* Sleepers keep their page pinned, so if it is not in memory
+     there is nobody to wake. */
+  old_level = intr_disable ();
+  key = futex_key (uaddr);
+  if (key != 0)
+    woken = wake_key (key, n);
+  intr_set_level (old_level);
+
+  yield_to_woken (woken);
+  return woken;
+}
+
+/** Like futex_wait(), for a word at kernel address KADDR, which
+   must not be freed while anyone sleeps on it.  A word in a user
+   page that the kernel has mapped meets user sleepers on the same
+   word. */
+int
+futex_wait_kernel (const int *kaddr, int expected, int timeout_ms)
+{
+  ASSERT (!intr_context ());
+  ASSERT (is_kernel_vaddr (kaddr));
+  ASSERT ((uintptr_t) kaddr % sizeof *kaddr == 0);
+
+  return wait_on (kaddr, expected, timeout_ms);
+}
+
+/** Like futex_wake(), for a word at kernel address KADDR. */
+int
+futex_wake_kernel (const int *kaddr, int n)
+{
+  enum intr_level old_level;
+  int woken;
+
+  ASSERT (is_kernel_vaddr (kaddr));
+  ASSERT ((uintptr_t) kaddr % sizeof *kaddr == 0);
+
+  old_level = intr_disable ();
+  woken = wake_key (vtop (kaddr), n);
+  intr_set_level (old_level);
+
+  yield_to_woken (woken);
+  return woken;
+}
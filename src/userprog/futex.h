@@ -0,0 +1,12 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdint.h>
+
+void futex_init (void);
+int futex_wait (const int *uaddr, int expected, int timeout_ms);
+int futex_wake (const int *uaddr, int n);
+int futex_wait_kernel (const int *kaddr, int expected, int timeout_ms);
+int futex_wake_kernel (const int *kaddr, int n);
+
+#endif /**< userprog/futex.h */
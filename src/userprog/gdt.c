@@ -2,6 +2,7 @@
 #include <debug.h>
 #include "userprog/tss.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 
 /** The Global Descriptor Table (GDT).
@@ -22,7 +23,7 @@
    For more information on the GDT as used here, refer to
    [IA32-v3a] 3.2 "Using Segments" through 3.5 "System Descriptor
    Types". */
-static uint64_t gdt[SEL_CNT];
+static uint64_t gdt[SEL_CNT + CPU_MAX];
 
 /** GDT helpers. */
 static uint64_t make_code_desc (int dpl);
@@ -43,7 +44,8 @@ gdt_init (void)
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
   gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
   gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get ());
+  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get (0));
+  gdt[SEL_DF_TSS / sizeof *gdt] = make_tss_desc (tss_get_double_fault ());
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
@@ -52,6 +54,21 @@ gdt_init (void)
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
   asm volatile ("ltr %w0" : : "q" (SEL_TSS));
 }
+
+/** Adds the TSS of application processor ID to the GDT, then
+   loads the GDT and that TSS on the calling CPU. */
+void
+gdt_init_ap (int id)
+{
+  uint64_t gdtr_operand;
+
+  ASSERT (id > 0 && id < CPU_MAX);
+  gdt[SEL_TSS_CPU (id) / sizeof *gdt] = make_tss_desc (tss_get (id));
+
+  gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
+  asm volatile ("lgdt %0" : : "m" (gdtr_operand));
+  asm volatile ("ltr %w0" : : "q" (SEL_TSS_CPU (id)));
+}
 
 /** System segment or code/data segment? */
 enum seg_class
@@ -2,14 +2,24 @@
 #define USERPROG_GDT_H
 
 #include "threads/loader.h"
+#include "threads/smp.h"
 
 /** Segment selectors.
    More selectors are defined by the loader in loader.h. */
 #define SEL_UCSEG       0x1B    /**< User code selector. */
 #define SEL_UDSEG       0x23    /**< User data selector. */
-#define SEL_TSS         0x28    /**< Task-state segment. */
+#define SEL_TSS         0x28    /**< Task-state segment of the boot CPU. */
 #define SEL_CNT         6       /**< Number of segments. */
 
+/** Task-state segment of CPU number ID.  The TSSs of other CPUs
+   follow the boot CPU's at the end of the GDT. */
+#define SEL_TSS_CPU(ID) (SEL_TSS + 8 * (ID))
+
+/** Task-state segment of the double fault handler, after the
+   CPUs' TSSs. */
+#define SEL_DF_TSS SEL_TSS_CPU (CPU_MAX)
+
 void gdt_init (void);
+void gdt_init_ap (int id);
 
 #endif /**< userprog/gdt.h */
@@ -3,8 +3,10 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "vm/vm.h"
 
 static uint32_t *active_pd (void);
@@ -220,15 +222,25 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
 void
 pagedir_activate (uint32_t *pd) 
 {
+  enum intr_level old_level;
+
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Record PD before loading it, so that smp_tlb_shootdown()
+     after a change to PD either finds us or runs after we have
+     loaded the changed tables.  It is compared, never followed,
+     so it may outlive PD. */
+  old_level = intr_disable ();
+  cpu_current ()->loaded_pd = pd;
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  intr_set_level (old_level);
 }
 
 /** Returns the currently active page directory. */
@@ -251,7 +263,8 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)  Other
+   CPUs running a thread with PD are told to do the same. */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
@@ -261,6 +274,9 @@ invalidate_pagedir (uint32_t *pd)
          "Translation Lookaside Buffers (TLBs)". */
       pagedir_activate (pd);
     } 
+
+  /* Other CPUs may be running threads in PD, too. */
+  smp_tlb_shootdown (pd);
 }
 
 /* Reads a byte at user virtual address UADDR.
@@ -225,7 +225,7 @@ process_exit (void)
     struct file_descriptor *file_info = list_entry(e, struct file_descriptor, elem);
     e = list_next(e);
     file_close(file_info->file);
-    free(file_info);
+    kmem_cache_free(&file_descriptor_cache, file_info);
   }
   if (cur->exec_file != NULL) {
     file_allow_write(cur->exec_file);
@@ -617,6 +617,7 @@ install_page (void *upage, void *kpage, bool writable)
 
 #else
 
+#include "threads/malloc.h"
 #include "vm/vm.h"
 
 struct load_segment_info {
@@ -628,6 +629,75 @@ struct load_segment_info {
   bool writable;
 };
 
+/* Cache of the load_segment_info passed to lazy_load_segment(). */
+static struct kmem_cache load_segment_cache;
+
+/* Sets up the cache of load_segment_info.  Called by vm_init(). */
+void
+load_segment_init (void) {
+  kmem_cache_init (&load_segment_cache, "load_segment_info",
+                   sizeof (struct load_segment_info), NULL);
+}
+
+/* Frees AUX, the load_segment_info of a lazily loaded page. */
+void
+load_segment_free (void *aux) {
+  kmem_cache_free (&load_segment_cache, aux);
+}
+
+/* An ELF segment, recorded as a region of the address space. */
+struct segment_region {
+  struct vm_region region;
+  struct file *file;            /* Executable. */
+  off_t ofs;                    /* Offset of the segment in FILE. */
+  uint32_t read_bytes;          /* Bytes to read; the rest are zeroed. */
+};
+
+/* Creates the page at VA in segment REGION, to be loaded from the
+ * executable when it is first faulted in. */
+static bool
+segment_populate (struct vm_region *region, void *va) {
+  struct segment_region *seg = region->aux;
+  uint32_t offset = (uint8_t *) va - (uint8_t *) region->start;
+  uint32_t page_read_bytes = 0;
+  struct load_segment_info *info;
+
+  if (offset < seg->read_bytes) {
+    page_read_bytes = seg->read_bytes - offset;
+    if (page_read_bytes > PGSIZE)
+      page_read_bytes = PGSIZE;
+  }
+
+  info = kmem_cache_alloc (&load_segment_cache);
+  if (info == NULL) {
+    return false;
+  }
+  info->file = seg->file;
+  info->ofs = seg->ofs + offset;
+  info->upage = va;
+  info->read_bytes = page_read_bytes;
+  info->zero_bytes = PGSIZE - page_read_bytes;
+  info->writable = region->writable;
+
+  if (!vm_alloc_page_with_initializer (VM_ANON, va, region->writable,
+                                       lazy_load_segment, info)) {
+    kmem_cache_free (&load_segment_cache, info);
+    return false;
+  }
+  return true;
+}
+
+/* Frees segment REGION when its process exits. */
+static void
+segment_destroy (struct vm_region *region) {
+  free (region->aux);
+}
+
+static const struct vm_region_operations segment_region_ops = {
+  .populate = segment_populate,
+  .destroy = segment_destroy,
+};
+
 bool
 lazy_load_segment (struct page *page, void *aux) {
 	/* TODO: Load the segment from the file */
@@ -676,38 +746,28 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
-  uint32_t ofs_now = 0;
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-    aux = malloc(sizeof(struct load_segment_info));
-    if (aux == NULL) {
-      return false;
-    }
-    struct load_segment_info *info = aux;
-    info->file = file;
-    info->ofs = ofs + ofs_now;
-    info->upage = upage;
-    info->read_bytes = page_read_bytes;
-    info->zero_bytes = page_zero_bytes;
-    info->writable = writable;
-
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
-			return false;
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-    ofs_now += page_read_bytes;
-	}
+
+  /* Only record the segment; segment_populate() sets up each page's
+     load_segment_info when the page is first touched. */
+  struct segment_region *seg = malloc (sizeof *seg);
+  if (seg == NULL) {
+    return false;
+  }
+  seg->file = file;
+  seg->ofs = ofs;
+  seg->read_bytes = read_bytes;
+  seg->region = (struct vm_region) {
+    .start = upage,
+    .end = upage + read_bytes + zero_bytes,
+    .writable = writable,
+    .operations = &segment_region_ops,
+    .aux = seg,
+  };
+
+  if (!spt_insert_region (&thread_current ()->spt, &seg->region)) {
+    free (seg);
+    return false;
+  }
 	return true;
 }
 
@@ -721,7 +781,6 @@ setup_stack (void **esp)
  if (success) {
   
    *esp = PHYS_BASE;
-   memset(((uint8_t *) PHYS_BASE) - PGSIZE, 0, PGSIZE);
 } else {
   printf("setup_stack failed\n");
 }
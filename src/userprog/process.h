@@ -10,5 +10,7 @@ int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
 bool lazy_load_segment (struct page *page, void *aux);
+void load_segment_init (void);
+void load_segment_free (void *aux);
 
 #endif /**< userprog/process.h */
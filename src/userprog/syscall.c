@@ -4,6 +4,7 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "pagedir.h"
+#include "userprog/futex.h"
 
 
 static void syscall_handler (struct intr_frame *);
@@ -40,6 +41,9 @@ extern uint32_t sys_mkdir(struct intr_frame *f);
 extern uint32_t sys_readdir(struct intr_frame *f);
 extern uint32_t sys_isdir(struct intr_frame *f);
 extern uint32_t sys_inumber(struct intr_frame *f);
+extern uint32_t sys_futex_wait(struct intr_frame *f);
+extern uint32_t sys_futex_wake(struct intr_frame *f);
+extern uint32_t sys_clock_ns(struct intr_frame *f);
 
 
 static uint32_t (*syscalls[])(struct intr_frame *f) = {
@@ -63,6 +67,9 @@ static uint32_t (*syscalls[])(struct intr_frame *f) = {
 [SYS_READDIR]  sys_readdir,
 [SYS_ISDIR]    sys_isdir,
 [SYS_INUMBER]   sys_inumber,
+[SYS_FUTEX_WAIT]  sys_futex_wait,
+[SYS_FUTEX_WAKE]  sys_futex_wake,
+[SYS_CLOCK_NS]    sys_clock_ns,
 };
 
 static char * sysCallName[] = {
@@ -86,12 +93,16 @@ static char * sysCallName[] = {
 [SYS_READDIR]  "SYS_READDIR",
 [SYS_ISDIR]    "SYS_ISDIR",
 [SYS_INUMBER]   "SYS_INUMBER",
+[SYS_FUTEX_WAIT]  "SYS_FUTEX_WAIT",
+[SYS_FUTEX_WAKE]  "SYS_FUTEX_WAKE",
+[SYS_CLOCK_NS]    "SYS_CLOCK_NS",
 };
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  futex_init ();
 }
 
 static void
@@ -5,6 +5,8 @@
 #include "filesys/filesys.h"
 #include "pagedir.h"
 #include "devices/input.h"
+#include "userprog/futex.h"
+#include "devices/clock.h"
 
 
 static int 
@@ -162,7 +164,7 @@ uint32_t sys_open(struct intr_frame *f){
         return -1;
     }
     struct thread *t = thread_current();
-    struct file_descriptor *fd = malloc(sizeof(struct file_descriptor));
+    struct file_descriptor *fd = kmem_cache_alloc(&file_descriptor_cache);
     if (fd == NULL) {
         
         return -1;
@@ -279,7 +281,7 @@ uint32_t sys_close(struct intr_frame *f){
     file_close(file->file);
     filesys_releaselock();
     list_remove(&file->elem);
-    free(file);
+    kmem_cache_free(&file_descriptor_cache, file);
     return 0;
 }
 uint32_t sys_mmap(struct intr_frame *f){
@@ -330,6 +332,48 @@ uint32_t sys_inumber(struct intr_frame *f){
     PANIC("sys_inumber");
 }
 
+/** Reads the user word address in argument N of F, killing the
+ * process unless it is aligned and mapped. */
+static int *
+futex_arg(int n, struct intr_frame *f) {
+    int *uaddr;
+    bool success = argraw(n, f, &uaddr);
+    if (!success || (uintptr_t)uaddr % sizeof *uaddr != 0
+        || !check_user_pointer(uaddr, sizeof *uaddr, false, f)) {
+        thread_exit_with_status(-1);
+    }
+    return uaddr;
+}
+
+uint32_t sys_futex_wait(struct intr_frame *f) {
+    int *uaddr = futex_arg(1, f);
+    int expected, timeout_ms;
+    bool success = argraw(2, f, &expected) && argraw(3, f, &timeout_ms);
+    if (!success) {
+        thread_exit_with_status(-1);
+    }
+    return futex_wait(uaddr, expected, timeout_ms);
+}
+uint32_t sys_futex_wake(struct intr_frame *f) {
+    int *uaddr = futex_arg(1, f);
+    int n;
+    bool success = argraw(2, f, &n);
+    if (!success) {
+        thread_exit_with_status(-1);
+    }
+    return futex_wake(uaddr, n);
+}
+
+uint32_t sys_clock_ns(struct intr_frame *f) {
+    int64_t *uns;
+    bool success = argraw(1, f, &uns);
+    if (!success || !check_user_pointer(uns, sizeof *uns, true, f)) {
+        thread_exit_with_status(-1);
+    }
+    *uns = clock_ns();
+    return 0;
+}
+
 static int 
 check_str(char *puser, struct intr_frame *f) {
     int size = 0;
@@ -2,8 +2,12 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/flags.h"
+#include "threads/init.h"
+#include "threads/kstack.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 
 /** The Task-State Segment (TSS).
@@ -72,35 +76,122 @@ struct tss
     uint16_t trace, bitmap;
   };
 
-/** Kernel TSS. */
-static struct tss *tss;
+/** Kernel TSS of each CPU.  Every CPU needs its own, because
+   esp0 points into the stack of the thread it is running. */
+static struct tss *tss[CPU_MAX];
 
-/** Initializes the kernel TSS. */
-void
-tss_init (void) 
+/** TSS of the double fault handler.  A double fault switches
+   tasks through a task gate, which gives the handler a stack of
+   its own.  That is the only way to report a kernel stack
+   overflow into a guard page: with the stack pointer in the
+   guard page, the CPU cannot push the frame of the page fault,
+   nor that of an ordinary double fault handler. */
+static struct tss *df_tss;
+
+static void init_double_fault_tss (void);
+
+/** Allocates and initializes the kernel TSS of CPU number ID. */
+static void
+init_tss (int id)
 {
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
-  tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
-  tss->ss0 = SEL_KDSEG;
-  tss->bitmap = 0xdfff;
+  tss[id] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  tss[id]->ss0 = SEL_KDSEG;
+  tss[id]->bitmap = 0xdfff;
+}
+
+/** Initializes the boot CPU's kernel TSS. */
+void
+tss_init (void) 
+{
+  init_tss (0);
   tss_update ();
+  init_double_fault_tss ();
 }
 
-/** Returns the kernel TSS. */
+/** Initializes the kernel TSS of application processor ID.  Its
+   esp0 is set when it first switches threads. */
+void
+tss_init_ap (int id)
+{
+  ASSERT (id > 0 && id < CPU_MAX);
+  init_tss (id);
+}
+
+/** Returns the kernel TSS of CPU number ID. */
 struct tss *
-tss_get (void) 
+tss_get (int id) 
 {
-  ASSERT (tss != NULL);
-  return tss;
+  ASSERT (tss[id] != NULL);
+  return tss[id];
 }
 
-/** Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/** Sets the ring 0 stack pointer in the running CPU's TSS to
+   point to the end of the thread stack. */
 void
 tss_update (void) 
 {
-  ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  struct tss *t = tss[cpu_current ()->id];
+
+  ASSERT (t != NULL);
+  t->esp0 = kstack_top (thread_current ());
+}
+
+/** Returns the TSS of the double fault handler. */
+struct tss *
+tss_get_double_fault (void)
+{
+  ASSERT (df_tss != NULL);
+  return df_tss;
+}
+
+/** Handles a double fault, as its own task.  The CPU saved the
+   state of the task it was running, including the stack pointer,
+   in that task's TSS, and linked that TSS to ours. */
+static void
+double_fault (void)
+{
+  int id = (df_tss->back_link - SEL_TSS) / 8;
+  uint8_t *esp;
+
+  if (id < 0 || id >= CPU_MAX || tss[id] == NULL)
+    PANIC ("#DF Double Fault Exception");
+
+  /* The first push of the page fault frame went just below the
+     stack pointer. */
+  esp = (uint8_t *) tss[id]->esp;
+  if (kstack_is_guard (esp - sizeof (uint32_t)))
+    {
+      struct thread *t = kstack_owner (esp);
+      PANIC ("Kernel stack overflow in thread %s (tid %d), esp=%p",
+             t->name, t->tid, esp);
+    }
+  PANIC ("#DF Double Fault Exception, esp=%p", esp);
+}
+
+/** Allocates and initializes the double fault handler's TSS and
+   stack. */
+static void
+init_double_fault_tss (void)
+{
+  uint8_t *stack = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
+  /* The console finds the running CPU through the `struct thread'
+     at the bottom of the stack page.  Any CPU will do, since the
+     handler only prints and shuts down. */
+  ((struct thread *) stack)->cpu = &cpus[0];
+
+  df_tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  df_tss->cr3 = vtop (init_page_dir);
+  df_tss->eip = double_fault;
+  df_tss->eflags = FLAG_MBS;
+  df_tss->esp = (uint32_t) (stack + PGSIZE);
+  df_tss->cs = SEL_KCSEG;
+  df_tss->ss = df_tss->ds = df_tss->es = SEL_KDSEG;
+  df_tss->fs = df_tss->gs = SEL_KDSEG;
+  df_tss->ss0 = SEL_KDSEG;
+  df_tss->esp0 = stack + PGSIZE;
+  df_tss->bitmap = 0xdfff;
 }
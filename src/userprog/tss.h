@@ -5,7 +5,9 @@
 
 struct tss;
 void tss_init (void);
-struct tss *tss_get (void);
+void tss_init_ap (int id);
+struct tss *tss_get (int id);
+struct tss *tss_get_double_fault (void);
 void tss_update (void);
 
 #endif /**< userprog/tss.h */
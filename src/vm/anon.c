@@ -89,7 +89,7 @@ anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
 
 	if (anon_page->aux != NULL) {
-		free(anon_page->aux);
+		load_segment_free(anon_page->aux);
 	}
 
 	if (!isLoadSegPage(page) && anon_page->slot != DISK_SWAP_ERROR) {
@@ -101,6 +101,6 @@ anon_destroy (struct page *page) {
 		pagedir_clear_page(page->spt->thread->pagedir, page->va);
 		palloc_free_page(page->frame->kva);
 		
-		free(page->frame);
+		kmem_cache_free(&vm_frame_cache, page->frame);
 	}
 }
@@ -9,6 +9,8 @@ static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
 
+static struct kmem_cache mmap_file_cache;
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
 	.swap_in = file_backed_swap_in,
@@ -20,6 +22,8 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	kmem_cache_init (&mmap_file_cache, "mmap_file", sizeof (struct mmap_file),
+			NULL);
 }
 
 /* Initialize the file backed page */
@@ -123,7 +127,7 @@ file_backed_destroy (struct page *page) {
 
 	pagedir_clear_page(page->spt->thread->pagedir, page->va);
 	palloc_free_page(page->frame->kva);
-	free(page->frame);
+	kmem_cache_free(&vm_frame_cache, page->frame);
 	return ;
 }
 
@@ -133,7 +137,21 @@ allocate_mmapid (void) {
 	return next_mmapid++;
 }
 
-/* Do the mmap */
+/* Creates the page at VA in the file mapping REGION. */
+static bool
+mmap_populate (struct vm_region *region, void *va) {
+	return vm_alloc_page_with_initializer (VM_FILE, va, region->writable,
+			NULL, region->aux);
+}
+
+/* Mappings are torn down by do_munmap(), so they need no destroy. */
+static const struct vm_region_operations mmap_region_ops = {
+	.populate = mmap_populate,
+	.destroy = NULL,
+};
+
+/* Do the mmap.  Only records the mapping as a region; its pages are
+ * created as they are touched. */
 int
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
@@ -141,18 +159,12 @@ do_mmap (void *addr, size_t length, int writable,
 		return -1;
 	}
 	struct supplemental_page_table *spt = &thread_current()->spt;
-	/* Check if the addr is already mapped */
 	void *end = addr + length;
 
 	if (is_user_vaddr(addr) == false || is_user_vaddr(addr + length - 1) == false) {
 		return -1;
 	}
 
-	for (void *i = addr; i < end; i += PGSIZE) {
-		if (spt_find_page(spt, i) != NULL) {
-			return -1;
-		}
-	}
 	/* Create a new mmapid */
 	int mmapid = allocate_mmapid();
 
@@ -170,18 +182,9 @@ do_mmap (void *addr, size_t length, int writable,
 		return -1;
 	}
 	/* Create a new mmap file */
-	struct mmap_file *mmap_file = malloc(sizeof(struct mmap_file));
+	struct mmap_file *mmap_file = kmem_cache_alloc(&mmap_file_cache);
 	if (mmap_file == NULL) {
-		bool filesys_locked = is_held_filesys_lock();
-		if (!filesys_locked) {
-			filesys_getlock();
-		}
-		file_close(new_file);
-		if (!filesys_locked) {
-			filesys_releaselock();
-		}
-
-		return -1;
+		goto fail;
 	}
 	mmap_file->file = new_file;
 	mmap_file->mapid = mmapid;
@@ -189,29 +192,34 @@ do_mmap (void *addr, size_t length, int writable,
 	mmap_file->writable = writable;
 	mmap_file->offset = offset;
 	mmap_file->len = length;
-	list_init(&mmap_file->pages);
-	
+	mmap_file->region = (struct vm_region) {
+		.start = addr,
+		.end = pg_round_up (end),
+		.writable = writable,
+		.operations = &mmap_region_ops,
+		.aux = mmap_file,
+	};
+
+	/* Fails if the range overlaps another region or an existing page. */
+	if (!spt_insert_region(spt, &mmap_file->region)) {
+		kmem_cache_free(&mmap_file_cache, mmap_file);
+		goto fail;
+	}
+
 	/* Add the mmap file to the list */
 	list_push_back(&spt->mmap_table, &mmap_file->elem);
+	return mmapid;
 
-	/* Map the file to the pages */
-	for (void *i = addr; i < end; i += PGSIZE) {
-		struct page *page = malloc(sizeof(struct page));
-		
-		if (page == NULL) {
-			do_munmap(mmapid);
-			return -1;
-		}
-		uninit_new(page, i, NULL, VM_FILE, mmap_file, writable, spt, file_backed_initializer);
-		if ( !spt_insert_page (spt, page)) {
-			free(page);
-			do_munmap(mmapid);
-			return -1;
-		}
-		list_push_back(&mmap_file->pages, &page->mmap_elem);
+fail:
+	filesys_locked = is_held_filesys_lock();
+	if (!filesys_locked) {
+		filesys_getlock();
 	}
-	return mmapid;
-	
+	file_close(new_file);
+	if (!filesys_locked) {
+		filesys_releaselock();
+	}
+	return -1;
 }
 
 /* Do the munmap */
@@ -232,13 +240,15 @@ do_munmap (int mmapid) {
 	}
 	/* Remove the mmap file from the list */
 	list_remove(&mmap_file->elem);
-	/* Unmap the file from the pages */
-	struct list_elem *e2;
+	spt_remove_region(spt, &mmap_file->region);
+
+	/* Unmap the pages that were touched, writing back dirty ones */
+	struct page *page;
+	void *va = mmap_file->region.start;
 
 	lock_acquire(&spt->lock);
-	for (e2 = list_begin(&mmap_file->pages); e2 != list_end(&mmap_file->pages); ) {
-		struct page *page = list_entry(e2, struct page, mmap_elem);
-		e2 = list_next(e2);
+	while ((page = spt_next_page(spt, va, mmap_file->region.end)) != NULL) {
+		va = page->va + PGSIZE;
 		spt_remove_page(spt, page);
 	}
 	lock_release(&spt->lock);
@@ -252,5 +262,5 @@ do_munmap (int mmapid) {
 	if (!filesys_locked) {
 		filesys_releaselock();
 	}
-	free(mmap_file);
+	kmem_cache_free(&mmap_file_cache, mmap_file);
 }
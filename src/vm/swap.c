@@ -1,9 +1,9 @@
 #include "swap.h"
 #include "devices/block.h"
 #include <bitmap.h>
+#include <stdio.h>
 #include "threads/vaddr.h"
 #include "threads/synch.h"
-#include "filesys/filesys.h"
 /* Swap slot size */
 #define SLOT_SIZE (PGSIZE)
 
@@ -39,63 +39,41 @@ disk_swap_init (void) {
   lock_init (&swap_map.swap_lock);
 }
 
-/* Swap in the page by reading SLOT from the swap device to KVA */
+/* Swap in the page by reading SLOT from the swap device to KVA.
+ * SWAP_LOCK only covers the bitmap, so swap I/O queues on the
+ * swap disk alongside file system I/O instead of behind it. */
 void
 disk_swap_in (size_t slot, void *kva) {
-  // lock_acquire (&swap_map.swap_lock);
-  bool filesys_locked = is_held_filesys_lock();
-  if (!filesys_locked) {
-    filesys_getlock();
-  }
   /* Read the slot from the swap device to KVA */
-  for (size_t i = 0; i < SLOT_SIZE / BLOCK_SECTOR_SIZE; i++) {
-    block_read (swap_map.swap_table, slot * (SLOT_SIZE / BLOCK_SECTOR_SIZE) + i, kva + i * BLOCK_SECTOR_SIZE);
-  }
-  
+  block_read_multiple (swap_map.swap_table, slot * (SLOT_SIZE / BLOCK_SECTOR_SIZE),
+                       SLOT_SIZE / BLOCK_SECTOR_SIZE, kva);
+
   /* Mark the slot as free */
+  lock_acquire (&swap_map.swap_lock);
   bitmap_reset (swap_map.map, slot);
-  // lock_release (&swap_map.swap_lock);
-  if (!filesys_locked)
-      filesys_releaselock();
-  
+  lock_release (&swap_map.swap_lock);
 }
 
 /* Swap out the page by writing KVA to the swap device and return the slot */
 size_t
 disk_swap_out (void *kva) {
-  // lock_acquire (&swap_map.swap_lock);
-  bool filesys_locked = is_held_filesys_lock();
-  if (!filesys_locked) {
-    filesys_getlock();
-  }
   /* Find a free slot */
+  lock_acquire (&swap_map.swap_lock);
   size_t slot = bitmap_scan_and_flip (swap_map.map, 0, 1, false);
+  lock_release (&swap_map.swap_lock);
   if (slot == BITMAP_ERROR) {
     printf ("No free swap slot");
-    // lock_release (&swap_map.swap_lock);
-    if (!filesys_locked)
-      filesys_releaselock();
     return DISK_SWAP_ERROR;
   }
-  
+
   /* Write KVA to the slot of the swap device */
-  for (size_t i = 0; i < SLOT_SIZE / BLOCK_SECTOR_SIZE; i++) {
-    block_write (swap_map.swap_table, slot * (SLOT_SIZE / BLOCK_SECTOR_SIZE) + i, kva + i * BLOCK_SECTOR_SIZE);
-  }
-   if (!filesys_locked)
-      filesys_releaselock();
-  // lock_release (&swap_map.swap_lock);
+  block_write_multiple (swap_map.swap_table, slot * (SLOT_SIZE / BLOCK_SECTOR_SIZE),
+                        SLOT_SIZE / BLOCK_SECTOR_SIZE, kva);
   return slot;
 }
 
 void disk_swap_free(size_t slot) {
-  // lock_acquire (&swap_map.swap_lock);
-  bool filesys_locked = is_held_filesys_lock();
-  if (!filesys_locked) {
-    filesys_getlock();
-  }
+  lock_acquire (&swap_map.swap_lock);
   bitmap_reset (swap_map.map, slot);
-  // lock_release (&swap_map.swap_lock);
-  if (!filesys_locked)
-      filesys_releaselock();
-}
\ No newline at end of file
+  lock_release (&swap_map.swap_lock);
+}
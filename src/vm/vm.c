@@ -3,13 +3,18 @@
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "userprog/pagedir.h"
+#include "userprog/process.h"
 #include "threads/synch.h"
+#include "threads/pte.h"
 #include "threads/vaddr.h"
 #include "swap.h"
 #include "lib/kernel/list.h"
 #include "threads/interrupt.h"
 
 /* Locks */
+struct kmem_cache vm_page_cache;
+struct kmem_cache vm_frame_cache;
+
 static struct lock frame_lock;
 
 static struct list_elem frame_clock_hand;
@@ -36,6 +41,9 @@ vm_init (void) {
 	// register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
+	kmem_cache_init (&vm_page_cache, "page", sizeof (struct page), NULL);
+	kmem_cache_init (&vm_frame_cache, "frame", sizeof (struct frame), NULL);
+	load_segment_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -56,7 +64,7 @@ page_get_type (struct page *page) {
 
 /* Helpers */
 static struct frame *vm_get_victim (void);
-static bool vm_do_claim_page (struct page *page);
+static bool vm_do_claim_page (struct page *page, enum palloc_flags flags);
 static struct frame *vm_evict_frame (void);
 static bool
 vm_stack_growth (void *addr);
@@ -78,7 +86,7 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		/* TODO: Create the page, fetch the initialier according to the VM type,
 		 * TODO: and then create "uninit" page struct by calling uninit_new. You
 		 * TODO: should modify the field after calling the uninit_new. */
-        struct page *page = malloc (sizeof *page);
+        struct page *page = kmem_cache_alloc (&vm_page_cache);
         if (page == NULL)
             goto err;
 
@@ -95,30 +103,144 @@ err:
 
 
 
+/* Returns the slot for VA in SPT's radix tree.  If the slot's leaf
+ * does not exist yet, allocates it if CREATE is true and otherwise,
+ * or if memory runs out, returns NULL. */
+static struct page **
+spt_slot (struct supplemental_page_table *spt, const void *va, bool create) {
+	struct page **leaf;
+
+	if (spt->dir == NULL) {
+		if (!create)
+			return NULL;
+		spt->dir = palloc_get_page (PAL_ZERO);
+		if (spt->dir == NULL)
+			return NULL;
+	}
+	leaf = spt->dir[pd_no (va)];
+	if (leaf == NULL) {
+		if (!create)
+			return NULL;
+		leaf = spt->dir[pd_no (va)] = palloc_get_page (PAL_ZERO);
+		if (leaf == NULL)
+			return NULL;
+	}
+	return &leaf[pt_no (va)];
+}
+
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
 spt_find_page (struct supplemental_page_table *spt, void *va) {
-	/* TODO: Fill this function. */
-    struct page tmp = {.va = va};
-
-    // lock_acquire(&spt->lock);
-    struct hash_elem *res = hash_find(&spt->pages, &tmp.elem);
-    // lock_release(&spt->lock);
+	struct page **slot = spt_slot (spt, va, false);
 
-	return res != NULL ? hash_entry (res, struct page, elem) : NULL;
+	return slot != NULL ? *slot : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
 spt_insert_page (struct supplemental_page_table *spt,
 		struct page *page) {
-	bool succ = false;
-	/* TODO: Fill this function. */
-    // lock_acquire(&spt->lock);
-    succ = (hash_insert(&spt->pages, &page->elem) == NULL);
-    // lock_release(&spt->lock);
+	struct page **slot;
+
+	if (!is_user_vaddr (page->va))
+		return false;
+	slot = spt_slot (spt, page->va, true);
+	if (slot == NULL || *slot != NULL)
+		return false;
+	*slot = page;
+	return true;
+}
+
+/* Returns the first page in SPT at or after VA and before END, or NULL
+ * if there is none.  Skips 4 MB at a time where there are no pages. */
+struct page *
+spt_next_page (struct supplemental_page_table *spt, void *va, void *end) {
+	uint8_t *p = pg_round_down (va);
+
+	if (spt->dir == NULL)
+		return NULL;
+	while (p < (uint8_t *) end && is_user_vaddr (p)) {
+		struct page **leaf = spt->dir[pd_no (p)];
+
+		if (leaf == NULL) {
+			p = (uint8_t *) ((pd_no (p) + 1) << PDSHIFT);
+			if (p == NULL)
+				break;
+			continue;
+		}
+		if (leaf[pt_no (p)] != NULL)
+			return leaf[pt_no (p)];
+		p += PGSIZE;
+	}
+	return NULL;
+}
+
+/* Adds REGION to SPT.  Fails if it overlaps another region or any
+ * page that already exists.  Takes time linear in the number of
+ * regions, to keep them sorted, and in the pages of the range that
+ * fall in 4 MB blocks where SPT has any pages at all, to check for
+ * them; it allocates no memory. */
+bool
+spt_insert_region (struct supplemental_page_table *spt,
+		struct vm_region *region) {
+	struct list_elem *e;
+
+	ASSERT (pg_ofs (region->start) == 0 && pg_ofs (region->end) == 0);
+	ASSERT (region->start < region->end);
+
+	if (!is_user_vaddr ((uint8_t *) region->end - 1))
+		return false;
+	for (e = list_begin (&spt->regions); e != list_end (&spt->regions);
+			e = list_next (e)) {
+		struct vm_region *r = list_entry (e, struct vm_region, elem);
+		if (r->start >= region->end)
+			break;
+		if (r->end > region->start)
+			return false;
+	}
+	if (spt_next_page (spt, region->start, region->end) != NULL)
+		return false;
+	list_insert (e, &region->elem);
+	return true;
+}
 
-	return succ;
+/* Removes REGION from SPT.  Its pages, if any, stay. */
+void
+spt_remove_region (struct supplemental_page_table *spt UNUSED,
+		struct vm_region *region) {
+	list_remove (&region->elem);
+}
+
+/* Returns the region of SPT that contains VA, or NULL. */
+struct vm_region *
+spt_find_region (struct supplemental_page_table *spt, void *va) {
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->regions); e != list_end (&spt->regions);
+			e = list_next (e)) {
+		struct vm_region *r = list_entry (e, struct vm_region, elem);
+		if (va < r->start)
+			break;
+		if (va < r->end)
+			return r;
+	}
+	return NULL;
+}
+
+/* Returns the page at VA, first creating it if VA lies in a region
+ * and has not been touched yet.  Returns NULL if there is no page
+ * and no region at VA, or if creating the page fails. */
+static struct page *
+spt_get_page (struct supplemental_page_table *spt, void *va) {
+	struct page *page = spt_find_page (spt, va);
+	struct vm_region *region;
+
+	if (page != NULL)
+		return page;
+	region = spt_find_region (spt, va);
+	if (region == NULL || !region->operations->populate (region, va))
+		return NULL;
+	return spt_find_page (spt, va);
 }
 
 void
@@ -131,7 +253,7 @@ spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 		lock_release(&frame_lock);
 	}
 	
-	hash_delete(&spt->pages, &page->elem);
+	*spt_slot (spt, page->va, false) = NULL;
 	vm_dealloc_page (page);
 	// return true;
 }
@@ -235,9 +357,10 @@ vm_evict_frame (void) {
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space. FLAGS may ask for PAL_ZERO, which a pre-zeroed page usually
+ * satisfies without clearing it here.*/
 static struct frame *
-vm_get_frame (void) {
+vm_get_frame (enum palloc_flags flags) {
 	struct frame *frame = NULL;
 	/* TODO: Fill this function. */
 
@@ -245,15 +368,17 @@ vm_get_frame (void) {
 	
 	// ASSERT (frame != NULL);
 	// frame->page = NULL;
-	void *kva = palloc_get_page (PAL_USER);
+	void *kva = palloc_get_page (PAL_USER | flags);
 	
 	/* If the memory is full, evict the page. */
 	if (kva == NULL) {
         // PANIC("Not implemented");
 		frame = vm_evict_frame ();
+		if (frame != NULL && (flags & PAL_ZERO))
+			memset (frame->kva, 0, PGSIZE);
 		return frame;
 	}
-	frame = malloc (sizeof (struct frame));
+	frame = kmem_cache_alloc (&vm_frame_cache);
 	if (frame == NULL) {
 		palloc_free_page (kva);
 		return NULL;
@@ -268,11 +393,7 @@ vm_get_frame (void) {
 static bool
 vm_stack_growth (void *addr) {
 	// addr = pg_round_down (addr);
-	bool success =  vm_claim_page (addr, true);
-	if (success) {
-		memset(pg_round_down(addr), 0, PGSIZE);
-	}
-	return success;
+	return vm_claim_page (addr, true);
 }
 
 /* Handle the fault on write_protected page */
@@ -304,7 +425,7 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user, bool writ
 	void *old_addr = addr;
 	addr = pg_round_down (addr);
 
-	page = spt_find_page(spt, addr);
+	page = spt_get_page(spt, addr);
 	if (page == NULL) {
 		if (is_stack_growth(f, old_addr, user, write, not_present)) {
 			return vm_stack_growth(old_addr);
@@ -315,7 +436,7 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user, bool writ
 
 	ASSERT(page->frame == NULL);
 
-	return vm_do_claim_page (page);
+	return vm_do_claim_page (page, 0);
 }
 
 /* Free the page.
@@ -323,10 +444,10 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user, bool writ
 void
 vm_dealloc_page (struct page *page) {
 	destroy (page);
-	free (page);
+	kmem_cache_free (&vm_page_cache, page);
 }
 
-/* Claim the page that allocate on VA. */
+/* Claim the page that allocate on VA. The page starts out zeroed. */
 bool
 vm_claim_page (void *va, bool writable) {
 	struct page *page = NULL;
@@ -341,13 +462,14 @@ vm_claim_page (void *va, bool writable) {
 
 	ASSERT(page != NULL);
 
-	return vm_do_claim_page (page);
+	return vm_do_claim_page (page, PAL_ZERO);
 }
 
-/* Claim the PAGE and set up the mmu. */
+/* Claim the PAGE and set up the mmu. FLAGS are passed on to
+ * vm_get_frame(). */
 static bool
-vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+vm_do_claim_page (struct page *page, enum palloc_flags flags) {
+	struct frame *frame = vm_get_frame (flags);
 	if (frame == NULL) {
 		return false;
 	}
@@ -388,29 +510,11 @@ vm_do_claim_page (struct page *page) {
 }
 
 
-/* Returns a hash value for page p. */
-static unsigned
-page_hash (const struct hash_elem *p_, void *aux UNUSED)
-{
-  const struct page *p = hash_entry (p_, struct page, elem);
-  return hash_bytes (&p->va, sizeof p->va);
-}
-
-/* Returns true if page a precedes page b. */
-static bool
-page_less (const struct hash_elem *a_, const struct hash_elem *b_,
-           void *aux UNUSED)
-{
-  const struct page *a = hash_entry (a_, struct page, elem);
-  const struct page *b = hash_entry (b_, struct page, elem);
-
-  return a->va < b->va;
-}
-
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt, struct thread *t) {
-    hash_init (&spt->pages, page_hash, page_less, NULL);
+    spt->dir = NULL;
+	list_init(&spt->regions);
     spt->thread = t;
     lock_init (&spt->lock);
 	list_init(&spt->mmap_table);
@@ -445,24 +549,47 @@ spt_remove_frame_from_list(struct supplemental_page_table *spt) {
 	lock_release(&frame_lock);
 }
 
-/** Performs some operation on hash element E, given auxiliary
-   data AUX. */
- static void 
- page_dealloc_helper (struct hash_elem *e, void *aux UNUSED) {
-	struct page *page = hash_entry (e, struct page, elem);
-	vm_dealloc_page (page);
- }
-
 /* Free the resource hold by the supplemental page table */
 void
 supplemental_page_table_kill (struct supplemental_page_table *spt) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
+	ASSERT (spt == &thread_current ()->spt);
+
+	/* Unmap the file mappings first, writing back their dirty pages
+	 * and closing their files. */
+	while (!list_empty (&spt->mmap_table)) {
+		struct mmap_file *mmap = list_entry (list_front (&spt->mmap_table),
+				struct mmap_file, elem);
+		do_munmap (mmap->mapid);
+	}
+
 	lock_acquire(&spt->lock);
 	spt_remove_frame_from_list(spt);
 	lock_release(&spt->lock);
 
-	hash_destroy(&spt->pages, page_dealloc_helper);
+	if (spt->dir != NULL) {
+		size_t i, j;
+
+		for (i = 0; i < pd_no (PHYS_BASE); i++) {
+			struct page **leaf = spt->dir[i];
+			if (leaf == NULL)
+				continue;
+			for (j = 0; j < PGSIZE / sizeof *leaf; j++)
+				if (leaf[j] != NULL)
+					vm_dealloc_page (leaf[j]);
+			palloc_free_page (leaf);
+		}
+		palloc_free_page (spt->dir);
+		spt->dir = NULL;
+	}
+
+	while (!list_empty (&spt->regions)) {
+		struct vm_region *region = list_entry (list_pop_front (&spt->regions),
+				struct vm_region, elem);
+		if (region->operations->destroy != NULL)
+			(region->operations->destroy) (region);
+	}
 }
 
 bool
@@ -471,6 +598,10 @@ vm_page_exist(void *va, bool writable, struct intr_frame *f) {
 	struct supplemental_page_table *spt = &thread_current ()->spt;
 	struct page *page = spt_find_page(spt, va);
 	if (page == NULL) {
+		struct vm_region *region = spt_find_region(spt, va);
+		if (region != NULL) {
+			return region->writable || !writable;
+		}
 		if (is_stack_growth(f, va, true, writable, true)) {
 			return vm_stack_growth(va);
 		}
@@ -483,7 +614,7 @@ bool
 vm_pin_page(void *va) {
 	ASSERT(pg_round_down(va) == va);
 	struct supplemental_page_table *spt = &thread_current ()->spt;
-	struct page *page = spt_find_page(spt, va);
+	struct page *page = spt_get_page(spt, va);
 	if (page == NULL) {
 		return false;
 	}
@@ -493,7 +624,7 @@ vm_pin_page(void *va) {
 	lock_release(&page->spt->lock);
 	
 	if (page->frame == NULL) {
-		return vm_do_claim_page(page);
+		return vm_do_claim_page(page, 0);
 	}
 	return true;
 }
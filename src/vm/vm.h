@@ -2,6 +2,7 @@
 #define VM_VM_H
 #include <stdbool.h>
 #include "threads/palloc.h"
+#include "threads/slab.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -27,7 +28,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
-#include "lib/kernel/hash.h"
+#include "lib/kernel/list.h"
 #include "threads/synch.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
@@ -59,13 +60,10 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
-    struct hash_elem elem; /* For supplemental page table */
 	int pin_count;         /* Pin count for eviction */
 	bool writable;         /* Writable or not */
 	struct supplemental_page_table *spt; /* Back reference for spt */
 
-	struct list_elem mmap_elem; /* For mmap list */
-
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union {
@@ -101,6 +99,29 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* A range of user virtual memory, such as an ELF segment or a file
+ * mapping, whose pages are created only when first touched.  Recording
+ * a region allocates nothing per page; its populate operation later
+ * creates the page for one address at a time, when the page faults in
+ * or is pinned for a system call.  Checking a user buffer only looks
+ * the region up. */
+struct vm_region {
+	void *start;           /* First page. */
+	void *end;             /* One past the last page. */
+	bool writable;         /* Writable or not */
+	const struct vm_region_operations *operations;
+	void *aux;             /* For the operations. */
+	struct list_elem elem; /* For spt->regions, sorted by START */
+};
+
+/* The function table for regions, in the manner of page_operations.
+ * POPULATE creates the page at VA, which lies in the region, and
+ * DESTROY, if not null, frees the region when its process exits. */
+struct vm_region_operations {
+	bool (*populate) (struct vm_region *, void *va);
+	void (*destroy) (struct vm_region *);
+};
+
 struct mmap_file {
 	int mapid;
 	struct file *file;
@@ -109,14 +130,21 @@ struct mmap_file {
 	int len;
 	int offset;
 	bool writable;
-	struct list pages;
+	struct vm_region region;
 };
 
 /* Representation of current process's memory space.
  * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ * All designs up to you for this.
+ *
+ * Pages are kept in a two-level radix tree split like the x86 page
+ * table: DIR is a page of pointers indexed by pd_no(), each to a page
+ * of struct page pointers indexed by pt_no().  Both levels are
+ * allocated on first use, so lookup is two loads with no hashing, and
+ * walking a range can skip every 4 MB with no pages at once. */
 struct supplemental_page_table {
-    struct hash pages;
+	struct page ***dir;
+	struct list regions;
 	struct list mmap_table;
     struct thread *thread;
     struct lock lock;
@@ -131,9 +159,21 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+struct page *spt_next_page (struct supplemental_page_table *spt,
+		void *va, void *end);
+bool spt_insert_region (struct supplemental_page_table *spt,
+		struct vm_region *region);
+void spt_remove_region (struct supplemental_page_table *spt,
+		struct vm_region *region);
+struct vm_region *spt_find_region (struct supplemental_page_table *spt,
+		void *va);
 
 void vm_init (void);
 
+/* Caches of struct page and struct frame. */
+extern struct kmem_cache vm_page_cache;
+extern struct kmem_cache vm_frame_cache;
+
 struct intr_frame;
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user, bool write, bool not_present);
 